@@ -1,19 +1,107 @@
 #include <vulkan/vulkan.h>
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
 #include "renderer/vx_renderer.hpp"
+#include "renderer/vx_benchmark.hpp"
+#include "renderer/vx_frameRecorder.hpp"
+#include "renderer/vx_regression.hpp"
+#include "renderer/vx_renderServer.hpp"
 
 int main(int argc, char* argv[]) {
+    // --bench <name> runs a benchmark instead of the interactive loop.
+    // --record <path> renders headless and streams every frame to disk.
+    // --regress <dir> renders headless and checks golden images and CPU timings, --update rewrites them.
+    // --serve <socket> renders background effect jobs for other processes until interrupted (Linux).
+    // --present-mode and --images pick the swapchain's present mode and image count.
+    // --no-idle draws continuously, --unfocused-fps caps the frame rate without focus.
+    // --trace <path> captures a Chrome trace from startup until exit (not in Release builds).
+    VxEngine::BenchmarkOptions benchmark;
+    VxEngine::RecorderOptions recording;
+    VxEngine::RegressionOptions regression;
+    VxEngine::RenderServerOptions server;
+    uint32_t frames = 0;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t imageCount = 0;
+    bool idleScheduling = true;
+    uint32_t unfocusedFps = VxEngine::UNFOCUSED_FPS_LIMIT;
+    std::string tracePath;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchmark.name = argv[++i];
+        } else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recording.path = argv[++i];
+        } else if(strcmp(argv[i], "--regress") == 0 && i + 1 < argc) {
+            regression.directory = argv[++i];
+        } else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            server.socketPath = argv[++i];
+        } else if(strcmp(argv[i], "--update") == 0) {
+            regression.update = true;
+        } else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            if(!VxEngine::parseRecordFormat(argv[++i], recording.format)) {
+                std::cerr << "Unknown record format: " << argv[i] << " (y4m, rgba, png)" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if(strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            benchmark.csvPath = argv[++i];
+        } else if(strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            if(!VxEngine::parsePresentMode(argv[++i], presentMode)) {
+                std::cerr << "Unknown present mode: " << argv[i] << " (fifo, relaxed, mailbox, immediate)" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[i], "--images") == 0 && i + 1 < argc) {
+            imageCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if(strcmp(argv[i], "--no-idle") == 0) {
+            idleScheduling = false;
+        } else if(strcmp(argv[i], "--unfocused-fps") == 0 && i + 1 < argc) {
+            unfocusedFps = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(frames > 0) {
+        benchmark.measureFrames = frames;
+        recording.frames = frames;
+        regression.timedFrames = frames;
+    }
+
+    int exitCode = EXIT_SUCCESS;
+
     try {
         std::cout << "Starting main" << std::endl;
 
         // Get the renderer singleton and initialize it
         VxEngine::VulkanRenderer renderer;
+        renderer._headless = !recording.path.empty() || !regression.directory.empty() || !server.socketPath.empty();
+        renderer._presentMode = presentMode;
+        renderer._requestedImageCount = imageCount;
+        renderer._idleScheduling = idleScheduling;
+        renderer._unfocusedFps = unfocusedFps;
+        renderer._tracePath = tracePath;
         renderer.init();
 
-        std::cout << "Running renderer" << std::endl;
-
-        renderer.run();
+        if(!recording.path.empty()) {
+            std::cout << "Recording " << recording.frames << " frames to " << recording.path << std::endl;
+            exitCode = VxEngine::runRecording(renderer, recording);
+        } else if(!regression.directory.empty()) {
+            std::cout << "Running regression checks against " << regression.directory << std::endl;
+            exitCode = VxEngine::runRegression(renderer, regression);
+        } else if(!server.socketPath.empty()) {
+            exitCode = VxEngine::runRenderServer(renderer, server);
+        } else if(!benchmark.name.empty()) {
+            std::cout << "Running benchmark: " << benchmark.name << std::endl;
+            exitCode = VxEngine::runBenchmark(renderer, benchmark);
+        } else {
+            std::cout << "Running renderer" << std::endl;
+            renderer.run();
+        }
 
         std::cout << "Cleaning up renderer" << std::endl;
 
@@ -23,5 +111,5 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return exitCode;
 }
\ No newline at end of file
@@ -1,9 +1,80 @@
 #version 460
+#extension GL_EXT_buffer_reference : require
 
 layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 worldPosition;
 
 layout (location = 0) out vec4 outColor;
 
+struct Light {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+
+layout(buffer_reference, std430) readonly buffer LightBuffer {
+    Light lights[];
+};
+
+layout(buffer_reference, std430) readonly buffer LightGrid {
+    uvec2 clusters[];
+};
+
+layout(buffer_reference, std430) readonly buffer LightIndexList {
+    uint indices[];
+};
+
+layout(buffer_reference, std430) readonly buffer ClusterParams {
+    mat4 view;
+    uvec4 gridSize;
+    vec4 screen;
+    vec4 projection;
+    LightBuffer lights;
+    LightGrid lightGrid;
+    LightIndexList lightIndices;
+    uvec2 counters; // Only used by light_cull.comp.
+};
+
+layout(push_constant) uniform constants {
+    mat4 viewProj;
+    uvec2 objectBuffer; // Only used by the vertex stage.
+    ClusterParams clusterParams;
+} PushConstants;
+
+const float AMBIENT = 0.05;
+
 void main() {
-    outColor = vec4(fragColor, 1.0f);
+    ClusterParams params = PushConstants.clusterParams;
+    uint lightCount = params.gridSize.w;
+    if(lightCount == 0) {
+        outColor = vec4(fragColor, 1.0f); // Unlit.
+        return;
+    }
+
+    // Reverse-Z with an infinite far plane: view depth = near / depth.
+    float depth = params.screen.z / gl_FragCoord.z;
+    int slice = int(log(depth) * params.projection.z - params.projection.w);
+    uvec3 cluster = uvec3(
+        clamp(uvec2(gl_FragCoord.xy / params.screen.xy * vec2(params.gridSize.xy)), uvec2(0), params.gridSize.xy - 1u),
+        uint(clamp(slice, 0, int(params.gridSize.z) - 1)));
+    uint clusterIndex = cluster.x + cluster.y * params.gridSize.x + cluster.z * params.gridSize.x * params.gridSize.y;
+
+    vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+    uvec2 range = params.lightGrid.clusters[clusterIndex];
+
+    vec3 lighting = vec3(AMBIENT);
+    for(uint i = 0; i < range.y; i++) {
+        Light light = params.lights.lights[params.lightIndices.indices[range.x + i]];
+        vec3 toLight = light.positionRadius.xyz - worldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float radius = light.positionRadius.w;
+
+        // Smooth window so the light reaches exactly zero at its radius.
+        float window = clamp(1.0 - (distanceSquared * distanceSquared) / (radius * radius * radius * radius), 0.0, 1.0);
+        float attenuation = window * window / (distanceSquared + 1.0);
+        float lambert = abs(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-6)))); // Triangles are two sided.
+
+        lighting += light.colorIntensity.rgb * light.colorIntensity.a * lambert * attenuation;
+    }
+
+    outColor = vec4(fragColor * lighting, 1.0f);
 };
\ No newline at end of file
@@ -1,6 +1,26 @@
 #version 460
+#extension GL_EXT_buffer_reference : require
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 worldPosition;
+
+struct ObjectData {
+    mat4 model;
+    vec4 aabbMin;
+    vec4 aabbMax;
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+layout(push_constant) uniform constants {
+    mat4 viewProj;
+    ObjectBuffer objectBuffer;
+} PushConstants;
+
+// The depth prepass and the EQUAL tested color pass must produce identical depth.
+invariant gl_Position;
 
 void main() {
     const vec3 positions[3] = vec3[3](
@@ -15,6 +35,12 @@ void main() {
         vec3(0.0, 0.0, 1.0)
     );
 
-    gl_Position = vec4(positions[gl_VertexIndex], 1.0f);
+    // Indirect draws carry the object index in firstInstance.
+    mat4 model = PushConstants.objectBuffer.objects[gl_InstanceIndex].model;
+
+    vec4 world = model * vec4(positions[gl_VertexIndex], 1.0f);
+
+    gl_Position = PushConstants.viewProj * world;
     fragColor = colors[gl_VertexIndex];
+    worldPosition = world.xyz;
 };
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 460
+
+// Cheap shading for the extra views. Clustered lighting is built for the main camera only.
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 worldPosition;
+
+layout (location = 0) out vec4 outColor;
+
+const vec3 LIGHT_DIRECTION = vec3(0.267, 0.802, 0.535);
+const float AMBIENT = 0.25;
+
+void main() {
+    vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+    float lambert = abs(dot(normal, LIGHT_DIRECTION)); // Triangles are two sided.
+    outColor = vec4(fragColor * (AMBIENT + (1.0 - AMBIENT) * lambert), 1.0f);
+}
@@ -0,0 +1,49 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_multiview : require
+
+// Multiview geometry: one draw covers every view, and gl_ViewIndex selects the view's matrix
+// (and the layer being rendered).
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 worldPosition;
+
+struct ObjectData {
+    mat4 model;
+    vec4 aabbMin;
+    vec4 aabbMax;
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+layout(buffer_reference, std430) readonly buffer ViewBuffer {
+    mat4 viewProj[];
+};
+
+layout(push_constant) uniform constants {
+    ViewBuffer views;
+    ObjectBuffer objectBuffer;
+} PushConstants;
+
+void main() {
+    const vec3 positions[3] = vec3[3](
+        vec3(1.0, 1.0, 0.0),
+        vec3(-1.0, 1.0, 0.0),
+        vec3(0.0, -1.0, 0.0)
+    );
+
+    const vec3 colors[3] = vec3[3](
+        vec3(1.0, 0.0, 0.0),
+        vec3(0.0, 1.0, 0.0),
+        vec3(0.0, 0.0, 1.0)
+    );
+
+    mat4 model = PushConstants.objectBuffer.objects[gl_InstanceIndex].model;
+    vec4 world = model * vec4(positions[gl_VertexIndex], 1.0f);
+
+    gl_Position = PushConstants.views.viewProj[gl_ViewIndex] * world;
+    fragColor = colors[gl_VertexIndex];
+    worldPosition = world.xyz;
+}
@@ -0,0 +1,16 @@
+#version 460
+
+// Round soft edged sprite, alpha blended over the scene.
+
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 color;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float distanceSq = dot(corner, corner);
+    if(distanceSq > 1.0) {
+        discard;
+    }
+    outColor = vec4(color.rgb, color.a * (1.0 - distanceSq));
+}
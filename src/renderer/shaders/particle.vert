@@ -0,0 +1,48 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+
+// Camera facing particle quads. The draw's instance count is the length of the alive list the
+// simulate pass just wrote, so every instance is a live particle.
+
+layout(location = 0) out vec2 corner;
+layout(location = 1) out vec4 color;
+
+struct Particle {
+    vec4 positionAge;      // xyz: world position, w: seconds lived.
+    vec4 velocityLifetime; // xyz: world velocity, w: seconds it lives.
+};
+
+layout(buffer_reference, std430) readonly buffer ParticleBuffer {
+    Particle particles[];
+};
+
+layout(buffer_reference, std430) readonly buffer IndexList {
+    uint indices[];
+};
+
+layout(push_constant) uniform constants {
+    mat4 viewProj;
+    vec4 right; // xyz: camera right axis, w: particle size.
+    vec4 up;    // xyz: camera up axis.
+    ParticleBuffer particleBuffer;
+    IndexList aliveList;
+} PushConstants;
+
+void main() {
+    const vec2 corners[6] = vec2[6](
+        vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+        vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+    );
+
+    uint index = PushConstants.aliveList.indices[gl_InstanceIndex];
+    Particle particle = PushConstants.particleBuffer.particles[index];
+    float t = clamp(particle.positionAge.w / particle.velocityLifetime.w, 0.0, 1.0);
+
+    corner = corners[gl_VertexIndex];
+    float size = PushConstants.right.w * mix(1.0, 0.4, t);
+    vec3 world = particle.positionAge.xyz + (PushConstants.right.xyz * corner.x + PushConstants.up.xyz * corner.y) * size;
+    gl_Position = PushConstants.viewProj * vec4(world, 1.0);
+
+    // Hot and bright when spawned, cooling and fading out towards the end of its life.
+    color = vec4(mix(vec3(4.0, 2.4, 0.8), vec3(0.9, 0.15, 0.05), t), 1.0 - t);
+}
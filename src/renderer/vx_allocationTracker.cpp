@@ -0,0 +1,307 @@
+#include "vx_allocationTracker.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include "../../3rdparty/imgui/imgui.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace VxEngine {
+
+namespace {
+
+// Plain globals, zero before any constructor runs, since allocations can come from static initializers.
+struct ScopeSlot {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+};
+
+// Slot 0 collects allocations outside any scope and those of names that found no free slot.
+ScopeSlot g_scopes[AllocationTracker::MAX_SCOPES];
+
+std::atomic<uint64_t> g_allocations;
+std::atomic<uint64_t> g_frees;
+std::atomic<uint64_t> g_bytes;
+std::atomic<uint64_t> g_vulkanAllocations;
+
+// Open addressing on the name pointer. Slots are claimed once and never released.
+ScopeSlot& scopeSlot(const char* name) {
+    if(name == nullptr) {
+        return g_scopes[0];
+    }
+
+    constexpr uint32_t PROBE_SLOTS = AllocationTracker::MAX_SCOPES - 1;
+    uint32_t start = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(name) >> 3) % PROBE_SLOTS;
+    for(uint32_t i = 0; i < PROBE_SLOTS; i++) {
+        ScopeSlot& slot = g_scopes[1 + (start + i) % PROBE_SLOTS];
+        const char* current = slot.name.load(std::memory_order_acquire);
+        if(current == nullptr && slot.name.compare_exchange_strong(current, name, std::memory_order_acq_rel)) {
+            return slot;
+        }
+        if(current == name) {
+            return slot; // Ours, or claimed by another thread for the same name first.
+        }
+    }
+    return g_scopes[0];
+}
+
+#ifdef VX_ALLOCATION_TRACKING
+
+// Vulkan frees and reallocates without the alignment, so the block's start sits in front of the pointer.
+struct VulkanBlockHeader {
+    void* block;
+    size_t size;
+};
+
+void* VKAPI_PTR vulkanAllocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    alignment = std::max(alignment, alignof(VulkanBlockHeader));
+    void* block = std::malloc(size + sizeof(VulkanBlockHeader) + alignment - 1);
+    if(block == nullptr) {
+        return nullptr;
+    }
+
+    uintptr_t address = (reinterpret_cast<uintptr_t>(block) + sizeof(VulkanBlockHeader) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    VulkanBlockHeader* header = reinterpret_cast<VulkanBlockHeader*>(address) - 1;
+    header->block = block;
+    header->size = size;
+    AllocationTracker::on_allocate(size, true);
+    return reinterpret_cast<void*>(address);
+}
+
+void VKAPI_PTR vulkanFree(void* userData, void* memory) {
+    if(memory == nullptr) {
+        return;
+    }
+    std::free((static_cast<VulkanBlockHeader*>(memory) - 1)->block);
+    AllocationTracker::on_free();
+}
+
+void* VKAPI_PTR vulkanReallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if(original == nullptr) {
+        return vulkanAllocate(userData, size, alignment, scope);
+    }
+    if(size == 0) {
+        vulkanFree(userData, original);
+        return nullptr;
+    }
+
+    void* memory = vulkanAllocate(userData, size, alignment, scope);
+    if(memory == nullptr) {
+        return nullptr; // The original stays valid.
+    }
+    std::memcpy(memory, original, std::min(size, (static_cast<VulkanBlockHeader*>(original) - 1)->size));
+    vulkanFree(userData, original);
+    return memory;
+}
+
+const VkAllocationCallbacks VULKAN_CALLBACKS = {
+    .pUserData = nullptr,
+    .pfnAllocation = vulkanAllocate,
+    .pfnReallocation = vulkanReallocate,
+    .pfnFree = vulkanFree,
+    .pfnInternalAllocation = nullptr,
+    .pfnInternalFree = nullptr };
+
+void* trackedAllocate(size_t size) noexcept {
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if(memory != nullptr) {
+        AllocationTracker::on_allocate(size, false);
+    }
+    return memory;
+}
+
+void* trackedAllocateAligned(size_t size, std::align_val_t alignment) noexcept {
+    size = size > 0 ? size : 1;
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size, static_cast<size_t>(alignment));
+#else
+    void* memory = nullptr;
+    if(posix_memalign(&memory, std::max(static_cast<size_t>(alignment), sizeof(void*)), size) != 0) {
+        memory = nullptr;
+    }
+#endif
+    if(memory != nullptr) {
+        AllocationTracker::on_allocate(size, false);
+    }
+    return memory;
+}
+
+void trackedFree(void* memory) noexcept {
+    if(memory != nullptr) {
+        std::free(memory);
+        AllocationTracker::on_free();
+    }
+}
+
+void trackedFreeAligned(void* memory) noexcept {
+    if(memory != nullptr) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+        AllocationTracker::on_free();
+    }
+}
+
+// Retries through the new handler like the library's operator new.
+template<typename Allocate>
+void* allocateOrThrow(Allocate allocate) {
+    while(true) {
+        if(void* memory = allocate()) {
+            return memory;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+#endif // VX_ALLOCATION_TRACKING
+
+} // namespace
+
+AllocationCounts AllocationTracker::totals() {
+    return AllocationCounts{
+        .allocations = g_allocations.load(std::memory_order_relaxed),
+        .frees = g_frees.load(std::memory_order_relaxed),
+        .bytes = g_bytes.load(std::memory_order_relaxed),
+        .vulkanAllocations = g_vulkanAllocations.load(std::memory_order_relaxed) };
+}
+
+void AllocationTracker::scopes(std::vector<ScopeCounts>& out) {
+    out.reserve(MAX_SCOPES);
+    out.clear();
+    for(uint32_t i = 0; i < MAX_SCOPES; i++) {
+        const ScopeSlot& slot = g_scopes[i];
+        uint64_t allocations = slot.allocations.load(std::memory_order_relaxed);
+        if(allocations == 0) {
+            continue;
+        }
+        const char* name = i == 0 ? UNTRACED : slot.name.load(std::memory_order_acquire);
+        out.push_back(ScopeCounts{ name, allocations, slot.bytes.load(std::memory_order_relaxed) });
+    }
+    std::sort(out.begin(), out.end(), [](const ScopeCounts& a, const ScopeCounts& b) {
+        return a.allocations > b.allocations;
+    });
+}
+
+void AllocationTracker::reset_scopes() {
+    for(ScopeSlot& slot : g_scopes) {
+        slot.allocations.store(0, std::memory_order_relaxed);
+        slot.bytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+const VkAllocationCallbacks* AllocationTracker::vulkan_callbacks() {
+#ifdef VX_ALLOCATION_TRACKING
+    return &VULKAN_CALLBACKS;
+#else
+    return nullptr;
+#endif
+}
+
+void AllocationTracker::on_allocate(size_t bytes, bool vulkan) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    if(vulkan) {
+        g_vulkanAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ScopeSlot& slot = scopeSlot(_scope);
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void AllocationTracker::on_free() {
+    g_frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AllocationTracker::draw_imgui() {
+    if(ImGui::Begin("allocations")) {
+        if(!enabled()) {
+            ImGui::TextDisabled("Allocation tracking is compiled out of Release builds");
+        }
+
+        AllocationCounts current = totals();
+        ImGui::Text("Since last frame: %llu allocations (%llu bytes), %llu frees",
+            static_cast<unsigned long long>(current.allocations - _lastTotals.allocations),
+            static_cast<unsigned long long>(current.bytes - _lastTotals.bytes),
+            static_cast<unsigned long long>(current.frees - _lastTotals.frees));
+        ImGui::Text("Total: %llu allocations, %llu through VMA, %llu live", static_cast<unsigned long long>(current.allocations),
+            static_cast<unsigned long long>(current.vulkanAllocations), static_cast<unsigned long long>(current.allocations - current.frees));
+        _lastTotals = current;
+
+        if(ImGui::Button("Reset scopes")) {
+            reset_scopes();
+        }
+        scopes(_scopes);
+        for(const ScopeCounts& scope : _scopes) {
+            ImGui::Text("%-24s %10llu %12llu B", scope.name, static_cast<unsigned long long>(scope.allocations),
+                static_cast<unsigned long long>(scope.bytes));
+        }
+    }
+    ImGui::End();
+}
+
+} // namespace VxEngine
+
+#ifdef VX_ALLOCATION_TRACKING
+
+// Every form is replaced, not just the ones the library forwards to, since a shared C++ runtime
+// (a DLL on Windows) wouldn't forward to these.
+
+void* operator new(std::size_t size) {
+    return VxEngine::allocateOrThrow([size]() { return VxEngine::trackedAllocate(size); });
+}
+
+void* operator new[](std::size_t size) {
+    return VxEngine::allocateOrThrow([size]() { return VxEngine::trackedAllocate(size); });
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return VxEngine::trackedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return VxEngine::trackedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return VxEngine::allocateOrThrow([size, alignment]() { return VxEngine::trackedAllocateAligned(size, alignment); });
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return VxEngine::allocateOrThrow([size, alignment]() { return VxEngine::trackedAllocateAligned(size, alignment); });
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return VxEngine::trackedAllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return VxEngine::trackedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept { VxEngine::trackedFree(memory); }
+void operator delete[](void* memory) noexcept { VxEngine::trackedFree(memory); }
+void operator delete(void* memory, std::size_t) noexcept { VxEngine::trackedFree(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { VxEngine::trackedFree(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { VxEngine::trackedFree(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { VxEngine::trackedFree(memory); }
+
+void operator delete(void* memory, std::align_val_t) noexcept { VxEngine::trackedFreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { VxEngine::trackedFreeAligned(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { VxEngine::trackedFreeAligned(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { VxEngine::trackedFreeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { VxEngine::trackedFreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { VxEngine::trackedFreeAligned(memory); }
+
+#endif // VX_ALLOCATION_TRACKING
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Heap allocation counting, to keep the frame loop allocation free. vx_allocationTracker.cpp replaces
+// the global operator new and delete, and vulkan_callbacks() hands VMA host allocation callbacks that
+// count the same way. Every allocation is attributed to the innermost VX_TRACE_SCOPE open on the
+// allocating thread, whether or not a trace is being captured.
+//
+// VX_ALLOCATION_TRACKING is defined in every configuration but Release (see CMakeLists.txt). Without
+// it the global allocation functions are left alone and every count stays zero.
+//
+// Counting costs a few relaxed atomic adds per allocation, on counters shared by all threads.
+
+struct VkAllocationCallbacks;
+
+namespace VxEngine {
+
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;             // Requested by the allocations.
+    uint64_t vulkanAllocations = 0; // Part of allocations, made through vulkan_callbacks().
+};
+
+class AllocationTracker {
+public:
+    static constexpr uint32_t MAX_SCOPES = 256; // Distinct scope names, later ones count as untraced.
+    static constexpr const char* UNTRACED = "(untraced)";
+
+    struct ScopeCounts {
+        const char* name = nullptr;
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    static constexpr bool enabled() {
+#ifdef VX_ALLOCATION_TRACKING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Since startup, all threads.
+    static AllocationCounts totals();
+    // Scopes that allocated since the last reset_scopes(), most allocations first. out keeps its
+    // capacity, so refreshing it every frame doesn't allocate after the first time.
+    static void scopes(std::vector<ScopeCounts>& out);
+    static void reset_scopes();
+
+    // Makes name the calling thread's scope and returns the one it replaces, for leave_scope.
+    // Names are kept by pointer, like trace event names.
+    static const char* enter_scope(const char* name) {
+        const char* previous = _scope;
+        _scope = name;
+        return previous;
+    }
+    static void leave_scope(const char* previous) { _scope = previous; }
+
+    // For VmaAllocatorCreateInfo::pAllocationCallbacks, nullptr without VX_ALLOCATION_TRACKING.
+    static const VkAllocationCallbacks* vulkan_callbacks();
+
+    // Called by the replaced allocation functions.
+    static void on_allocate(size_t bytes, bool vulkan);
+    static void on_free();
+
+    // Allocations since the previous call and the per scope counts. Main thread, once per frame.
+    void draw_imgui();
+
+private:
+    static inline thread_local const char* _scope = nullptr;
+
+    AllocationCounts _lastTotals;
+    std::vector<ScopeCounts> _scopes;
+};
+
+} // namespace VxEngine
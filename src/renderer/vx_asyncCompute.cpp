@@ -0,0 +1,121 @@
+#include "vx_asyncCompute.hpp"
+
+namespace VxEngine {
+
+namespace {
+
+VkSemaphore createTimelineSemaphore(VkDevice device) {
+    VkSemaphoreTypeCreateInfo typeInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = createSemaphoreInfo(0);
+    semaphoreInfo.pNext = &typeInfo;
+
+    VkSemaphore semaphore;
+    VX_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore), "vkCreateSemaphore");
+    return semaphore;
+}
+
+} // namespace
+
+void bufferOwnershipBarrier(VkCommandBuffer cmd, VkBuffer buffer, const QueueTransfer& transfer,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+    VkBufferMemoryBarrier2 barrier = { .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2 };
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = transfer.srcFamily;
+    barrier.dstQueueFamilyIndex = transfer.dstFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    VkDependencyInfo dependencyInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    dependencyInfo.bufferMemoryBarrierCount = 1;
+    dependencyInfo.pBufferMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+void imageOwnershipBarrier(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, const QueueTransfer& transfer,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+    VkImageMemoryBarrier2 barrier = { .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = transfer.srcFamily;
+    barrier.dstQueueFamilyIndex = transfer.dstFamily;
+    barrier.image = image;
+    barrier.subresourceRange = createImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+
+    VkDependencyInfo dependencyInfo = { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+void AsyncCompute::init(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t graphicsFamily) {
+    _device = device;
+    _queue = queue;
+    _queueFamily = queue != VK_NULL_HANDLE ? queueFamily : graphicsFamily;
+    _graphicsFamily = graphicsFamily;
+
+    _graphicsTimeline = createTimelineSemaphore(_device);
+    if(!available()) {
+        return;
+    }
+    _computeTimeline = createTimelineSemaphore(_device);
+
+    VkCommandPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = _queueFamily;
+
+    for(uint32_t i = 0; i < LIVE_FRAMES; i++) {
+        VX_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPools[i]), "failed to create compute command pool");
+        VkCommandBufferAllocateInfo allocInfo = createCommandBufferAllocateInfo(_commandPools[i], 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        VX_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &_commandBuffers[i]), "failed to allocate compute command buffer");
+    }
+}
+
+void AsyncCompute::destroy() {
+    for(uint32_t i = 0; i < LIVE_FRAMES; i++) {
+        if(_commandPools[i] != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(_device, _commandPools[i], nullptr);
+            _commandPools[i] = VK_NULL_HANDLE;
+        }
+    }
+    if(_computeTimeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(_device, _computeTimeline, nullptr);
+        _computeTimeline = VK_NULL_HANDLE;
+    }
+    vkDestroySemaphore(_device, _graphicsTimeline, nullptr);
+    _graphicsTimeline = VK_NULL_HANDLE;
+    _queue = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32_t frameIndex) {
+    VX_CHECK(vkResetCommandPool(_device, _commandPools[frameIndex], 0), "vkResetCommandPool");
+
+    VkCommandBufferBeginInfo beginInfo = beginCommandBufferInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VX_CHECK(vkBeginCommandBuffer(_commandBuffers[frameIndex], &beginInfo), "vkBeginCommandBuffer");
+    return _commandBuffers[frameIndex];
+}
+
+void AsyncCompute::submit(uint32_t frameIndex, uint64_t value, uint64_t waitGraphicsValue) {
+    VX_CHECK(vkEndCommandBuffer(_commandBuffers[frameIndex]), "vkEndCommandBuffer");
+
+    VkCommandBufferSubmitInfo commandBufferInfo = createCommandBufferSubmitInfo(_commandBuffers[frameIndex]);
+    VkSemaphoreSubmitInfo signalInfo = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _computeTimeline);
+    signalInfo.value = value;
+    VkSemaphoreSubmitInfo waitInfo = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _graphicsTimeline);
+    waitInfo.value = waitGraphicsValue;
+
+    VkSubmitInfo2 submitInfo = createSubmitInfo2(&commandBufferInfo, &signalInfo, waitGraphicsValue > 0 ? &waitInfo : nullptr);
+    VX_CHECK(vkQueueSubmit2(_queue, 1, &submitInfo, VK_NULL_HANDLE), "vkQueueSubmit2");
+}
+
+} // namespace VxEngine
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "vx_utils.hpp"
+
+// Dedicated compute queue for passes that don't depend on the frame's graphics work, the background
+// effect and light culling. They are submitted ahead of the frame's graphics work, so on hardware with
+// a separate compute family they overlap the previous frame's geometry, blit and present.
+//
+// Two timeline semaphores order the queues. Graphics frame N waits for compute value N + 1 before it
+// touches compute results, and signals graphics value N + 1 when done. Compute only waits for graphics
+// value N (frame N - 1 done) when it overwrites something the previous frame still reads. Resources
+// written on the compute family and read on the graphics family change owner through a release barrier
+// recorded on the compute queue and the matching acquire on the graphics queue.
+
+namespace VxEngine {
+
+// Source and destination family of an ownership transfer. Nothing is transferred when they match.
+struct QueueTransfer {
+    uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED;
+
+    bool needed() const { return srcFamily != dstFamily; }
+};
+
+// One half of an ownership transfer. The release, on the source queue, passes VK_PIPELINE_STAGE_2_NONE
+// as its destination; the acquire, on the destination queue, passes it as its source. Both halves must
+// name the same layouts.
+void bufferOwnershipBarrier(VkCommandBuffer cmd, VkBuffer buffer, const QueueTransfer& transfer,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+void imageOwnershipBarrier(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, const QueueTransfer& transfer,
+    VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+
+class AsyncCompute {
+public:
+    // queue is VK_NULL_HANDLE when the device has no compute family apart from graphics. The graphics
+    // timeline is created either way, so the graphics submit can always signal it.
+    void init(VkDevice device, VkQueue queue, uint32_t queueFamily, uint32_t graphicsFamily);
+    void destroy();
+
+    bool available() const { return _queue != VK_NULL_HANDLE; }
+    uint32_t queue_family() const { return _queueFamily; }
+
+    // Ownership transfer of compute results to the graphics family.
+    QueueTransfer to_graphics() const { return { _queueFamily, _graphicsFamily }; }
+
+    // Resets and begins the slot's command buffer. The slot's graphics fence must have been waited,
+    // which also covers its last compute submit.
+    VkCommandBuffer begin(uint32_t frameIndex);
+
+    // Ends and submits the slot's command buffer, signalling the compute timeline with value.
+    // waitGraphicsValue > 0 first waits for the graphics timeline to reach it.
+    void submit(uint32_t frameIndex, uint64_t value, uint64_t waitGraphicsValue);
+
+    VkSemaphore compute_timeline() const { return _computeTimeline; }
+    VkSemaphore graphics_timeline() const { return _graphicsTimeline; }
+
+private:
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    uint32_t _queueFamily = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t _graphicsFamily = VK_QUEUE_FAMILY_IGNORED;
+
+    VkCommandPool _commandPools[LIVE_FRAMES] = {};
+    VkCommandBuffer _commandBuffers[LIVE_FRAMES] = {};
+
+    VkSemaphore _computeTimeline = VK_NULL_HANDLE;
+    VkSemaphore _graphicsTimeline = VK_NULL_HANDLE;
+};
+
+} // namespace VxEngine
@@ -0,0 +1,116 @@
+#include "vx_backgroundCache.hpp"
+#include "vx_buffer.hpp"
+
+#include <cmath>
+
+namespace VxEngine {
+
+void BackgroundCache::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, DescriptorManager& descriptors,
+    VkDescriptorSetLayout imageLayout, VkFormat format, VkExtent3D extent) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+
+    _image.format = format;
+    _image.extent = extent;
+
+    VkImageCreateInfo imageInfo = createImageCreateInfo(format, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, extent);
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VX_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_image.image, &_image.allocation, nullptr), "vmaCreateImage");
+    _telemetry->track(_image.allocation, AllocationCategory::RenderTarget, "background cache");
+
+    VkImageViewCreateInfo viewInfo = createImageViewCreateInfo(format, _image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VX_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_image.imageView), "vkCreateImageView");
+
+    // Same layout as the draw image set, so the background pipelines bind it unchanged.
+    _descriptorSet = descriptors.allocate(_device, imageLayout);
+
+    VkDescriptorImageInfo descriptorImageInfo = {};
+    descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    descriptorImageInfo.imageView = _image.imageView;
+
+    VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding = 0;
+    write.dstSet = _descriptorSet;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.descriptorCount = 1;
+    write.pImageInfo = &descriptorImageInfo;
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+}
+
+void BackgroundCache::destroy() {
+    vkDestroyImageView(_device, _image.imageView, nullptr);
+    _telemetry->untrack(_image.allocation);
+    vmaDestroyImage(_allocator, _image.image, _image.allocation);
+}
+
+void BackgroundCache::draw(CommandRecorder& cmd, const ComputePipeline& effect, VkImage target, VkExtent2D extent) {
+    record(cmd, effect, target, extent, prepare(effect, extent));
+}
+
+bool BackgroundCache::prepare(const ComputePipeline& effect, VkExtent2D extent) {
+    uint64_t key = hashValue(effect.pipeline);
+    key = hashValue(effect.data, key);
+    key = hashValue(extent, key);
+
+    if(_valid && key == _key) {
+        _stats.reuses++;
+        return false;
+    }
+
+    _key = key;
+    _valid = true;
+    _stats.evaluations++;
+    return true;
+}
+
+void BackgroundCache::dispatch(CommandRecorder& cmd, const ComputePipeline& effect, VkExtent2D extent) {
+    // The effect overwrites the whole image, so its old contents can be discarded. The full barrier
+    // also orders the writes after copies out of the cache from earlier frames on this queue.
+    cmd.transition_image(_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipeline, effect.pipelineLayout);
+    cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipelineLayout, 0, 1, &_descriptorSet);
+    cmd.push_constants(effect.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &effect.data);
+    cmd.dispatch(static_cast<uint32_t>(std::ceil(extent.width / 16.0f)), static_cast<uint32_t>(std::ceil(extent.height / 16.0f)), 1);
+}
+
+void BackgroundCache::evaluate(CommandRecorder& cmd, const ComputePipeline& effect, VkExtent2D extent, const QueueTransfer& transfer) {
+    dispatch(cmd, effect, extent);
+
+    // Within one family the timeline semaphore between the submits makes the writes visible.
+    if(transfer.needed()) {
+        imageOwnershipBarrier(cmd.buffer(), _image.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, transfer,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+    }
+}
+
+void BackgroundCache::acquire(CommandRecorder& cmd, const QueueTransfer& transfer) {
+    if(transfer.needed()) {
+        imageOwnershipBarrier(cmd.buffer(), _image.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, transfer,
+            VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    }
+}
+
+void BackgroundCache::record(CommandRecorder& cmd, const ComputePipeline& effect, VkImage target, VkExtent2D extent, bool evaluate) {
+    if(evaluate) {
+        dispatch(cmd, effect, extent);
+
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_READ_BIT);
+    }
+
+    VkImageCopy region = {};
+    region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.extent = { extent.width, extent.height, 1 };
+    vkCmdCopyImage(cmd.buffer(), _image.image, VK_IMAGE_LAYOUT_GENERAL, target, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+}
+
+} // namespace VxEngine
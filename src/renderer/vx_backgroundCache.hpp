@@ -0,0 +1,69 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_pipeline.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_descriptors.hpp"
+#include "vx_memoryTelemetry.hpp"
+#include "vx_asyncCompute.hpp"
+
+// Caches the background compute effect in a persistent image. The background effects are pure
+// functions of their push constants and the extent, so the effect only runs again when the
+// selected effect, its ComputePushConstants or the extent change. Every other frame the cached
+// image is copied into the draw image, which costs a fraction of the full screen dispatch.
+//
+// The cache image stays in VK_IMAGE_LAYOUT_GENERAL, which serves both the compute writes and
+// the copies out of it.
+
+namespace VxEngine {
+
+class BackgroundCache {
+public:
+    struct Stats {
+        uint64_t evaluations = 0; // Frames that ran the effect.
+        uint64_t reuses = 0;      // Frames served from the cache.
+    };
+
+    // extent is the largest extent that will be drawn (the draw image's).
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, DescriptorManager& descriptors,
+        VkDescriptorSetLayout imageLayout, VkFormat format, VkExtent3D extent);
+    void destroy();
+
+    // Writes the background into target, which must be in VK_IMAGE_LAYOUT_GENERAL.
+    void draw(CommandRecorder& cmd, const ComputePipeline& effect, VkImage target, VkExtent2D extent);
+
+    // draw split in two for callers that replay recorded commands: prepare updates the cache state on
+    // the CPU and returns whether the effect has to run, record writes the matching commands.
+    bool prepare(const ComputePipeline& effect, VkExtent2D extent);
+    void record(CommandRecorder& cmd, const ComputePipeline& effect, VkImage target, VkExtent2D extent, bool evaluate);
+
+    // record's evaluation on the async compute queue: runs the effect into the cache and releases the
+    // image to the graphics family. acquire, on the graphics queue, must precede the next record, which
+    // then only copies. The caller orders evaluate after the previous frame's copies out of the cache.
+    void evaluate(CommandRecorder& cmd, const ComputePipeline& effect, VkExtent2D extent, const QueueTransfer& transfer);
+    void acquire(CommandRecorder& cmd, const QueueTransfer& transfer);
+
+    // Identifies the cached contents; changes whenever prepare decides to evaluate.
+    uint64_t key() const { return _key; }
+
+    // Forces the next draw to run the effect, e.g. after its pipeline was rebuilt.
+    void invalidate() { _valid = false; }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    void dispatch(CommandRecorder& cmd, const ComputePipeline& effect, VkExtent2D extent);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+
+    AllocatedImage _image;
+    VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+
+    bool _valid = false;
+    uint64_t _key = 0;
+    Stats _stats;
+};
+
+} // namespace VxEngine
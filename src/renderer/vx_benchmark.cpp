@@ -0,0 +1,753 @@
+#include "vx_benchmark.hpp"
+#include "vx_renderer.hpp"
+#include "vx_transformHierarchy.hpp"
+#include "vx_cpuCuller.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace VxEngine {
+
+namespace {
+
+struct ScopeAverage {
+    double total = 0.0;
+    uint32_t samples = 0;
+
+    void add(double ms) {
+        if(ms >= 0.0) {
+            total += ms;
+            samples++;
+        }
+    }
+
+    double average() const { return samples > 0 ? total / samples : 0.0; }
+};
+
+// A scope's time from whichever queue it ran on, negative if it wasn't recorded.
+double scopeMs(const VulkanRenderer& renderer, const char* name) {
+    double ms = renderer._gpuProfiler.scope_ms(name);
+    return ms >= 0.0 ? ms : renderer._computeProfiler.scope_ms(name);
+}
+
+// Reports the abort when running is false, which frame() and measureScopes() return once the
+// window was closed. Returns whether the benchmark has to stop.
+bool aborted(bool running) {
+    if(!running) {
+        std::cerr << "Benchmark aborted, window closed." << std::endl;
+    }
+    return !running;
+}
+
+// Opens path for the CSV rows and writes the header line. Leaves csv closed when path is empty.
+// Returns false, reported, if the file couldn't be opened.
+bool openCsv(const std::string& path, const char* header, std::ofstream& csv) {
+    if(path.empty()) {
+        return true;
+    }
+    csv.open(path);
+    if(!csv.is_open()) {
+        std::cerr << "Failed to open benchmark output: " << path << std::endl;
+        return false;
+    }
+    csv << header << "\n";
+    return true;
+}
+
+// Runs warmup frames, then averages the named GPU scopes over the measured frames.
+// Returns false if the window was closed.
+bool measureScopes(VulkanRenderer& renderer, const BenchmarkOptions& options, const std::vector<const char*>& scopes, std::vector<double>& averages) {
+    for(uint32_t i = 0; i < options.warmupFrames; i++) {
+        if(!renderer.frame()) {
+            return false;
+        }
+    }
+
+    std::vector<ScopeAverage> totals(scopes.size());
+    for(uint32_t i = 0; i < options.measureFrames; i++) {
+        if(!renderer.frame()) {
+            return false;
+        }
+        for(size_t scope = 0; scope < scopes.size(); scope++) {
+            totals[scope].add(scopeMs(renderer, scopes[scope]));
+        }
+    }
+
+    averages.clear();
+    for(const ScopeAverage& total : totals) {
+        averages.push_back(total.average());
+    }
+    return true;
+}
+
+// Sweeps the light count and reports how light culling and shading scale with it.
+int benchmarkLights(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    const uint32_t lightCounts[] = { 100, 1000, 10000, 100000 };
+    const std::vector<const char*> scopes = { "light cull", "geometry" };
+
+    struct Row {
+        uint32_t lights;
+        double cullMs;
+        double shadeMs;
+        uint32_t indices;
+        uint32_t dropped;
+    };
+    std::vector<Row> rows;
+
+    const int lightSetting = renderer._frameState.lightCount;
+    for(uint32_t lights : lightCounts) {
+        renderer._frameState.lightCount = static_cast<int>(lights); // Applied by the next frame.
+
+        std::vector<double> averages;
+        if(aborted(measureScopes(renderer, options, scopes, averages))) {
+            return EXIT_FAILURE;
+        }
+        const ClusteredLighting::Stats& stats = renderer._clusteredLighting.stats();
+        rows.push_back(Row{ lights, averages[0], averages[1], stats.indices, stats.dropped });
+    }
+
+    // Restore the interactive light count.
+    renderer._frameState.lightCount = lightSetting;
+
+    std::printf("------- Clustered lighting (%u measured frames per step) -------\n", options.measureFrames);
+    std::printf("%10s %12s %12s %14s %12s %12s %12s %10s\n", "lights", "cull ms", "shade ms", "cull ns/light", "cull x", "shade x", "indices", "dropped");
+    for(const Row& row : rows) {
+        std::printf("%10u %12.3f %12.3f %14.3f %12.2f %12.2f %12u %10u\n",
+            row.lights, row.cullMs, row.shadeMs,
+            row.cullMs * 1000000.0 / row.lights,
+            rows[0].cullMs > 0.0 ? row.cullMs / rows[0].cullMs : 0.0,
+            rows[0].shadeMs > 0.0 ? row.shadeMs / rows[0].shadeMs : 0.0,
+            row.indices, row.dropped);
+    }
+    std::printf("(x columns are relative to %u lights; %u light indices shared by all clusters)\n", rows[0].lights, ClusteredLighting::INDEX_CAPACITY);
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "lights,cull_ms,shade_ms,indices,dropped", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << row.lights << "," << row.cullMs << "," << row.shadeMs << "," << row.indices << "," << row.dropped << "\n";
+        }
+    }
+
+    if(!renderer._gpuProfiler.supported()) {
+        std::cerr << "Timestamp queries unsupported, GPU times are zero." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Compares the CPU cost of recording a frame with every pass recorded from scratch against
+// replaying the cached secondary command buffers. The camera stays still, so cached passes hold.
+int benchmarkCommands(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    struct Row {
+        bool reuse;
+        double recordMs;
+        double frameMs;
+        uint64_t recorded;
+        uint64_t reused;
+    };
+    std::vector<Row> rows;
+
+    const bool reuseSetting = renderer._frameState.reuseCommandBuffers;
+    for(bool reuse : { false, true }) {
+        renderer._frameState.reuseCommandBuffers = reuse;
+        renderer._commandCache.invalidate();
+
+        for(uint32_t i = 0; i < options.warmupFrames; i++) {
+            if(aborted(renderer.frame())) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        CommandCache::Stats before = renderer._commandCache.stats();
+        ScopeAverage record;
+        ScopeAverage frame;
+        for(uint32_t i = 0; i < options.measureFrames; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            if(aborted(renderer.frame())) {
+                return EXIT_FAILURE;
+            }
+            frame.add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+            record.add(renderer._cpuRecordMs);
+        }
+        const CommandCache::Stats& after = renderer._commandCache.stats();
+        rows.push_back(Row{ reuse, record.average(), frame.average(), after.recorded - before.recorded, after.reused - before.reused });
+    }
+    renderer._frameState.reuseCommandBuffers = reuseSetting;
+
+    std::printf("------- Command buffer reuse (%u measured frames per step) -------\n", options.measureFrames);
+    std::printf("%8s %12s %12s %12s %12s %10s\n", "reuse", "record ms", "frame ms", "recorded", "reused", "record x");
+    for(const Row& row : rows) {
+        std::printf("%8s %12.4f %12.3f %12llu %12llu %10.2f\n",
+            row.reuse ? "on" : "off", row.recordMs, row.frameMs,
+            static_cast<unsigned long long>(row.recorded), static_cast<unsigned long long>(row.reused),
+            rows[0].recordMs > 0.0 ? row.recordMs / rows[0].recordMs : 0.0);
+    }
+    std::printf("(record ms is CPU time from vkBeginCommandBuffer to vkEndCommandBuffer; x is relative to reuse off)\n");
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "reuse,record_ms,frame_ms,recorded,reused", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << (row.reuse ? 1 : 0) << "," << row.recordMs << "," << row.frameMs << "," << row.recorded << "," << row.reused << "\n";
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Frame time with the background effect and light culling on the graphics queue against the async
+// compute queue. The background is re-evaluated every frame, as an animated one would be, and many
+// lights make culling expensive enough for the overlap to show.
+int benchmarkAsyncCompute(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    if(!renderer._asyncCompute.available()) {
+        std::cerr << "No compute queue family apart from graphics, nothing to compare." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    struct Row {
+        bool async;
+        double frameMs;
+        double backgroundMs;
+        double cullMs;
+        double geometryMs;
+    };
+    std::vector<Row> rows;
+
+    const bool asyncSetting = renderer._frameState.asyncCompute;
+    const int lightSetting = renderer._frameState.lightCount;
+    renderer._frameState.lightCount = 100000;
+    for(bool async : { false, true }) {
+        renderer._frameState.asyncCompute = async;
+
+        ScopeAverage frame;
+        ScopeAverage background;
+        ScopeAverage cull;
+        ScopeAverage geometry;
+        for(uint32_t i = 0; i < options.warmupFrames + options.measureFrames; i++) {
+            renderer._backgroundCache.invalidate();
+            auto start = std::chrono::high_resolution_clock::now();
+            if(aborted(renderer.frame())) {
+                return EXIT_FAILURE;
+            }
+            if(i < options.warmupFrames) {
+                continue;
+            }
+            frame.add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+            background.add(scopeMs(renderer, "background"));
+            cull.add(scopeMs(renderer, "light cull"));
+            geometry.add(scopeMs(renderer, "geometry"));
+        }
+        rows.push_back(Row{ async, frame.average(), background.average(), cull.average(), geometry.average() });
+    }
+    renderer._frameState.asyncCompute = asyncSetting;
+    renderer._frameState.lightCount = lightSetting;
+
+    std::printf("------- Async compute (%u measured frames per step, queue family %u) -------\n",
+        options.measureFrames, renderer._asyncCompute.queue_family());
+    std::printf("%8s %12s %14s %12s %12s %10s\n", "async", "frame ms", "background ms", "cull ms", "geometry ms", "frame x");
+    for(const Row& row : rows) {
+        std::printf("%8s %12.3f %14.3f %12.3f %12.3f %10.2f\n",
+            row.async ? "on" : "off", row.frameMs, row.backgroundMs, row.cullMs, row.geometryMs,
+            rows[0].frameMs > 0.0 ? row.frameMs / rows[0].frameMs : 0.0);
+    }
+    std::printf("(frame ms is wall time per frame, run with --present-mode immediate to leave vsync out of it)\n");
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "async,frame_ms,background_ms,cull_ms,geometry_ms", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << (row.async ? 1 : 0) << "," << row.frameMs << "," << row.backgroundMs << "," << row.cullMs << "," << row.geometryMs << "\n";
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Heap allocations over steady state frames, of which there should be none. Fails if any measured
+// frame allocated and lists the trace scopes that did. Counts come from AllocationTracker, so this
+// needs a build with VX_ALLOCATION_TRACKING, i.e. anything but Release.
+int benchmarkAllocations(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    if(!AllocationTracker::enabled()) {
+        std::cerr << "Allocation tracking is compiled out of Release builds, nothing to measure." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for(uint32_t i = 0; i < options.warmupFrames; i++) {
+        if(aborted(renderer.frame())) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<AllocationTracker::ScopeCounts> scopes;
+    AllocationTracker::scopes(scopes); // Reserves, so reading them afterwards doesn't count.
+    AllocationTracker::reset_scopes();
+
+    AllocationCounts before = AllocationTracker::totals();
+    uint32_t allocatingFrames = 0;
+    uint64_t worstFrame = 0;
+    for(uint32_t i = 0; i < options.measureFrames; i++) {
+        uint64_t frameStart = AllocationTracker::totals().allocations;
+        if(aborted(renderer.frame())) {
+            return EXIT_FAILURE;
+        }
+        uint64_t allocations = AllocationTracker::totals().allocations - frameStart;
+        if(allocations > 0) {
+            allocatingFrames++;
+            worstFrame = std::max(worstFrame, allocations);
+        }
+    }
+    AllocationCounts after = AllocationTracker::totals();
+    AllocationTracker::scopes(scopes);
+
+    uint64_t allocations = after.allocations - before.allocations;
+    std::printf("------- Steady state allocations (%u measured frames) -------\n", options.measureFrames);
+    std::printf("%12s %14s %12s %12s %16s %12s\n", "allocations", "bytes", "frees", "through VMA", "allocating frames", "worst frame");
+    std::printf("%12llu %14llu %12llu %12llu %16u %12llu\n",
+        static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(after.bytes - before.bytes),
+        static_cast<unsigned long long>(after.frees - before.frees),
+        static_cast<unsigned long long>(after.vulkanAllocations - before.vulkanAllocations),
+        allocatingFrames, static_cast<unsigned long long>(worstFrame));
+    for(const AllocationTracker::ScopeCounts& scope : scopes) {
+        std::printf("  %-24s %10llu allocations %12llu bytes\n", scope.name,
+            static_cast<unsigned long long>(scope.allocations), static_cast<unsigned long long>(scope.bytes));
+    }
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "scope,allocations,bytes", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const AllocationTracker::ScopeCounts& scope : scopes) {
+            csv << scope.name << "," << scope.allocations << "," << scope.bytes << "\n";
+        }
+    }
+
+    if(allocations > 0) {
+        std::cerr << "Steady state frames allocated on the heap, see the scopes above." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Node transform updates at several sizes and fractions of nodes moved per frame, against a pointer
+// based graph that recomputes every node with glm. The hierarchy is a 4-ary tree, so a moved node
+// also dirties its subtree. Upload is the CPU side of patching the changed matrices into the device
+// buffer. Fails if the two disagree on any world matrix.
+int benchmarkTransforms(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    const uint32_t nodeCounts[] = { 1000, 10000, 100000 };
+    const float dirtyFractions[] = { 0.001f, 0.01f, 0.1f, 1.0f };
+    constexpr uint32_t BRANCHING = 4;
+
+    struct NaiveNode {
+        NaiveNode* parent;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+        glm::mat4 world;
+    };
+
+    struct Row {
+        uint32_t nodes;
+        float fraction;
+        double updated;    // Nodes recomputed per frame.
+        double updateMs;
+        double uploadMs;
+        double uploadBytes;
+        double regions;
+        double naiveMs;
+    };
+    std::vector<Row> rows;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto randomRotation = [&]() {
+        glm::vec3 axis(unit(rng), unit(rng), unit(rng) + 2.0f); // Never zero.
+        return glm::angleAxis(unit(rng) * 3.14159265f, glm::normalize(axis));
+    };
+    auto elapsedMs = [](std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    };
+
+    bool mismatch = false;
+    for(uint32_t nodes : nodeCounts) {
+        for(float fraction : dirtyFractions) {
+            TransformHierarchy hierarchy;
+            hierarchy.init(renderer._allocator, renderer._memoryTelemetry, nodes);
+            std::vector<std::unique_ptr<NaiveNode>> naive;
+            naive.reserve(nodes);
+            for(uint32_t i = 0; i < nodes; i++) {
+                uint32_t parent = i > 0 ? (i - 1) / BRANCHING : TransformHierarchy::INVALID_NODE;
+                glm::vec3 translation(unit(rng), unit(rng), unit(rng));
+                glm::quat rotation = randomRotation();
+                glm::vec3 scale(0.99f);
+                hierarchy.add_node(parent, translation, rotation, scale);
+                naive.push_back(std::make_unique<NaiveNode>(NaiveNode{ i > 0 ? naive[parent].get() : nullptr, translation, rotation, scale, glm::mat4(1.0f) }));
+            }
+            hierarchy.update();
+            renderer.immediate_submit([&](VkCommandBuffer cmd) { hierarchy.upload(cmd, 0); });
+
+            uint32_t moved = std::max(1u, static_cast<uint32_t>(nodes * fraction));
+            std::vector<std::pair<uint32_t, glm::quat>> moves(moved);
+            Row row = { nodes, fraction };
+            for(uint32_t frame = 0; frame < options.warmupFrames + options.measureFrames; frame++) {
+                for(auto& move : moves) {
+                    move = { static_cast<uint32_t>(rng() % nodes), randomRotation() };
+                }
+                bool measured = frame >= options.warmupFrames;
+
+                auto start = std::chrono::high_resolution_clock::now();
+                for(const auto& [node, rotation] : moves) {
+                    hierarchy.set_rotation(node, rotation);
+                }
+                hierarchy.update();
+                double updateMs = elapsedMs(start);
+
+                double uploadMs = 0.0;
+                renderer.immediate_submit([&](VkCommandBuffer cmd) {
+                    auto uploadStart = std::chrono::high_resolution_clock::now();
+                    hierarchy.upload(cmd, frame % LIVE_FRAMES);
+                    uploadMs = elapsedMs(uploadStart);
+                });
+
+                start = std::chrono::high_resolution_clock::now();
+                for(const auto& [node, rotation] : moves) {
+                    naive[node]->rotation = rotation;
+                }
+                for(const std::unique_ptr<NaiveNode>& node : naive) {
+                    glm::mat4 local = glm::translate(glm::mat4(1.0f), node->translation) * glm::mat4_cast(node->rotation) * glm::scale(glm::mat4(1.0f), node->scale);
+                    node->world = node->parent != nullptr ? node->parent->world * local : local;
+                }
+                double naiveMs = elapsedMs(start);
+
+                if(measured) {
+                    const TransformHierarchy::Stats& stats = hierarchy.stats();
+                    row.updated += stats.updatedNodes;
+                    row.updateMs += updateMs;
+                    row.uploadMs += uploadMs;
+                    row.uploadBytes += static_cast<double>(stats.uploadedMatrices) * sizeof(glm::mat4);
+                    row.regions += stats.uploadRegions;
+                    row.naiveMs += naiveMs;
+                }
+            }
+
+            float maxError = 0.0f;
+            for(uint32_t i = 0; i < nodes; i++) {
+                glm::mat4 world = hierarchy.world(i);
+                for(int column = 0; column < 4; column++) {
+                    glm::vec4 difference = glm::abs(world[column] - naive[i]->world[column]);
+                    maxError = std::max(maxError, std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)));
+                }
+            }
+            if(maxError > 1e-3f) {
+                std::cerr << "Transforms differ from the reference by " << maxError << " with " << nodes << " nodes." << std::endl;
+                mismatch = true;
+            }
+            hierarchy.destroy();
+
+            double frames = std::max(1u, options.measureFrames);
+            row.updated /= frames;
+            row.updateMs /= frames;
+            row.uploadMs /= frames;
+            row.uploadBytes /= frames;
+            row.regions /= frames;
+            row.naiveMs /= frames;
+            rows.push_back(row);
+        }
+    }
+
+    std::printf("------- Transform hierarchy (%u measured frames per step, branching %u) -------\n", options.measureFrames, BRANCHING);
+    std::printf("%8s %8s %12s %11s %11s %11s %9s %11s %9s\n", "nodes", "moved %", "recomputed", "update ms", "upload ms", "upload KB", "regions", "naive ms", "speedup");
+    for(const Row& row : rows) {
+        double ms = row.updateMs + row.uploadMs;
+        std::printf("%8u %8.1f %12.0f %11.4f %11.4f %11.1f %9.0f %11.4f %9.2f\n",
+            row.nodes, row.fraction * 100.0f, row.updated, row.updateMs, row.uploadMs, row.uploadBytes / 1024.0, row.regions,
+            row.naiveMs, ms > 0.0 ? row.naiveMs / ms : 0.0);
+    }
+    std::printf("(naive recomputes every node of a pointer based graph with glm; speedup is against update plus upload)\n");
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "nodes,moved_fraction,recomputed,update_ms,upload_ms,upload_bytes,regions,naive_ms", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << row.nodes << "," << row.fraction << "," << row.updated << "," << row.updateMs << "," << row.uploadMs << ","
+                << row.uploadBytes << "," << row.regions << "," << row.naiveMs << "\n";
+        }
+    }
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// CPU frustum culling of random objects around the camera, with and without a distance limit: the
+// scalar path and AVX2 on the calling thread, then AVX2 chunked across the worker pool. Every
+// measured frame culls the whole set once. Fails if a path's visible list differs from the scalar one.
+int benchmarkCulling(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    const uint32_t objectCounts[] = { 10000, 100000, 1000000 };
+    const float maxDistances[] = { 0.0f, 50.0f };
+    constexpr float SCENE_EXTENT = 100.0f; // Objects lie within this of the camera on every axis.
+
+    struct Path {
+        const char* name;
+        bool avx2;
+        bool pooled;
+    };
+    const Path paths[] = {
+        { "scalar", false, false },
+        { "avx2", true, false },
+        { "avx2 pooled", true, true },
+    };
+
+    struct Row {
+        uint32_t objects;
+        float maxDistance;
+        const char* path;
+        uint32_t workers;
+        uint32_t visible;
+        double ms;
+    };
+    std::vector<Row> rows;
+
+    CpuCuller single;
+    single.init(0);
+    CpuCuller pooled;
+    pooled.init();
+    if(!CpuCuller::avx2_supported()) {
+        std::printf("AVX2 isn't supported, the avx2 rows use the scalar path.\n");
+    }
+
+    const Camera& camera = renderer._camera;
+    glm::mat4 viewProj = camera.view_projection(16.0f / 9.0f);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> offset(-SCENE_EXTENT, SCENE_EXTENT);
+    std::uniform_real_distribution<float> halfSize(0.05f, 2.0f);
+
+    bool mismatch = false;
+    std::vector<uint32_t> reference;
+    std::vector<uint32_t> visible;
+    for(uint32_t objectCount : objectCounts) {
+        std::vector<GPUObjectData> objects(objectCount);
+        for(GPUObjectData& object : objects) {
+            glm::vec3 center = camera.position + glm::vec3(offset(rng), offset(rng), offset(rng));
+            glm::vec3 extent(halfSize(rng), halfSize(rng), halfSize(rng));
+            object.model = glm::mat4(1.0f);
+            object.aabbMin = glm::vec4(center - extent, 1.0f);
+            object.aabbMax = glm::vec4(center + extent, 1.0f);
+        }
+        single.set_objects(objects);
+        pooled.set_objects(objects);
+
+        for(float maxDistance : maxDistances) {
+            for(const Path& path : paths) {
+                CpuCuller& culler = path.pooled ? pooled : single;
+                culler.use_avx2(path.avx2);
+
+                double totalMs = 0.0;
+                for(uint32_t frame = 0; frame < options.warmupFrames + options.measureFrames; frame++) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    culler.cull(viewProj, camera.position, maxDistance, visible);
+                    if(frame >= options.warmupFrames) {
+                        totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                    }
+                }
+
+                if(!path.avx2 && !path.pooled) {
+                    reference = visible;
+                } else if(visible != reference) {
+                    std::cerr << "Culling path '" << path.name << "' disagrees with the scalar path on " << objectCount << " objects." << std::endl;
+                    mismatch = true;
+                }
+                rows.push_back({ objectCount, maxDistance, path.name, path.pooled ? culler.workers() : 0,
+                    static_cast<uint32_t>(visible.size()), totalMs / std::max(1u, options.measureFrames) });
+            }
+        }
+    }
+    single.destroy();
+    pooled.destroy();
+
+    std::printf("------- CPU culling (%u measured culls per step) -------\n", options.measureFrames);
+    std::printf("%10s %9s %12s %8s %10s %11s %14s\n", "objects", "distance", "path", "workers", "visible", "ms", "objects / ns");
+    for(const Row& row : rows) {
+        std::printf("%10u %9.0f %12s %8u %10u %11.4f %14.3f\n", row.objects, row.maxDistance, row.path, row.workers, row.visible,
+            row.ms, row.ms > 0.0 ? row.objects / (row.ms * 1e6) : 0.0);
+    }
+    std::printf("(distance 0 culls against the frustum only)\n");
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "objects,max_distance,path,workers,visible,ms,objects_per_ns", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << row.objects << "," << row.maxDistance << "," << row.path << "," << row.workers << "," << row.visible << ","
+                << row.ms << "," << (row.ms > 0.0 ? row.objects / (row.ms * 1e6) : 0.0) << "\n";
+        }
+    }
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Sweeps the GPU particle emission rate. Lifetimes are shortened so the alive count settles during
+// the warmup frames, at about rate times the average lifetime up to the system's capacity. The alive
+// count comes from the debug readback, on for the run; its 4 byte copy lands in the sim scope.
+int benchmarkParticles(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    const float rates[] = { 20000.0f, 200000.0f, 2000000.0f, 8000000.0f };
+    const std::vector<const char*> scopes = { "particle sim", "particles" };
+    constexpr float LIFETIME = 0.5f;
+
+    struct Row {
+        float rate;
+        uint32_t alive;
+        double simMs;
+        double drawMs;
+    };
+    std::vector<Row> rows;
+
+    const bool particleSetting = renderer._frameState.particles;
+    const float rateSetting = renderer._frameState.particleRate;
+    const bool readbackSetting = renderer._frameState.particleReadback;
+    const float lifetimeSetting = renderer._particleEmitter.lifetime;
+    renderer._frameState.particleReadback = true;
+    renderer._particleEmitter.lifetime = LIFETIME;
+    for(float rate : rates) {
+        // Switching the system on resets it, so every step starts empty.
+        renderer._frameState.particles = false;
+        if(aborted(renderer.frame())) {
+            return EXIT_FAILURE;
+        }
+        renderer._frameState.particles = true;
+        renderer._frameState.particleRate = rate;
+
+        std::vector<double> averages;
+        if(aborted(measureScopes(renderer, options, scopes, averages))) {
+            return EXIT_FAILURE;
+        }
+        rows.push_back(Row{ rate, renderer._particles.stats().alive, averages[0], averages[1] });
+    }
+
+    renderer._frameState.particles = particleSetting;
+    renderer._frameState.particleRate = rateSetting;
+    renderer._frameState.particleReadback = readbackSetting;
+    renderer._particleEmitter.lifetime = lifetimeSetting;
+
+    std::printf("------- GPU particles (%u measured frames per step, capacity %u) -------\n", options.measureFrames, renderer._particles.stats().capacity);
+    std::printf("%12s %10s %12s %12s %16s %16s\n", "rate / s", "alive", "sim ms", "draw ms", "sim ns/particle", "draw ns/particle");
+    for(const Row& row : rows) {
+        double alive = std::max(row.alive, 1u);
+        std::printf("%12.0f %10u %12.3f %12.3f %16.3f %16.3f\n", row.rate, row.alive, row.simMs, row.drawMs,
+            row.simMs * 1000000.0 / alive, row.drawMs * 1000000.0 / alive);
+    }
+    std::printf("(emission, simulation and the draw count stay on the GPU; sim includes emitting)\n");
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "rate,alive,sim_ms,draw_ms", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << row.rate << "," << row.alive << "," << row.simMs << "," << row.drawMs << "\n";
+        }
+    }
+
+    if(!renderer._gpuProfiler.supported()) {
+        std::cerr << "Timestamp queries unsupported, GPU times are zero." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Compares the transient pool's backing memory with what dedicated allocations of the same targets
+// would take, with and without the multiview preview, whose layered targets are live only after
+// the main depth buffer's last pass. Fails if aliasing saves nothing once they share the pool.
+int benchmarkTransient(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    struct Row {
+        bool multiview;
+        size_t requests;
+        VkDeviceSize allocated;
+        VkDeviceSize unaliased;
+        VkDeviceSize saved;
+    };
+    std::vector<Row> rows;
+
+    const bool multiviewSetting = renderer._frameState.multiviewPreview;
+    for(bool multiview : { false, true }) {
+        renderer._frameState.multiviewPreview = multiview;
+        for(uint32_t i = 0; i < options.warmupFrames; i++) {
+            if(aborted(renderer.frame())) {
+                return EXIT_FAILURE;
+            }
+        }
+        const TransientImagePool& pool = renderer._transientPool;
+        rows.push_back(Row{ multiview, pool.request_count(), pool.allocated_bytes(), pool.unaliased_bytes(), pool.saved_bytes() });
+    }
+    renderer._frameState.multiviewPreview = multiviewSetting;
+
+    constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+    std::printf("------- Transient targets -------\n");
+    std::printf("%10s %10s %14s %14s %12s\n", "multiview", "targets", "allocated MB", "unaliased MB", "saved MB");
+    for(const Row& row : rows) {
+        std::printf("%10s %10zu %14.2f %14.2f %12.2f\n", row.multiview ? "on" : "off", row.requests,
+            row.allocated / BYTES_PER_MB, row.unaliased / BYTES_PER_MB, row.saved / BYTES_PER_MB);
+    }
+
+    std::ofstream csv;
+    if(!openCsv(options.csvPath, "multiview,targets,allocated_bytes,unaliased_bytes,saved_bytes", csv)) {
+        return EXIT_FAILURE;
+    }
+    if(csv.is_open()) {
+        for(const Row& row : rows) {
+            csv << (row.multiview ? 1 : 0) << "," << row.requests << "," << row.allocated << "," << row.unaliased << "," << row.saved << "\n";
+        }
+    }
+
+    if(rows.back().saved == 0) {
+        std::cerr << "Transient targets with disjoint lifetimes didn't share memory." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int runBenchmark(VulkanRenderer& renderer, const BenchmarkOptions& options) {
+    if(options.name == "lights") {
+        return benchmarkLights(renderer, options);
+    }
+    if(options.name == "commands") {
+        return benchmarkCommands(renderer, options);
+    }
+    if(options.name == "async") {
+        return benchmarkAsyncCompute(renderer, options);
+    }
+    if(options.name == "allocations") {
+        return benchmarkAllocations(renderer, options);
+    }
+    if(options.name == "transforms") {
+        return benchmarkTransforms(renderer, options);
+    }
+    if(options.name == "culling") {
+        return benchmarkCulling(renderer, options);
+    }
+    if(options.name == "particles") {
+        return benchmarkParticles(renderer, options);
+    }
+    if(options.name == "transient") {
+        return benchmarkTransient(renderer, options);
+    }
+
+    std::cerr << "Unknown benchmark '" << options.name << "'. Available: lights, commands, async, allocations, transforms, culling, particles, transient" << std::endl;
+    return EXIT_FAILURE;
+}
+
+} // namespace VxEngine
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Benchmarks run inside the normal renderer (window, swapchain and all passes) so they measure
+// what a real frame costs. GPU times come from the GpuProfiler scopes recorded in draw().
+//
+// Selected from the command line, see main.cpp:
+//   --bench lights|commands|async|allocations|transforms|culling|particles|transient [--frames N] [--csv path]
+
+namespace VxEngine {
+
+class VulkanRenderer;
+
+struct BenchmarkOptions {
+    std::string name;
+    uint32_t warmupFrames = 60;   // Lets timings settle and the profiler catch up with new state.
+    uint32_t measureFrames = 240;
+    std::string csvPath;          // Optional, results are always printed.
+};
+
+// Returns a process exit code. Unknown benchmark names list the available ones.
+int runBenchmark(VulkanRenderer& renderer, const BenchmarkOptions& options);
+
+} // namespace VxEngine
@@ -0,0 +1,59 @@
+#include "vx_buffer.hpp"
+
+namespace VxEngine {
+
+    AllocatedBuffer createBuffer(VmaAllocator allocator, MemoryTelemetry& telemetry, size_t size, VkBufferUsageFlags usage,
+        VmaMemoryUsage memoryUsage, AllocationCategory category, const char* name, std::span<const uint32_t> queueFamilies) {
+        VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.pNext = nullptr;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+        if(queueFamilies.size() > 1) {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+        }
+
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = memoryUsage;
+        if(memoryUsage != VMA_MEMORY_USAGE_GPU_ONLY) {
+            allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        }
+
+        AllocatedBuffer buffer;
+        VX_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.info), "vmaCreateBuffer");
+        telemetry.track(buffer.allocation, category, name);
+
+        VmaAllocatorInfo allocatorInfo;
+        vmaGetAllocatorInfo(allocator, &allocatorInfo);
+
+        VkBufferDeviceAddressInfo addressInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+        addressInfo.buffer = buffer.buffer;
+        buffer.address = vkGetBufferDeviceAddress(allocatorInfo.device, &addressInfo);
+
+        return buffer;
+    }
+
+    void destroyBuffer(VmaAllocator allocator, MemoryTelemetry& telemetry, const AllocatedBuffer& buffer) {
+        telemetry.untrack(buffer.allocation);
+        vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+    }
+
+    void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+        VkMemoryBarrier2 barrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+        barrier.pNext = nullptr;
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage;
+        barrier.dstAccessMask = dstAccess;
+
+        VkDependencyInfo depInfo = {};
+        depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        depInfo.pNext = nullptr;
+        depInfo.memoryBarrierCount = 1;
+        depInfo.pMemoryBarriers = &barrier;
+
+        vkCmdPipelineBarrier2(cmd, &depInfo);
+    }
+
+} // namespace VxEngine
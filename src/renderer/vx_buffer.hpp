@@ -0,0 +1,28 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include <span>
+
+namespace VxEngine {
+
+// A buffer with its VMA allocation. Host visible buffers are persistently mapped
+// (info.pMappedData) and every buffer gets its device address for use in shaders.
+struct AllocatedBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VmaAllocationInfo info = {};
+    VkDeviceAddress address = 0;
+};
+
+// queueFamilies lists the families that use the buffer concurrently, without ownership transfers.
+// Empty (or a single family) for exclusive ownership.
+AllocatedBuffer createBuffer(VmaAllocator allocator, MemoryTelemetry& telemetry, size_t size, VkBufferUsageFlags usage,
+    VmaMemoryUsage memoryUsage, AllocationCategory category, const char* name, std::span<const uint32_t> queueFamilies = {});
+void destroyBuffer(VmaAllocator allocator, MemoryTelemetry& telemetry, const AllocatedBuffer& buffer);
+
+// Global memory barrier. Used for buffer hazards between passes.
+void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+
+} // namespace VxEngine
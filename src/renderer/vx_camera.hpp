@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../../3rdparty/glm/glm/glm.hpp"
+#include "../../3rdparty/glm/glm/gtc/matrix_transform.hpp"
+
+#include <cmath>
+
+// Camera conventions used by every pass:
+//  * Right handed view space, looking down -Z.
+//  * Reverse-Z with an infinite far plane: the near plane maps to depth 1 and infinity to 0.
+//    Depth is cleared to 0 and tested with GREATER / GREATER_OR_EQUAL, which spreads float
+//    precision evenly over distance.
+//  * Y is flipped in the projection to match Vulkan's clip space.
+
+namespace VxEngine {
+
+static constexpr float REVERSE_Z_CLEAR_DEPTH = 0.0f;
+
+// Infinite reverse-Z perspective projection.
+inline glm::mat4 reverseZPerspective(float fovyRadians, float aspect, float zNear) {
+    const float f = 1.0f / std::tan(fovyRadians * 0.5f);
+
+    glm::mat4 proj(0.0f);
+    proj[0][0] = f / aspect;
+    proj[1][1] = -f;
+    proj[2][3] = -1.0f;
+    proj[3][2] = zNear;
+    return proj;
+}
+
+// Recovers the positive view space distance from a reverse-Z depth value.
+inline float linearizeReverseZ(float depth, float zNear) {
+    return zNear / depth;
+}
+
+struct Camera {
+    glm::vec3 position{ 0.0f, 0.0f, 2.5f };
+    float yaw = 0.0f;   // Radians, around +Y.
+    float pitch = 0.0f; // Radians, around +X.
+    float fovy = glm::radians(70.0f);
+    float zNear = 0.1f;
+
+    glm::mat4 view() const {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::rotate(transform, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+        transform = glm::rotate(transform, pitch, glm::vec3(1.0f, 0.0f, 0.0f));
+        return glm::inverse(transform);
+    }
+
+    glm::mat4 projection(float aspect) const {
+        return reverseZPerspective(fovy, aspect, zNear);
+    }
+
+    glm::mat4 view_projection(float aspect) const {
+        return projection(aspect) * view();
+    }
+};
+
+} // namespace VxEngine
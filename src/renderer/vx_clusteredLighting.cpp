@@ -0,0 +1,175 @@
+#include "vx_clusteredLighting.hpp"
+#include "vx_pipeline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace VxEngine {
+
+void ClusteredLighting::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, std::span<const uint32_t> queueFamilies) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+
+    for(uint32_t frame = 0; frame < LIVE_FRAMES; frame++) {
+        _lightBuffers[frame] = createBuffer(_allocator, *_telemetry, sizeof(GPULight) * MAX_LIGHTS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, AllocationCategory::Buffer, "lights", queueFamilies);
+        _paramsBuffers[frame] = createBuffer(_allocator, *_telemetry, sizeof(GPUClusterParams),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, AllocationCategory::Buffer, "cluster params", queueFamilies);
+
+        // Written by one family and read by the other, so these change owner instead.
+        _lightGridBuffers[frame] = createBuffer(_allocator, *_telemetry, sizeof(uint32_t) * 2 * CLUSTER_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "light grid");
+        _lightIndexBuffers[frame] = createBuffer(_allocator, *_telemetry, sizeof(uint32_t) * INDEX_CAPACITY,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "light indices");
+        // Cleared and read back on whichever queue culls, so they never change owner.
+        _counterBuffers[frame] = createBuffer(_allocator, *_telemetry, sizeof(GPULightCounters),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "light counters");
+        _statsBuffers[frame] = createBuffer(_allocator, *_telemetry, sizeof(GPULightCounters),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "light stats");
+        *static_cast<GPULightCounters*>(_statsBuffers[frame].info.pMappedData) = {};
+    }
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo layoutInfo = pipelineLayoutCreateInfo();
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VX_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_cullPipelineLayout), "Light cull pipeline layout creation failed.");
+
+    _cullPipeline = create_compute_pipeline("src/renderer/shaders/light_cull.comp.spv", _device, _cullPipelineLayout);
+}
+
+void ClusteredLighting::destroy() {
+    vkDestroyPipeline(_device, _cullPipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _cullPipelineLayout, nullptr);
+
+    for(uint32_t frame = 0; frame < LIVE_FRAMES; frame++) {
+        destroyBuffer(_allocator, *_telemetry, _lightBuffers[frame]);
+        destroyBuffer(_allocator, *_telemetry, _paramsBuffers[frame]);
+        destroyBuffer(_allocator, *_telemetry, _lightGridBuffers[frame]);
+        destroyBuffer(_allocator, *_telemetry, _lightIndexBuffers[frame]);
+        destroyBuffer(_allocator, *_telemetry, _counterBuffers[frame]);
+        destroyBuffer(_allocator, *_telemetry, _statsBuffers[frame]);
+    }
+}
+
+void ClusteredLighting::set_lights(std::span<const GPULight> lights) {
+    size_t count = std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS));
+    _lights.assign(lights.begin(), lights.begin() + count);
+    _lightsVersion++;
+}
+
+void ClusteredLighting::begin_frame(uint32_t frameIndex, const Camera& camera, VkExtent2D extent) {
+    _frameIndex = frameIndex;
+
+    // The slot's fence has been waited, so its counters are final and its buffers are no longer read by the GPU.
+    vmaInvalidateAllocation(_allocator, _statsBuffers[frameIndex].allocation, 0, VK_WHOLE_SIZE);
+    const GPULightCounters& counters = *static_cast<const GPULightCounters*>(_statsBuffers[frameIndex].info.pMappedData);
+    _stats.indices = std::min(counters.used, INDEX_CAPACITY);
+    _stats.dropped = counters.dropped;
+
+    if(_uploadedVersion[frameIndex] != _lightsVersion) {
+        memcpy(_lightBuffers[frameIndex].info.pMappedData, _lights.data(), _lights.size() * sizeof(GPULight));
+        vmaFlushAllocation(_allocator, _lightBuffers[frameIndex].allocation, 0, _lights.size() * sizeof(GPULight));
+        _uploadedVersion[frameIndex] = _lightsVersion;
+    }
+
+    float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+    float tanHalfFovY = std::tan(camera.fovy * 0.5f);
+
+    // Exponential slicing: slice = log(depth) * scale - bias.
+    float logRange = std::log(CLUSTER_FAR / camera.zNear);
+    float sliceScale = static_cast<float>(GRID_Z) / logRange;
+    float sliceBias = static_cast<float>(GRID_Z) * std::log(camera.zNear) / logRange;
+
+    GPUClusterParams params = {};
+    params.view = camera.view();
+    params.gridSize = glm::uvec4(GRID_X, GRID_Y, GRID_Z, light_count());
+    params.screen = glm::vec4(static_cast<float>(extent.width), static_cast<float>(extent.height), camera.zNear, CLUSTER_FAR);
+    params.projection = glm::vec4(tanHalfFovY * aspect, tanHalfFovY, sliceScale, sliceBias);
+    params.lights = _lightBuffers[frameIndex].address;
+    params.lightGrid = _lightGridBuffers[frameIndex].address;
+    params.lightIndices = _lightIndexBuffers[frameIndex].address;
+    params.counters = _counterBuffers[frameIndex].address;
+
+    memcpy(_paramsBuffers[frameIndex].info.pMappedData, &params, sizeof(params));
+    vmaFlushAllocation(_allocator, _paramsBuffers[frameIndex].allocation, 0, sizeof(params));
+}
+
+// The slot's lists were last read by the frame its fence covered, so they can be overwritten right away.
+void ClusteredLighting::dispatch(CommandRecorder& cmd) {
+    const AllocatedBuffer& counterBuffer = _counterBuffers[_frameIndex];
+    vkCmdFillBuffer(cmd.buffer(), counterBuffer.buffer, 0, sizeof(GPULightCounters), 0);
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+    CullPushConstants pushConstants = { params_address() };
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline, _cullPipelineLayout);
+    cmd.push_constants(_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+    cmd.dispatch((CLUSTER_COUNT + 63) / 64, 1, 1);
+
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_READ_BIT);
+    VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = sizeof(GPULightCounters) };
+    vkCmdCopyBuffer(cmd.buffer(), counterBuffer.buffer, _statsBuffers[_frameIndex].buffer, 1, &region);
+}
+
+void ClusteredLighting::cull(CommandRecorder& cmd) {
+    dispatch(cmd);
+
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_2_SHADER_READ_BIT);
+}
+
+void ClusteredLighting::cull_async(CommandRecorder& cmd, const QueueTransfer& transfer) {
+    dispatch(cmd);
+
+    // Within one family the timeline semaphore between the submits makes the writes visible.
+    if(transfer.needed()) {
+        for(VkBuffer buffer : { _lightGridBuffers[_frameIndex].buffer, _lightIndexBuffers[_frameIndex].buffer }) {
+            bufferOwnershipBarrier(cmd.buffer(), buffer, transfer,
+                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+        }
+    }
+}
+
+void ClusteredLighting::acquire(CommandRecorder& cmd, const QueueTransfer& transfer) {
+    if(transfer.needed()) {
+        for(VkBuffer buffer : { _lightGridBuffers[_frameIndex].buffer, _lightIndexBuffers[_frameIndex].buffer }) {
+            bufferOwnershipBarrier(cmd.buffer(), buffer, transfer,
+                VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+        }
+    }
+}
+
+std::vector<GPULight> makeRandomLights(uint32_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float radius, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<GPULight> lights(count);
+    for(GPULight& light : lights) {
+        glm::vec3 position = glm::mix(boundsMin, boundsMax, glm::vec3(unit(rng), unit(rng), unit(rng)));
+        glm::vec3 color = glm::vec3(unit(rng), unit(rng), unit(rng));
+        light.positionRadius = glm::vec4(position, radius);
+        light.colorIntensity = glm::vec4(color, 1.0f);
+    }
+    return lights;
+}
+
+} // namespace VxEngine
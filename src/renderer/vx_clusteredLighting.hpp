@@ -0,0 +1,124 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_buffer.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_camera.hpp"
+#include "vx_memoryTelemetry.hpp"
+#include "vx_asyncCompute.hpp"
+
+#include "../../3rdparty/glm/glm/glm.hpp"
+
+#include <span>
+#include <vector>
+
+// Clustered light culling. The view frustum is split into GRID_X * GRID_Y screen tiles and
+// GRID_Z exponential depth slices. A compute pass (shaders/light_cull.comp) tests every light
+// against every cluster's view space AABB and writes a per-cluster list of light indices, which
+// the geometry fragment shader loops over instead of the full light buffer. The lists are packed
+// into one index buffer through an atomic counter, so a cluster can hold any number of lights and
+// the buffer is sized for the average rather than the worst cluster. Lights that don't fit are
+// counted and shown in stats().
+//
+// Everything the shaders need is in a per frame GPUClusterParams block passed by device address.
+// The cluster lists are per frame slot too, so culling on the async compute queue can overlap the
+// previous frame's fragment shaders reading the other slot's lists.
+
+namespace VxEngine {
+
+// World space point light (std430).
+struct GPULight {
+    glm::vec4 positionRadius;
+    glm::vec4 colorIntensity;
+};
+
+// Matches ClusterParams in light_cull.comp and colored_triangle.frag (std430).
+struct GPUClusterParams {
+    glm::mat4 view;
+    glm::uvec4 gridSize;   // xyz: cluster counts, w: light count.
+    glm::vec4 screen;      // xy: framebuffer size, z: near plane, w: far clustering plane.
+    glm::vec4 projection;  // xy: tan(fov / 2) horizontally and vertically, z: slice scale, w: slice bias.
+    VkDeviceAddress lights;
+    VkDeviceAddress lightGrid;
+    VkDeviceAddress lightIndices;
+    VkDeviceAddress counters; // GPULightCounters.
+};
+
+// Matches LightCounters in light_cull.comp.
+struct GPULightCounters {
+    uint32_t used;    // Index entries the clusters asked for, may exceed INDEX_CAPACITY.
+    uint32_t dropped; // Lights left out of their cluster's list because the index buffer was full.
+};
+
+class ClusteredLighting {
+public:
+    static constexpr uint32_t GRID_X = 16;
+    static constexpr uint32_t GRID_Y = 9;
+    static constexpr uint32_t GRID_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    static constexpr uint32_t INDEX_CAPACITY = CLUSTER_COUNT * 128; // Light indices for all clusters together, matches light_cull.comp.
+    static constexpr uint32_t MAX_LIGHTS = 131072;
+    static constexpr float CLUSTER_FAR = 100.0f; // Fragments past this share the last slice.
+
+    // Of the frame last finished on the current slot.
+    struct Stats {
+        uint32_t indices = 0; // Index entries used, at most INDEX_CAPACITY.
+        uint32_t dropped = 0; // Lights missing from their clusters' lists, 0 unless the index buffer overflowed.
+    };
+
+    // queueFamilies are the families that read the host written light and parameter buffers.
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, std::span<const uint32_t> queueFamilies);
+    void destroy();
+
+    // Copied and uploaded lazily to each frame slot. Lights past MAX_LIGHTS are ignored.
+    void set_lights(std::span<const GPULight> lights);
+    uint32_t light_count() const { return static_cast<uint32_t>(_lights.size()); }
+
+    // Called once the frame's fence has been waited. Reads back the slot's stats, then uploads the
+    // lights (if changed) and the cluster parameters into it.
+    void begin_frame(uint32_t frameIndex, const Camera& camera, VkExtent2D extent);
+    // Graphics queue: culls and makes the lists visible to the fragment shaders.
+    void cull(CommandRecorder& cmd);
+
+    // Async compute queue: culls and releases the lists to the graphics family. acquire is the graphics
+    // queue's half of the transfer and must be recorded before the geometry passes read the lists.
+    void cull_async(CommandRecorder& cmd, const QueueTransfer& transfer);
+    void acquire(CommandRecorder& cmd, const QueueTransfer& transfer);
+
+    // Address of the current frame's GPUClusterParams.
+    VkDeviceAddress params_address() const { return _paramsBuffers[_frameIndex].address; }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct CullPushConstants {
+        VkDeviceAddress params;
+    };
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    uint32_t _frameIndex = 0;
+
+    std::vector<GPULight> _lights;
+    uint64_t _lightsVersion = 1;
+    uint64_t _uploadedVersion[LIVE_FRAMES] = {};
+
+    AllocatedBuffer _lightBuffers[LIVE_FRAMES];  // Host visible, rewritten when the lights change.
+    AllocatedBuffer _paramsBuffers[LIVE_FRAMES]; // Host visible, rewritten every frame.
+    AllocatedBuffer _lightGridBuffers[LIVE_FRAMES];  // uvec2(offset, count) per cluster.
+    AllocatedBuffer _lightIndexBuffers[LIVE_FRAMES]; // INDEX_CAPACITY indices, the clusters' lists back to back.
+    AllocatedBuffer _counterBuffers[LIVE_FRAMES];    // GPULightCounters, cleared before every cull.
+    AllocatedBuffer _statsBuffers[LIVE_FRAMES];      // Host visible copies of the counters.
+    Stats _stats;
+
+    VkPipelineLayout _cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _cullPipeline = VK_NULL_HANDLE;
+
+    void dispatch(CommandRecorder& cmd);
+};
+
+// Random lights inside a box, for testing and benchmarks.
+std::vector<GPULight> makeRandomLights(uint32_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float radius, uint32_t seed);
+
+} // namespace VxEngine
@@ -0,0 +1,67 @@
+#include "vx_commandCache.hpp"
+
+#include <cstring>
+
+namespace VxEngine {
+
+void CommandCache::init(VkDevice device, uint32_t queueFamilyIndex) {
+    _device = device;
+
+    VkCommandPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // Entries are re-recorded individually.
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    for(VkCommandPool& pool : _pools) {
+        VX_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &pool), "vkCreateCommandPool");
+    }
+}
+
+void CommandCache::destroy() {
+    for(uint32_t frame = 0; frame < LIVE_FRAMES; frame++) {
+        vkDestroyCommandPool(_device, _pools[frame], nullptr); // Frees the entries' buffers.
+        _entries[frame].clear();
+    }
+}
+
+VkCommandBuffer CommandCache::get(const char* name, uint32_t variant, uint32_t frameIndex, uint64_t key,
+    const VkCommandBufferInheritanceRenderingInfo* rendering, CommandStats& stats, RecordFunction record) {
+    uint64_t id = hashValue(variant, hashBytes(name, strlen(name)));
+    Entry& entry = _entries[frameIndex][id];
+
+    if(entry.valid && entry.key == key) {
+        _stats.reused++;
+        return entry.buffer;
+    }
+
+    if(entry.buffer == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocInfo = createCommandBufferAllocateInfo(_pools[frameIndex], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VX_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &entry.buffer), "vkAllocateCommandBuffers");
+    }
+
+    VkCommandBufferInheritanceInfo inheritance = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    inheritance.pNext = rendering;
+
+    // Not one time submit: the buffer is executed again every frame its key holds.
+    VkCommandBufferBeginInfo beginInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = rendering ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    VX_CHECK(vkBeginCommandBuffer(entry.buffer, &beginInfo), "vkBeginCommandBuffer"); // Implicitly resets it.
+    CommandRecorder recorder(entry.buffer, stats); // Starts with nothing bound, like the secondary itself.
+    record(recorder);
+    VX_CHECK(vkEndCommandBuffer(entry.buffer), "vkEndCommandBuffer");
+
+    entry.key = key;
+    entry.valid = true;
+    _stats.recorded++;
+    return entry.buffer;
+}
+
+void CommandCache::invalidate() {
+    for(auto& entries : _entries) {
+        for(auto& [id, entry] : entries) {
+            entry.valid = false;
+        }
+    }
+}
+
+} // namespace VxEngine
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_functionRef.hpp"
+
+#include <unordered_map>
+
+// Reusable secondary command buffers for passes whose commands rarely change. Each entry is
+// identified by a pass name, a variant (e.g. the occlusion phase or the swapchain image index)
+// and the frame slot, and remembers the key it was recorded with. The key is a hash of every
+// input the recorded commands depend on (pipelines, push constants, extents, image handles);
+// the buffer is only re-recorded when the key changes, otherwise the primary just executes it.
+//
+// Entries are per frame slot, so a buffer is never re-recorded while a submitted frame that
+// executes it might still be running (the slot's fence has been waited by then).
+//
+// Secondary command buffers inherit no state, so record functions must bind everything they use,
+// and the primary must rebind anything it uses after executing one.
+
+namespace VxEngine {
+
+class CommandCache {
+public:
+    using RecordFunction = FunctionRef<void(CommandRecorder&)>; // Passes are recorded every frame, so no std::function.
+
+    struct Stats {
+        uint64_t recorded = 0; // Secondary buffers (re-)recorded.
+        uint64_t reused = 0;   // Secondary buffers executed without recording.
+    };
+
+    void init(VkDevice device, uint32_t queueFamilyIndex);
+    void destroy();
+
+    // Returns the entry's secondary command buffer, recording it with record first if its key changed.
+    // rendering is the inheritance info for passes executed inside dynamic rendering, or nullptr.
+    // Commands recorded into the secondary are counted into stats.
+    VkCommandBuffer get(const char* name, uint32_t variant, uint32_t frameIndex, uint64_t key,
+        const VkCommandBufferInheritanceRenderingInfo* rendering, CommandStats& stats, RecordFunction record);
+
+    // Every entry is re-recorded on its next use.
+    void invalidate();
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct Entry {
+        VkCommandBuffer buffer = VK_NULL_HANDLE;
+        uint64_t key = 0;
+        bool valid = false;
+    };
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkCommandPool _pools[LIVE_FRAMES] = {};
+    std::unordered_map<uint64_t, Entry> _entries[LIVE_FRAMES];
+    Stats _stats;
+};
+
+} // namespace VxEngine
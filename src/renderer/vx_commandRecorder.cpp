@@ -0,0 +1,187 @@
+#include "vx_commandRecorder.hpp"
+#include "vx_buffer.hpp"
+#include "vx_image.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace VxEngine {
+
+void CommandRecorder::invalidate() {
+    for(BoundState& bound : _bound) {
+        bound = BoundState{};
+    }
+    _pushValid = false;
+    _viewportValid = false;
+    _scissorValid = false;
+    _rasterValid = 0;
+}
+
+void CommandRecorder::bind_pipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline, VkPipelineLayout layout) {
+    BoundState& bound = _bound[bind_point_index(bindPoint)];
+    if(bound.pipeline == pipeline) {
+        _stats->redundant++;
+        return;
+    }
+
+    if(bound.layout != layout) {
+        bound.setLayout = VK_NULL_HANDLE;
+        _pushValid = false;
+    }
+
+    vkCmdBindPipeline(_cmd, bindPoint, pipeline);
+    bound.pipeline = pipeline;
+    bound.layout = layout;
+    _stats->pipelineBinds++;
+}
+
+void CommandRecorder::bind_descriptor_sets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets) {
+    assert(firstSet + setCount <= MAX_SETS);
+
+    BoundState& bound = _bound[bind_point_index(bindPoint)];
+    if(bound.setLayout == layout && memcmp(&bound.sets[firstSet], sets, setCount * sizeof(VkDescriptorSet)) == 0) {
+        _stats->redundant++;
+        return;
+    }
+
+    vkCmdBindDescriptorSets(_cmd, bindPoint, layout, firstSet, setCount, sets, 0, nullptr);
+
+    // Sets bound with another layout are only known to survive if it is this one.
+    if(bound.setLayout != layout) {
+        memset(bound.sets, 0, sizeof(bound.sets));
+        bound.setLayout = layout;
+    }
+    memcpy(&bound.sets[firstSet], sets, setCount * sizeof(VkDescriptorSet));
+    _stats->descriptorBinds++;
+}
+
+void CommandRecorder::push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) {
+    assert(size <= MAX_PUSH_CONSTANT_SIZE);
+
+    if(_pushValid && _pushLayout == layout && _pushStages == stages && _pushOffset == offset && _pushSize == size &&
+        memcmp(_pushData, data, size) == 0) {
+        _stats->redundant++;
+        return;
+    }
+
+    vkCmdPushConstants(_cmd, layout, stages, offset, size, data);
+    _pushValid = true;
+    _pushLayout = layout;
+    _pushStages = stages;
+    _pushOffset = offset;
+    _pushSize = size;
+    memcpy(_pushData, data, size);
+    _stats->pushConstants++;
+}
+
+void CommandRecorder::set_viewport(const VkViewport& viewport) {
+    if(_viewportValid && memcmp(&_viewport, &viewport, sizeof(VkViewport)) == 0) {
+        _stats->redundant++;
+        return;
+    }
+
+    vkCmdSetViewport(_cmd, 0, 1, &viewport);
+    _viewport = viewport;
+    _viewportValid = true;
+    _stats->dynamicState++;
+}
+
+void CommandRecorder::set_scissor(const VkRect2D& scissor) {
+    if(_scissorValid && memcmp(&_scissor, &scissor, sizeof(VkRect2D)) == 0) {
+        _stats->redundant++;
+        return;
+    }
+
+    vkCmdSetScissor(_cmd, 0, 1, &scissor);
+    _scissor = scissor;
+    _scissorValid = true;
+    _stats->dynamicState++;
+}
+
+void CommandRecorder::set_raster_state(const RasterState& state, uint32_t dynamicState) {
+    auto changed = [this](uint32_t flag, bool same) {
+        if((_rasterValid & flag) && same) {
+            _stats->redundant++;
+            return false;
+        }
+        _rasterValid |= flag;
+        _stats->dynamicState++;
+        return true;
+    };
+
+    if((dynamicState & DYNAMIC_STATE_CULL_MODE) &&
+        changed(DYNAMIC_STATE_CULL_MODE, _raster.cullMode == state.cullMode && _raster.frontFace == state.frontFace)) {
+        vkCmdSetCullMode(_cmd, state.cullMode);
+        vkCmdSetFrontFace(_cmd, state.frontFace);
+        _raster.cullMode = state.cullMode;
+        _raster.frontFace = state.frontFace;
+    }
+    if((dynamicState & DYNAMIC_STATE_DEPTH) &&
+        changed(DYNAMIC_STATE_DEPTH, _raster.depthTest == state.depthTest && _raster.depthWrite == state.depthWrite && _raster.depthCompare == state.depthCompare)) {
+        vkCmdSetDepthTestEnable(_cmd, state.depthTest);
+        vkCmdSetDepthWriteEnable(_cmd, state.depthWrite);
+        vkCmdSetDepthCompareOp(_cmd, state.depthCompare);
+        _raster.depthTest = state.depthTest;
+        _raster.depthWrite = state.depthWrite;
+        _raster.depthCompare = state.depthCompare;
+    }
+    if((dynamicState & DYNAMIC_STATE_TOPOLOGY) && changed(DYNAMIC_STATE_TOPOLOGY, _raster.topology == state.topology)) {
+        vkCmdSetPrimitiveTopology(_cmd, state.topology);
+        _raster.topology = state.topology;
+    }
+    if((dynamicState & DYNAMIC_STATE_BLEND_ENABLE) && changed(DYNAMIC_STATE_BLEND_ENABLE, _raster.blendEnable == state.blendEnable)) {
+        cmdSetColorBlendEnable(_cmd, 0, 1, &state.blendEnable);
+        _raster.blendEnable = state.blendEnable;
+    }
+}
+
+void CommandRecorder::begin_rendering(const VkRenderingInfo& renderInfo) {
+    vkCmdBeginRendering(_cmd, &renderInfo);
+}
+
+void CommandRecorder::end_rendering() {
+    vkCmdEndRendering(_cmd);
+}
+
+void CommandRecorder::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+    vkCmdDraw(_cmd, vertexCount, instanceCount, firstVertex, firstInstance);
+    _stats->draws++;
+}
+
+void CommandRecorder::draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride) {
+    vkCmdDrawIndirect(_cmd, buffer, offset, drawCount, stride);
+    _stats->draws++;
+}
+
+void CommandRecorder::draw_indirect_count(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride) {
+    vkCmdDrawIndirectCount(_cmd, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+    _stats->draws++;
+}
+
+void CommandRecorder::dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) {
+    vkCmdDispatch(_cmd, groupsX, groupsY, groupsZ);
+    _stats->dispatches++;
+}
+
+void CommandRecorder::dispatch_indirect(VkBuffer buffer, VkDeviceSize offset) {
+    vkCmdDispatchIndirect(_cmd, buffer, offset);
+    _stats->dispatches++;
+}
+
+void CommandRecorder::memory_barrier(VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+    memoryBarrier(_cmd, srcStage, srcAccess, dstStage, dstAccess);
+    _stats->barriers++;
+}
+
+void CommandRecorder::transition_image(VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout) {
+    transitionImageLayout(_cmd, image, currentLayout, newLayout);
+    _stats->barriers++;
+}
+
+void CommandRecorder::execute(VkCommandBuffer secondary) {
+    vkCmdExecuteCommands(_cmd, 1, &secondary);
+    invalidate();
+    _stats->executes++;
+}
+
+} // namespace VxEngine
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_pipeline.hpp"
+
+// Thin wrapper around a VkCommandBuffer that remembers the state it bound and drops calls that
+// would bind it again: the same pipeline, the same descriptor sets, identical push constants or
+// unchanged dynamic state. Draws, dispatches, binds and barriers are counted into a
+// CommandStats, so a frame's recording cost shows up next to its GPU timings.
+//
+// The tracking only holds while every state changing command goes through the recorder. Code
+// handed buffer() must not bind state (transfers, queries and timestamps are fine); anything that
+// does, like ImGui, must be followed by invalidate(). Executing secondary command buffers leaves
+// the bound state undefined, so execute() invalidates on its own.
+
+namespace VxEngine {
+
+struct CommandStats {
+    uint32_t draws = 0;
+    uint32_t dispatches = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorBinds = 0;
+    uint32_t pushConstants = 0;
+    uint32_t dynamicState = 0; // Viewport, scissor and raster state sets.
+    uint32_t barriers = 0;
+    uint32_t executes = 0;     // Secondary command buffers executed.
+    uint32_t redundant = 0;    // Binds, pushes and dynamic state dropped as unchanged.
+};
+
+class CommandRecorder {
+public:
+    // Graphics and compute each have their own bound pipeline and descriptor sets.
+    static constexpr uint32_t BIND_POINTS = 2;
+    static constexpr uint32_t MAX_SETS = 4;
+    static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128; // The guaranteed minimum maxPushConstantsSize.
+
+    CommandRecorder(VkCommandBuffer cmd, CommandStats& stats) : _cmd(cmd), _stats(&stats) {}
+
+    // For commands that don't touch bound state.
+    VkCommandBuffer buffer() const { return _cmd; }
+    CommandStats& stats() { return *_stats; }
+
+    // Forgets all bound state, the next binds are recorded unconditionally.
+    void invalidate();
+
+    // layout is the pipeline's layout. Binding a pipeline with another layout may disturb bound
+    // descriptor sets and push constants, so those are forgotten when it changes.
+    void bind_pipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline, VkPipelineLayout layout);
+    void bind_descriptor_sets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets);
+    void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+    void set_viewport(const VkViewport& viewport);
+    void set_scissor(const VkRect2D& scissor);
+    // Sets the parts of state covered by dynamicState (DynamicStateFlags, normally the PipelineCache's),
+    // the rest is baked into the pipeline. Dynamic state outlives pipeline binds as long as every bound
+    // pipeline has it dynamic too, which holds for pipelines from the same PipelineCache.
+    void set_raster_state(const RasterState& state, uint32_t dynamicState);
+
+    void begin_rendering(const VkRenderingInfo& renderInfo);
+    void end_rendering();
+
+    void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+    void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+    void draw_indirect_count(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride);
+    void dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ);
+    void dispatch_indirect(VkBuffer buffer, VkDeviceSize offset);
+
+    void memory_barrier(VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+    void transition_image(VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
+
+    void execute(VkCommandBuffer secondary);
+
+private:
+    struct BoundState {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE; // Of the bound pipeline.
+
+        VkPipelineLayout setLayout = VK_NULL_HANDLE; // Layout the sets were bound with.
+        VkDescriptorSet sets[MAX_SETS] = {};
+    };
+
+    static uint32_t bind_point_index(VkPipelineBindPoint bindPoint) { return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0; }
+
+    VkCommandBuffer _cmd;
+    CommandStats* _stats;
+
+    BoundState _bound[BIND_POINTS];
+
+    bool _pushValid = false;
+    VkPipelineLayout _pushLayout = VK_NULL_HANDLE;
+    VkShaderStageFlags _pushStages = 0;
+    uint32_t _pushOffset = 0;
+    uint32_t _pushSize = 0;
+    uint8_t _pushData[MAX_PUSH_CONSTANT_SIZE] = {};
+
+    bool _viewportValid = false;
+    bool _scissorValid = false;
+    VkViewport _viewport = {};
+    VkRect2D _scissor = {};
+
+    uint32_t _rasterValid = 0; // DynamicStateFlags whose part of _raster was set.
+    RasterState _raster;
+};
+
+} // namespace VxEngine
@@ -0,0 +1,304 @@
+#include "vx_cpuCuller.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define VX_CULL_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace VxEngine {
+
+namespace {
+
+constexpr uint32_t SIMD_WIDTH = 8;
+// Full vector stores may write up to a vector past the last visible index.
+constexpr uint32_t CHUNK_STRIDE = CpuCuller::CHUNK_OBJECTS + SIMD_WIDTH;
+
+// Gribb-Hartmann planes of a reverse-Z projection: x and y within [-w, w], z within [0, w]. z >= 0 is
+// the far plane, which an infinite projection doesn't have; its normal is zero and it passes everything.
+CpuCuller::Frustum extractFrustum(const glm::mat4& viewProj, const glm::vec3& eye, float maxDistance) {
+    auto row = [&](int index) {
+        return glm::vec4(viewProj[0][index], viewProj[1][index], viewProj[2][index], viewProj[3][index]);
+    };
+    const glm::vec4 planes[6] = {
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(3) - row(2),
+        row(2),
+    };
+
+    CpuCuller::Frustum frustum = {};
+    for(int i = 0; i < 6; i++) {
+        glm::vec4 plane = planes[i];
+        float length = glm::length(glm::vec3(plane));
+        plane = length > 1e-6f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        for(int c = 0; c < 4; c++) {
+            frustum.planes[i][c] = plane[c];
+        }
+    }
+    frustum.eye[0] = eye.x;
+    frustum.eye[1] = eye.y;
+    frustum.eye[2] = eye.z;
+    frustum.maxDistance = std::max(maxDistance, 0.0f);
+    return frustum;
+}
+
+// The same operations in the same order as the AVX2 path, so both agree on every object.
+uint32_t cullScalar(const CpuCuller::Frustum& frustum, const float* cx, const float* cy, const float* cz, const float* radius,
+    uint32_t begin, uint32_t end, uint32_t* out) {
+    uint32_t count = 0;
+    for(uint32_t i = begin; i < end; i++) {
+        bool visible = true;
+        for(const float* plane : frustum.planes) {
+            float distance = plane[0] * cx[i] + plane[1] * cy[i] + plane[2] * cz[i] + plane[3];
+            visible &= distance >= -radius[i];
+        }
+        if(frustum.maxDistance > 0.0f) {
+            float dx = cx[i] - frustum.eye[0];
+            float dy = cy[i] - frustum.eye[1];
+            float dz = cz[i] - frustum.eye[2];
+            float limit = frustum.maxDistance + radius[i];
+            visible &= dx * dx + dy * dy + dz * dz <= limit * limit;
+        }
+        out[count] = i;
+        count += visible ? 1 : 0;
+    }
+    return count;
+}
+
+#ifdef VX_CULL_AVX2
+
+// Per 8 bit lane mask, the indices of its set lanes packed 4 bits each, lowest first.
+constexpr std::array<uint32_t, 256> COMPACT_LANES = [] {
+    std::array<uint32_t, 256> table = {};
+    for(uint32_t mask = 0; mask < 256; mask++) {
+        uint32_t packed = 0;
+        uint32_t count = 0;
+        for(uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            if(mask & (1u << lane)) {
+                packed |= lane << (4 * count++);
+            }
+        }
+        table[mask] = packed;
+    }
+    return table;
+}();
+
+__attribute__((target("avx2")))
+uint32_t cullAvx2(const CpuCuller::Frustum& frustum, const float* cx, const float* cy, const float* cz, const float* radius,
+    uint32_t begin, uint32_t end, uint32_t* out) {
+    __m256 planes[6][4];
+    for(int p = 0; p < 6; p++) {
+        for(int c = 0; c < 4; c++) {
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        }
+    }
+    const bool testDistance = frustum.maxDistance > 0.0f;
+    const __m256 eyeX = _mm256_set1_ps(frustum.eye[0]);
+    const __m256 eyeY = _mm256_set1_ps(frustum.eye[1]);
+    const __m256 eyeZ = _mm256_set1_ps(frustum.eye[2]);
+    const __m256 maxDistance = _mm256_set1_ps(frustum.maxDistance);
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256i laneShifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256i laneBits = _mm256_set1_epi32(0xF);
+
+    uint32_t count = 0;
+    uint32_t i = begin;
+    for(; i + SIMD_WIDTH <= end; i += SIMD_WIDTH) {
+        __m256 x = _mm256_loadu_ps(cx + i);
+        __m256 y = _mm256_loadu_ps(cy + i);
+        __m256 z = _mm256_loadu_ps(cz + i);
+        __m256 r = _mm256_loadu_ps(radius + i);
+        __m256 negativeR = _mm256_xor_ps(r, signBit);
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(const __m256* plane : planes) {
+            __m256 distance = _mm256_mul_ps(plane[0], x);
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[1], y));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[2], z));
+            distance = _mm256_add_ps(distance, plane[3]);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, negativeR, _CMP_GE_OQ));
+        }
+        if(testDistance) {
+            __m256 dx = _mm256_sub_ps(x, eyeX);
+            __m256 dy = _mm256_sub_ps(y, eyeY);
+            __m256 dz = _mm256_sub_ps(z, eyeZ);
+            __m256 distanceSq = _mm256_mul_ps(dx, dx);
+            distanceSq = _mm256_add_ps(distanceSq, _mm256_mul_ps(dy, dy));
+            distanceSq = _mm256_add_ps(distanceSq, _mm256_mul_ps(dz, dz));
+            __m256 limit = _mm256_add_ps(maxDistance, r);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(distanceSq, _mm256_mul_ps(limit, limit), _CMP_LE_OQ));
+        }
+
+        // Packs the visible lanes' indices to the front and stores all eight; the count only
+        // advances past the visible ones.
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(visible));
+        __m256i lanes = _mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(COMPACT_LANES[mask])), laneShifts);
+        __m256i indices = _mm256_add_epi32(_mm256_and_si256(lanes, laneBits), _mm256_set1_epi32(static_cast<int>(i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + count), indices);
+        count += static_cast<uint32_t>(std::popcount(mask));
+    }
+    return count + cullScalar(frustum, cx, cy, cz, radius, i, end, out + count);
+}
+
+#endif
+
+} // namespace
+
+bool CpuCuller::avx2_supported() {
+#ifdef VX_CULL_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void CpuCuller::init(uint32_t workers) {
+    _avx2 = avx2_supported();
+
+    if(workers == UINT32_MAX) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workers = std::min(hardwareThreads > 1 ? hardwareThreads - 1 : 0, MAX_WORKERS);
+    }
+    _stopping = false;
+    _workers.reserve(workers);
+    for(uint32_t i = 0; i < workers; i++) {
+        _workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+void CpuCuller::destroy() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _start.notify_all();
+    for(std::thread& worker : _workers) {
+        worker.join();
+    }
+    _workers.clear();
+}
+
+void CpuCuller::set_objects(std::span<const GPUObjectData> objects) {
+    size_t count = objects.size();
+    _centerX.resize(count);
+    _centerY.resize(count);
+    _centerZ.resize(count);
+    _radius.resize(count);
+    for(size_t i = 0; i < count; i++) {
+        glm::vec3 boundsMin(objects[i].aabbMin);
+        glm::vec3 boundsMax(objects[i].aabbMax);
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        _centerX[i] = center.x;
+        _centerY[i] = center.y;
+        _centerZ[i] = center.z;
+        _radius[i] = glm::length(boundsMax - boundsMin) * 0.5f;
+    }
+
+    size_t chunks = (count + CHUNK_OBJECTS - 1) / CHUNK_OBJECTS;
+    _chunkVisible.resize(chunks * CHUNK_STRIDE);
+    _chunkCounts.resize(chunks);
+}
+
+void CpuCuller::cull(const glm::mat4& viewProj, const glm::vec3& eye, float maxDistance, std::vector<uint32_t>& visible) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    _frustum = extractFrustum(viewProj, eye, maxDistance);
+    uint32_t count = size();
+    _stats.objects = count;
+
+    if(count < PARALLEL_THRESHOLD || _workers.empty()) {
+        _stats.chunks = 0;
+        visible.resize(count + SIMD_WIDTH);
+        visible.resize(cull_range(0, count, visible.data()));
+    } else {
+        {
+            // A worker that woke too late for the previous cull may still be on its way out.
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [&]() { return _activeWorkers == 0; });
+            _chunkCount = (count + CHUNK_OBJECTS - 1) / CHUNK_OBJECTS;
+            _nextChunk = 0;
+            _pendingChunks = _chunkCount;
+            _generation++;
+        }
+        _start.notify_all();
+        run_chunks();
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [&]() { return _pendingChunks == 0 && _activeWorkers == 0; });
+        }
+
+        _stats.chunks = _chunkCount;
+        uint32_t total = 0;
+        for(uint32_t chunk = 0; chunk < _chunkCount; chunk++) {
+            total += _chunkCounts[chunk];
+        }
+        visible.resize(total);
+        uint32_t* out = visible.data();
+        for(uint32_t chunk = 0; chunk < _chunkCount; chunk++) {
+            memcpy(out, _chunkVisible.data() + static_cast<size_t>(chunk) * CHUNK_STRIDE, _chunkCounts[chunk] * sizeof(uint32_t));
+            out += _chunkCounts[chunk];
+        }
+    }
+
+    _stats.visible = static_cast<uint32_t>(visible.size());
+    _stats.cpuMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+uint32_t CpuCuller::cull_range(uint32_t begin, uint32_t end, uint32_t* out) const {
+#ifdef VX_CULL_AVX2
+    if(_avx2) {
+        return cullAvx2(_frustum, _centerX.data(), _centerY.data(), _centerZ.data(), _radius.data(), begin, end, out);
+    }
+#endif
+    return cullScalar(_frustum, _centerX.data(), _centerY.data(), _centerZ.data(), _radius.data(), begin, end, out);
+}
+
+void CpuCuller::run_chunks() {
+    while(true) {
+        uint32_t chunk = _nextChunk.fetch_add(1);
+        if(chunk >= _chunkCount) {
+            return;
+        }
+        uint32_t count = size();
+        uint32_t begin = chunk * CHUNK_OBJECTS;
+        uint32_t end = std::min(begin + CHUNK_OBJECTS, count);
+        _chunkCounts[chunk] = cull_range(begin, end, _chunkVisible.data() + static_cast<size_t>(chunk) * CHUNK_STRIDE);
+        if(_pendingChunks.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done.notify_one();
+        }
+    }
+}
+
+void CpuCuller::worker_loop() {
+    uint64_t generation = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _start.wait(lock, [&]() { return _stopping || _generation != generation; });
+            if(_stopping) {
+                return;
+            }
+            generation = _generation;
+            _activeWorkers++;
+        }
+        run_chunks();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _activeWorkers--;
+        }
+        _done.notify_one();
+    }
+}
+
+} // namespace VxEngine
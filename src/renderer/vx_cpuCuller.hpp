@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vx_occlusionCuller.hpp"
+
+#include "../../3rdparty/glm/glm/glm.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Frustum and distance culling on the CPU, for views that don't go through the occlusion culler's
+// GPU draw lists: debug views, shadow cascades and picking. Objects are kept as bounding spheres in
+// one array per component, so eight objects load into one AVX register per component and are tested
+// against all six planes at once. The visible lanes are packed into the output with a lookup table
+// and a variable shift instead of a branch per object. CPUs without AVX2 take the scalar path, picked
+// at runtime.
+//
+// Large counts are split into fixed chunks that the calling thread and a small worker pool claim
+// from an atomic counter. Every chunk writes its own slice of a scratch array, and the slices are
+// concatenated in chunk order, so the result is the same ascending index list on every path.
+
+namespace VxEngine {
+
+class CpuCuller {
+public:
+    static constexpr uint32_t CHUNK_OBJECTS = 4096;                    // Claimed by one thread at a time.
+    static constexpr uint32_t PARALLEL_THRESHOLD = 2 * CHUNK_OBJECTS;  // Fewer are culled on the caller alone.
+    static constexpr uint32_t MAX_WORKERS = 7;
+
+    struct Stats {
+        uint32_t objects = 0;
+        uint32_t visible = 0;
+        uint32_t chunks = 0;  // 0 when the caller culled alone.
+        float cpuMs = 0.0f;
+    };
+
+    // Starts workers threads besides the caller, or one fewer than the hardware threads up to
+    // MAX_WORKERS for UINT32_MAX.
+    void init(uint32_t workers = UINT32_MAX);
+    void destroy();
+
+    // Bounding spheres around the objects' world space AABBs. Call again whenever they change.
+    void set_objects(std::span<const GPUObjectData> objects);
+
+    // Fills visible with the ascending indices of the objects that intersect the frustum of viewProj
+    // (reverse-Z, see vx_camera.hpp) and, if maxDistance is above zero, lie within maxDistance of
+    // eye. visible keeps its capacity, so steady object counts cull without allocating.
+    void cull(const glm::mat4& viewProj, const glm::vec3& eye, float maxDistance, std::vector<uint32_t>& visible);
+
+    // The AVX2 path is on by default where the CPU supports it.
+    static bool avx2_supported();
+    void use_avx2(bool enabled) { _avx2 = enabled && avx2_supported(); }
+    bool avx2() const { return _avx2; }
+
+    uint32_t workers() const { return static_cast<uint32_t>(_workers.size()); }
+    uint32_t size() const { return static_cast<uint32_t>(_radius.size()); }
+    const Stats& stats() const { return _stats; }
+
+    // Planes point inwards and are normalized, so a plane's distance to a sphere's center is
+    // compared against the radius directly.
+    struct Frustum {
+        float planes[6][4];
+        float eye[3];
+        float maxDistance; // 0 for none.
+    };
+
+private:
+    uint32_t cull_range(uint32_t begin, uint32_t end, uint32_t* out) const;
+    void run_chunks();
+    void worker_loop();
+
+    // Bounding spheres by object index.
+    std::vector<float> _centerX;
+    std::vector<float> _centerY;
+    std::vector<float> _centerZ;
+    std::vector<float> _radius;
+
+    bool _avx2 = false;
+    Frustum _frustum = {};
+    Stats _stats;
+
+    // Parallel culls. The job fields are written by cull() under _mutex while no worker is active.
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    uint64_t _generation = 0;
+    bool _stopping = false;
+    uint32_t _activeWorkers = 0;
+    uint32_t _chunkCount = 0;
+    std::atomic<uint32_t> _nextChunk = 0;
+    std::atomic<uint32_t> _pendingChunks = 0;
+    std::vector<uint32_t> _chunkVisible; // A slice per chunk, see cull_range()'s output.
+    std::vector<uint32_t> _chunkCounts;
+};
+
+} // namespace VxEngine
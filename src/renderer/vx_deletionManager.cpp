@@ -9,4 +9,20 @@ void DeletionManager::delete_objects() {
     }
 }
 
+void DeletionManager::append(DeletionManager& other) {
+    std::vector<std::function<void()>> functions; // Newest first.
+    {
+        std::lock_guard<std::mutex> lock(other._mutex);
+        while(!other._deletionStack.empty()) {
+            functions.push_back(std::move(other._deletionStack.top()));
+            other._deletionStack.pop();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(auto it = functions.rbegin(); it != functions.rend(); ++it) {
+        _deletionStack.push(std::move(*it));
+    }
+}
+
 } // namespace VxEngine
\ No newline at end of file
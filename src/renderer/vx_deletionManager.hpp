@@ -1,8 +1,9 @@
 #pragma once
 
-#include <deque>
 #include <functional>
+#include <mutex>
 #include <stack>
+#include <vector>
 
 // Simple class to manage the deletion of vulkan objects.
 // Maintains an internal queue of functions to delete vulkan objects
@@ -18,14 +19,23 @@ public:
     DeletionManager() = default;
     ~DeletionManager() = default;
 
+    // Init phases may run on worker threads, so pushes are serialized.
     void push_function(std::function<void()> function) {
-        _deletionStack.push(function);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _deletionStack.push(std::move(function));
     }
 
     void delete_objects();
 
+    // Moves other's functions on top of this stack, keeping their order, so they run before
+    // everything pushed here so far.
+    void append(DeletionManager& other);
+
 private:
-    std::stack<std::function<void()>> _deletionStack; // Stack of deletion functions.
+    // Stack of deletion functions. On a vector, so a per frame manager keeps its capacity between frames
+    // instead of a deque allocating and freeing blocks. Frames only push when they retire objects.
+    std::stack<std::function<void()>, std::vector<std::function<void()>>> _deletionStack;
+    std::mutex _mutex;
 };
 
 } // namespace VxEngine
\ No newline at end of file
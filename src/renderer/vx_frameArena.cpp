@@ -0,0 +1,53 @@
+#include "vx_frameArena.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace VxEngine {
+
+namespace {
+
+constexpr size_t ARENA_ALIGNMENT = alignof(std::max_align_t);
+
+} // namespace
+
+void FrameArena::init(size_t capacity) {
+    destroy();
+    _memory = static_cast<std::byte*>(::operator new(capacity, std::align_val_t(ARENA_ALIGNMENT)));
+    _capacity = capacity;
+    _offset = 0;
+    _stats = {};
+}
+
+void FrameArena::destroy() {
+    if(_memory != nullptr) {
+        ::operator delete(_memory, std::align_val_t(ARENA_ALIGNMENT));
+        _memory = nullptr;
+    }
+    _capacity = 0;
+    _offset = 0;
+    _overflow.release();
+}
+
+void FrameArena::reset() {
+    _stats.highWater = std::max(_stats.highWater, _stats.used);
+    _stats.used = 0;
+    _offset = 0;
+    _overflow.release();
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+    // The block itself is max_align_t aligned, so aligning the offset aligns the address.
+    size_t start = (_offset + alignment - 1) & ~(alignment - 1);
+    if(alignment <= ARENA_ALIGNMENT && start + bytes <= _capacity) {
+        _stats.used += start + bytes - _offset;
+        _offset = start + bytes;
+        return _memory + start;
+    }
+
+    _stats.overflows++;
+    _stats.used += bytes;
+    return _overflow.allocate(bytes, alignment);
+}
+
+} // namespace VxEngine
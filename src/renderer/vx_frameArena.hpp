@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Bump allocator for CPU data that only lives while a frame is recorded, e.g. the multiview matrices
+// or the transient pool's scratch arrays. Containers take it as a std::pmr::memory_resource; freeing
+// does nothing and reset() reclaims everything at once at the start of the next frame.
+//
+// Requests that don't fit the block go to the heap until the next reset(). They are counted, so the
+// capacity can be raised until the steady state never overflows.
+
+namespace VxEngine {
+
+class FrameArena final : public std::pmr::memory_resource {
+public:
+    struct Stats {
+        size_t used = 0;          // Bytes handed out since the last reset, including padding.
+        size_t highWater = 0;     // Most used in any frame.
+        uint64_t overflows = 0;   // Requests that went to the heap, since init.
+    };
+
+    FrameArena() = default;
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    ~FrameArena() { destroy(); }
+
+    void init(size_t capacity);
+    void destroy();
+
+    // Everything allocated since the previous reset is released. Only the thread allocating from it may call this.
+    void reset();
+
+    size_t capacity() const { return _capacity; }
+    const Stats& stats() const { return _stats; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* memory, size_t bytes, size_t alignment) override {} // Released by reset().
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::byte* _memory = nullptr;
+    size_t _capacity = 0;
+    size_t _offset = 0;
+    std::pmr::monotonic_buffer_resource _overflow{ std::pmr::new_delete_resource() };
+    Stats _stats;
+};
+
+} // namespace VxEngine
@@ -0,0 +1,91 @@
+#include "vx_framePacket.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace VxEngine {
+
+namespace {
+
+// Grows dst only when src doesn't fit. Assigning an ImVector frees and reallocates it.
+template<typename T>
+void copyInto(ImVector<T>& dst, const ImVector<T>& src) {
+    dst.resize(src.Size);
+    if(src.Size > 0) {
+        std::memcpy(dst.Data, src.Data, src.size_in_bytes());
+    }
+}
+
+} // namespace
+
+ImGuiDrawSnapshot::ImGuiDrawSnapshot(ImGuiDrawSnapshot&& other) noexcept {
+    *this = std::move(other);
+}
+
+ImGuiDrawSnapshot& ImGuiDrawSnapshot::operator=(ImGuiDrawSnapshot&& other) noexcept {
+    if(this != &other) {
+        // ImDrawData has no move, and copying it would reallocate CmdLists.
+        _drawData.CmdLists.swap(other._drawData.CmdLists);
+        std::swap(_drawData.Valid, other._drawData.Valid);
+        std::swap(_drawData.CmdListsCount, other._drawData.CmdListsCount);
+        std::swap(_drawData.TotalIdxCount, other._drawData.TotalIdxCount);
+        std::swap(_drawData.TotalVtxCount, other._drawData.TotalVtxCount);
+        std::swap(_drawData.DisplayPos, other._drawData.DisplayPos);
+        std::swap(_drawData.DisplaySize, other._drawData.DisplaySize);
+        std::swap(_drawData.FramebufferScale, other._drawData.FramebufferScale);
+        std::swap(_drawData.OwnerViewport, other._drawData.OwnerViewport);
+        _lists.swap(other._lists);
+        std::swap(_valid, other._valid);
+    }
+    return *this;
+}
+
+ImGuiDrawSnapshot::~ImGuiDrawSnapshot() {
+    for(ImDrawList* list : _lists) {
+        IM_DELETE(list);
+    }
+}
+
+void ImGuiDrawSnapshot::capture(const ImDrawData* source) {
+    clear();
+    if(source == nullptr || !source->Valid) {
+        return;
+    }
+
+    while(_lists.Size < source->CmdLists.Size) {
+        _lists.push_back(IM_NEW(ImDrawList)(source->CmdLists[_lists.Size]->_Data));
+    }
+
+    // Field by field, for the same reason as the move.
+    _drawData.Valid = true;
+    _drawData.CmdListsCount = source->CmdListsCount;
+    _drawData.TotalIdxCount = source->TotalIdxCount;
+    _drawData.TotalVtxCount = source->TotalVtxCount;
+    _drawData.DisplayPos = source->DisplayPos;
+    _drawData.DisplaySize = source->DisplaySize;
+    _drawData.FramebufferScale = source->FramebufferScale;
+    _drawData.OwnerViewport = source->OwnerViewport;
+    _drawData.CmdLists.resize(source->CmdLists.Size);
+    for(int i = 0; i < source->CmdLists.Size; i++) {
+        // What ImDrawList::CloneOutput copies.
+        const ImDrawList* from = source->CmdLists[i];
+        ImDrawList* list = _lists[i];
+        copyInto(list->CmdBuffer, from->CmdBuffer);
+        copyInto(list->IdxBuffer, from->IdxBuffer);
+        copyInto(list->VtxBuffer, from->VtxBuffer);
+        list->Flags = from->Flags;
+        _drawData.CmdLists[i] = list;
+    }
+    _valid = true;
+}
+
+void ImGuiDrawSnapshot::clear() {
+    _drawData.CmdLists.resize(0); // Keeps the capacity, unlike ImDrawData::Clear.
+    _drawData.Valid = false;
+    _drawData.CmdListsCount = 0;
+    _drawData.TotalIdxCount = 0;
+    _drawData.TotalVtxCount = 0;
+    _valid = false;
+}
+
+} // namespace VxEngine
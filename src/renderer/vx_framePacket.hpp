@@ -0,0 +1,87 @@
+#pragma once
+
+#include "vx_camera.hpp"
+#include "vx_pipeline.hpp"
+#include "vx_multiview.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include "../../3rdparty/imgui/imgui.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// What the main thread hands the render thread for one frame. Packets are immutable once
+// pushed: the main thread goes on polling input and building the next UI while the render
+// thread waits on fences and the swapchain, and neither touches the other's copy.
+//
+// Both threads keep their packet between frames. Moving one into or out of the ring swaps the
+// UI snapshot's storage with the slot's, so the same few buffers circulate instead of being
+// allocated for every frame.
+
+namespace VxEngine {
+
+// Everything the main thread decides for a frame: the view and the settings edited in the UI.
+struct FrameState {
+    static constexpr uint32_t MAX_BACKGROUND_EFFECTS = 4; // VulkanRenderer::add_background_effect skips effects past this.
+
+    Camera camera;
+
+    int computePipeline = 0;
+    std::array<ComputePushConstants, MAX_BACKGROUND_EFFECTS> effectData = {}; // Per background effect. Fixed, so copies don't allocate.
+
+    bool depthPrepass = false;
+    bool occlusionCulling = true;
+    bool cpuCulling = false;
+    float cullDistance = 0.0f;
+    bool reuseCommandBuffers = true;
+    bool asyncCompute = true;
+    bool multiviewPreview = false;
+    int multiviewLayout = static_cast<int>(MultiviewLayout::Cubemap);
+    int lightCount = 64;
+    bool particles = false;
+    float particleRate = 100000.0f; // Per second.
+    bool particleReadback = false;  // Debug copy of the alive count to the host.
+    float memoryWarningRatio = MemoryTelemetry::DEFAULT_WARNING_RATIO;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR; // Changing it recreates the swapchain.
+};
+
+// Owning copy of a frame's ImGui draw data. ImGui reuses its draw lists on the next NewFrame,
+// so the lists are copied before the main thread moves on. The font atlas is uploaded once,
+// so the draw data references no state that changes between frames.
+//
+// The copies go into lists the snapshot keeps, which only grow, so a UI of steady size is
+// captured without allocating. Moving swaps two snapshots, lists included.
+class ImGuiDrawSnapshot {
+public:
+    ImGuiDrawSnapshot() = default;
+    ImGuiDrawSnapshot(ImGuiDrawSnapshot&& other) noexcept;
+    ImGuiDrawSnapshot& operator=(ImGuiDrawSnapshot&& other) noexcept;
+    ImGuiDrawSnapshot(const ImGuiDrawSnapshot&) = delete;
+    ImGuiDrawSnapshot& operator=(const ImGuiDrawSnapshot&) = delete;
+    ~ImGuiDrawSnapshot();
+
+    void capture(const ImDrawData* source);
+    // Forgets the captured frame, the lists are kept for the next capture.
+    void clear();
+
+    // nullptr if nothing was captured.
+    ImDrawData* draw_data() { return _valid ? &_drawData : nullptr; }
+
+private:
+    ImDrawData _drawData;          // CmdLists points into _lists.
+    ImVector<ImDrawList*> _lists;  // Owned.
+    bool _valid = false;
+};
+
+struct FramePacket {
+    uint64_t number = 0;
+    bool quit = false;      // Nothing to draw, the render thread exits.
+    VkExtent2D windowExtent = {}; // In pixels, the swapchain is recreated when it changes.
+    bool hasInput = false;
+    std::chrono::high_resolution_clock::time_point inputTime; // Oldest input event polled for this frame.
+    FrameState state;
+    ImGuiDrawSnapshot ui;
+};
+
+} // namespace VxEngine
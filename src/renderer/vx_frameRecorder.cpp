@@ -0,0 +1,339 @@
+#include "vx_frameRecorder.hpp"
+#include "vx_renderer.hpp"
+#include "vx_imageWriter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace VxEngine {
+
+namespace {
+
+constexpr uint32_t MODE_RGBA8 = 0;
+constexpr uint32_t MODE_I420 = 1;
+constexpr size_t FILE_BUFFER_BYTES = 16 * 1024 * 1024;
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+void FrameRecorder::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, VkDescriptorSetLayout drawImageLayout) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(FramePushConstants);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo layoutInfo = pipelineLayoutCreateInfo();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &drawImageLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VX_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout), "Frame convert pipeline layout creation failed.");
+
+    _pipeline = create_compute_pipeline("src/renderer/shaders/frame_convert.comp.spv", _device, _pipelineLayout);
+}
+
+void FrameRecorder::destroy() {
+    if(_active) {
+        stop();
+    }
+    vkDestroyPipeline(_device, _pipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+}
+
+bool FrameRecorder::start(const RecorderOptions& options, VkExtent2D extent) {
+    _options = options;
+    _extent = extent;
+    if(options.format == RecordFormat::Y4M) {
+        _extent.width &= ~7u;
+        _extent.height &= ~1u;
+        _frameBytes = static_cast<size_t>(_extent.width) * _extent.height * 3 / 2;
+    } else {
+        _frameBytes = static_cast<size_t>(_extent.width) * _extent.height * 4;
+    }
+
+    if(_extent.width == 0 || _extent.height == 0) {
+        std::cerr << "Recorder: draw extent too small" << std::endl;
+        return false;
+    }
+
+    if(options.format != RecordFormat::PNGSequence) {
+        // The buffer must be installed before the file is opened.
+        _fileBuffer.resize(FILE_BUFFER_BYTES);
+        _file.rdbuf()->pubsetbuf(_fileBuffer.data(), static_cast<std::streamsize>(_fileBuffer.size()));
+        _file.open(options.path, std::ios::binary | std::ios::trunc);
+        if(!_file.is_open()) {
+            std::cerr << "Recorder: failed to open " << options.path << std::endl;
+            return false;
+        }
+
+        if(options.format == RecordFormat::Y4M) {
+            char header[128];
+            int length = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+                _extent.width, _extent.height, options.fps);
+            _file.write(header, length);
+        }
+    }
+
+    _buffers.clear();
+    _freeBuffers.clear();
+    for(uint32_t i = 0; i < BUFFER_COUNT; i++) {
+        _buffers.push_back(createBuffer(_allocator, *_telemetry, _frameBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "recorder frame"));
+        _freeBuffers.push_back(i);
+    }
+    for(uint32_t slot = 0; slot < LIVE_FRAMES; slot++) {
+        _pending[slot] = -1;
+    }
+
+    _stats = RecorderStats{};
+    _recordedFrames = 0;
+    _stopping = false;
+    _writeFailed = false;
+    _active = true;
+    _worker = std::thread(&FrameRecorder::worker_loop, this);
+    return true;
+}
+
+RecorderStats FrameRecorder::stop() {
+    // The device is idle, so every slot's frame has landed.
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t slot = 0; slot < LIVE_FRAMES; slot++) {
+            if(_pending[slot] >= 0) {
+                _jobs.push_back(Job{ static_cast<uint32_t>(_pending[slot]), _pendingFrame[slot] });
+                _pending[slot] = -1;
+            }
+        }
+        // Oldest frame first.
+        std::sort(_jobs.begin(), _jobs.end(), [](const Job& a, const Job& b) { return a.frame < b.frame; });
+        _stopping = true;
+    }
+    _jobCondition.notify_one();
+    _worker.join();
+
+    _file.close();
+    for(const AllocatedBuffer& buffer : _buffers) {
+        destroyBuffer(_allocator, *_telemetry, buffer);
+    }
+    _buffers.clear();
+    _freeBuffers.clear();
+    _fileBuffer = {};
+    _active = false;
+
+    if(_writeFailed) {
+        std::cerr << "Recorder: writing " << _options.path << " failed" << std::endl;
+    }
+    return _stats;
+}
+
+void FrameRecorder::begin_frame(uint32_t frameIndex) {
+    _frameIndex = frameIndex;
+    if(!_active || _pending[frameIndex] < 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(Job{ static_cast<uint32_t>(_pending[frameIndex]), _pendingFrame[frameIndex] });
+    }
+    _pending[frameIndex] = -1;
+    _jobCondition.notify_one();
+}
+
+void FrameRecorder::record(CommandRecorder& cmd, VkDescriptorSet drawImageSet, VkImage image, VkImageLayout layout) {
+    if(!_active) {
+        return;
+    }
+
+    uint32_t buffer = acquire_buffer();
+    _pending[_frameIndex] = static_cast<int32_t>(buffer);
+    _pendingFrame[_frameIndex] = _recordedFrames++;
+
+    cmd.transition_image(image, layout, VK_IMAGE_LAYOUT_GENERAL);
+
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline, _pipelineLayout);
+    cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &drawImageSet);
+
+    FramePushConstants pushConstants = {};
+    pushConstants.frame = _buffers[buffer].address;
+    pushConstants.size = glm::uvec2(_extent.width, _extent.height);
+    pushConstants.mode = _options.format == RecordFormat::Y4M ? MODE_I420 : MODE_RGBA8;
+    cmd.push_constants(_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FramePushConstants), &pushConstants);
+
+    // I420 threads cover 8x2 pixel blocks.
+    uint32_t threadsX = pushConstants.mode == MODE_I420 ? _extent.width / 8 : _extent.width;
+    uint32_t threadsY = pushConstants.mode == MODE_I420 ? _extent.height / 2 : _extent.height;
+    cmd.dispatch((threadsX + 7) / 8, (threadsY + 7) / 8, 1);
+
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_HOST_BIT,
+        VK_ACCESS_2_HOST_READ_BIT);
+
+    cmd.transition_image(image, VK_IMAGE_LAYOUT_GENERAL, layout);
+}
+
+uint32_t FrameRecorder::acquire_buffer() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if(_freeBuffers.empty()) {
+        // Every buffer is queued behind the writer: output is the bottleneck.
+        auto start = std::chrono::steady_clock::now();
+        _freeCondition.wait(lock, [this]() { return !_freeBuffers.empty(); });
+        _stats.stallMs += millisecondsSince(start);
+    }
+
+    uint32_t buffer = _freeBuffers.back();
+    _freeBuffers.pop_back();
+    return buffer;
+}
+
+void FrameRecorder::worker_loop() {
+    while(true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _jobCondition.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+            if(_jobs.empty()) {
+                return; // Stopping and drained.
+            }
+            job = _jobs.front();
+            _jobs.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        write(job);
+        double ms = millisecondsSince(start);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.writeMs += ms;
+            _stats.frames++;
+            _stats.bytes += _frameBytes;
+            _freeBuffers.push_back(job.buffer);
+        }
+        _freeCondition.notify_one();
+    }
+}
+
+void FrameRecorder::write(const Job& job) {
+    const AllocatedBuffer& buffer = _buffers[job.buffer];
+    vmaInvalidateAllocation(_allocator, buffer.allocation, 0, _frameBytes);
+    const uint8_t* pixels = static_cast<const uint8_t*>(buffer.info.pMappedData);
+
+    switch(_options.format) {
+        case RecordFormat::Y4M:
+            _file.write("FRAME\n", 6);
+            [[fallthrough]];
+        case RecordFormat::RawRGBA:
+            _file.write(reinterpret_cast<const char*>(pixels), static_cast<std::streamsize>(_frameBytes));
+            _writeFailed |= !_file.good();
+            break;
+        case RecordFormat::PNGSequence: {
+            char path[512];
+            std::snprintf(path, sizeof(path), "%s_%06u.png", _options.path.c_str(), job.frame);
+            _writeFailed |= !writePNG(path, _extent.width, _extent.height, pixels);
+            break;
+        }
+    }
+}
+
+bool parseRecordFormat(const char* name, RecordFormat& format) {
+    if(strcmp(name, "y4m") == 0) {
+        format = RecordFormat::Y4M;
+    } else if(strcmp(name, "rgba") == 0) {
+        format = RecordFormat::RawRGBA;
+    } else if(strcmp(name, "png") == 0) {
+        format = RecordFormat::PNGSequence;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int runRecording(VulkanRenderer& renderer, const RecorderOptions& options) {
+    FrameRecorder& recorder = renderer._frameRecorder;
+    if(!recorder.start(options, renderer._drawExtent)) {
+        return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    double frameMs = 0.0;
+    double gpuMs = 0.0;
+    uint32_t gpuSamples = 0;
+    uint32_t drawn = 0;
+    for(; drawn < options.frames; drawn++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        if(!renderer.frame()) {
+            break;
+        }
+        frameMs += millisecondsSince(frameStart);
+
+        // The profiler lags by LIVE_FRAMES, which doesn't matter for an average.
+        double frameGpuMs = 0.0;
+        for(const GpuProfiler::ScopeResult& scope : renderer._gpuProfiler.results()) {
+            frameGpuMs += scope.ms;
+        }
+        if(frameGpuMs > 0.0) {
+            gpuMs += frameGpuMs;
+            gpuSamples++;
+        }
+    }
+
+    VX_CHECK(vkDeviceWaitIdle(renderer._device), "vkDeviceWaitIdle");
+    RecorderStats stats = recorder.stop();
+    double totalMs = millisecondsSince(start);
+
+    if(stats.frames == 0) {
+        std::cerr << "Recorder: no frames written" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const char* formats[] = { "y4m", "rgba", "png" };
+    VkExtent2D extent = recorder.extent();
+    double perFrame = 1.0 / stats.frames;
+    double wallMs = totalMs * perFrame;
+    double gpuAverage = gpuSamples > 0 ? gpuMs / gpuSamples : 0.0;
+    double stallAverage = stats.stallMs * perFrame;
+    double renderAverage = (frameMs - stats.stallMs) / std::max(drawn, 1u); // CPU time of frame() without stalls.
+    double writeAverage = stats.writeMs * perFrame;
+
+    // The slowest stage bounds throughput. Any real stall means the writer couldn't keep up.
+    const char* bottleneck = "gpu";
+    double slowest = gpuAverage;
+    if(renderAverage > slowest) {
+        bottleneck = "render loop (cpu)";
+        slowest = renderAverage;
+    }
+    if(writeAverage > slowest || stallAverage > 0.1 * wallMs) {
+        bottleneck = "encode / write";
+    }
+
+    std::printf("------- Recording: %s (%s, %ux%u) -------\n", options.path.c_str(), formats[static_cast<uint32_t>(options.format)], extent.width, extent.height);
+    std::printf("%-22s %u\n", "frames", stats.frames);
+    std::printf("%-22s %.2f fps (%.3f ms/frame)\n", "sustained", 1000.0 / wallMs, wallMs);
+    std::printf("%-22s %.1f MB/s\n", "output", stats.bytes / (totalMs * 1000.0));
+    std::printf("%-22s %.3f ms/frame\n", "gpu", gpuAverage);
+    std::printf("%-22s %.3f ms/frame\n", "render loop", renderAverage);
+    std::printf("%-22s %.3f ms/frame\n", "encode + write", writeAverage);
+    std::printf("%-22s %.3f ms/frame\n", "render stalls", stallAverage);
+    std::printf("%-22s %s\n", "bottleneck", bottleneck);
+    if(options.format == RecordFormat::RawRGBA) {
+        std::printf("(play with: ffplay -f rawvideo -pixel_format rgba -video_size %ux%u %s)\n", extent.width, extent.height, options.path.c_str());
+    }
+
+    return drawn == options.frames ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // namespace VxEngine
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_buffer.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_pipeline.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams every drawn frame to disk for offline renders and visual tests. The output is a
+// three stage pipeline so that sustained throughput is bound by the GPU:
+//  1. GPU: a compute pass converts the draw image to RGBA8 or I420 straight into one of a small
+//     ring of host visible buffers, in the frame's own command buffer.
+//  2. Once the frame slot's fence has been waited, the buffer is queued to a writer thread.
+//  3. The writer streams it through a large file buffer (or encodes a PNG) and returns it to the ring.
+// The render loop only waits when every buffer is queued behind the writer, and that wait is
+// reported as a stall.
+//
+// Selected from the command line, see main.cpp:
+//   --record <path> [--format y4m|rgba|png] [--frames N]
+
+namespace VxEngine {
+
+class VulkanRenderer;
+
+enum class RecordFormat : uint32_t {
+    Y4M = 0,     // YUV4MPEG2, 4:2:0. Width is cropped to a multiple of 8, height to a multiple of 2.
+    RawRGBA,     // Headerless 8 bit RGBA frames, back to back.
+    PNGSequence, // <path>_000000.png, ...
+};
+
+struct RecorderOptions {
+    std::string path;
+    RecordFormat format = RecordFormat::Y4M;
+    uint32_t frames = 240;
+    uint32_t fps = 60; // Stored in the Y4M header.
+};
+
+struct RecorderStats {
+    uint32_t frames = 0;
+    uint64_t bytes = 0;
+    double stallMs = 0.0; // Total time the render loop waited for a free buffer.
+    double writeMs = 0.0; // Total encode and write time on the writer thread.
+};
+
+class FrameRecorder {
+public:
+    // Two frames in flight on the GPU plus slack for the writer.
+    static constexpr uint32_t BUFFER_COUNT = LIVE_FRAMES + 2;
+
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, VkDescriptorSetLayout drawImageLayout);
+    void destroy();
+
+    // Opens the output and allocates the ring for extent. Returns false if the output can't be opened.
+    bool start(const RecorderOptions& options, VkExtent2D extent);
+    // The device must be idle. Writes every outstanding frame and closes the output.
+    RecorderStats stop();
+
+    bool active() const { return _active; }
+    VkExtent2D extent() const { return _extent; }
+
+    // Called once the frame slot's fence has been waited. Queues the slot's frame to the writer.
+    void begin_frame(uint32_t frameIndex);
+    // Converts the draw image (in layout) into a free buffer. The image is returned to layout.
+    void record(CommandRecorder& cmd, VkDescriptorSet drawImageSet, VkImage image, VkImageLayout layout);
+
+private:
+    struct Job {
+        uint32_t buffer;
+        uint32_t frame;
+    };
+
+    struct FramePushConstants {
+        VkDeviceAddress frame;
+        glm::uvec2 size;
+        uint32_t mode;
+        uint32_t pad;
+    };
+
+    uint32_t acquire_buffer();
+    void worker_loop();
+    void write(const Job& job);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _pipeline = VK_NULL_HANDLE;
+
+    RecorderOptions _options;
+    VkExtent2D _extent = {};
+    size_t _frameBytes = 0;
+    bool _active = false;
+    uint32_t _frameIndex = 0;
+    uint32_t _recordedFrames = 0;
+
+    std::vector<AllocatedBuffer> _buffers;
+    int32_t _pending[LIVE_FRAMES]; // Buffer recorded by each frame slot, or -1. Render thread only.
+    uint32_t _pendingFrame[LIVE_FRAMES];
+
+    std::ofstream _file; // Y4M and raw output. Writer thread only while active.
+    std::vector<char> _fileBuffer;
+
+    std::thread _worker;
+    std::mutex _mutex;
+    std::condition_variable _jobCondition;
+    std::condition_variable _freeCondition;
+    std::deque<Job> _jobs;
+    std::vector<uint32_t> _freeBuffers;
+    bool _stopping = false;
+    bool _writeFailed = false;
+    RecorderStats _stats;
+};
+
+// Parses y4m, rgba or png.
+bool parseRecordFormat(const char* name, RecordFormat& format);
+
+// Draws options.frames frames into the recorder and prints sustained throughput and the
+// bottleneck stage. Returns a process exit code.
+int runRecording(VulkanRenderer& renderer, const RecorderOptions& options);
+
+} // namespace VxEngine
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Non-owning reference to a callable, for callbacks that are invoked before the call taking them
+// returns. Unlike std::function it never copies the callable, so passing a lambda with a large
+// capture doesn't allocate. The callable must outlive the reference, which holds for a lambda
+// passed straight to the parameter.
+
+namespace VxEngine {
+
+template<typename Signature>
+class FunctionRef;
+
+template<typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+public:
+    template<typename F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef> && std::is_invocable_r_v<R, F&, Args...>)
+    FunctionRef(F&& function) noexcept
+        : _object(const_cast<void*>(static_cast<const void*>(std::addressof(function))))
+        , _call([](void* object, Args... args) -> R {
+            return std::invoke(*static_cast<std::remove_reference_t<F>*>(object), std::forward<Args>(args)...);
+        }) {}
+
+    R operator()(Args... args) const { return _call(_object, std::forward<Args>(args)...); }
+
+private:
+    void* _object;
+    R (*_call)(void*, Args...);
+};
+
+} // namespace VxEngine
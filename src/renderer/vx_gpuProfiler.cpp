@@ -0,0 +1,221 @@
+#include "vx_gpuProfiler.hpp"
+#include "vx_trace.hpp"
+
+#include "../../3rdparty/imgui/imgui.h"
+
+#include <cstring>
+
+namespace VxEngine {
+
+namespace {
+
+// The host domain TraceClock reads.
+#ifdef _WIN32
+constexpr VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+constexpr VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+int64_t hostTimestampToNs(uint64_t timestamp) {
+#ifdef _WIN32
+    return static_cast<int64_t>(static_cast<double>(timestamp) * 1e9 / static_cast<double>(SDL_GetPerformanceFrequency()));
+#else
+    return static_cast<int64_t>(timestamp); // CLOCK_MONOTONIC is in nanoseconds.
+#endif
+}
+
+} // namespace
+
+bool GpuProfiler::calibration_supported(VkInstance instance, VkPhysicalDevice physicalDevice) {
+    auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+    if(!getTimeDomains) {
+        return false;
+    }
+
+    uint32_t count = 0;
+    if(getTimeDomains(physicalDevice, &count, nullptr) != VK_SUCCESS) {
+        return false;
+    }
+    std::vector<VkTimeDomainEXT> domains(count);
+    if(getTimeDomains(physicalDevice, &count, domains.data()) != VK_SUCCESS) {
+        return false;
+    }
+
+    bool device = false;
+    bool host = false;
+    for(VkTimeDomainEXT domain : domains) {
+        device |= domain == VK_TIME_DOMAIN_DEVICE_EXT;
+        host |= domain == HOST_TIME_DOMAIN;
+    }
+    return device && host;
+}
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+    const char* traceTrack, bool calibratedTimestamps) {
+    _device = device;
+    _traceTrack = Tracer::Get().gpu_track(traceTrack);
+    if(calibratedTimestamps) {
+        _getCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT"));
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    _timestampPeriodNs = properties.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    uint32_t validBits = queueFamilyIndex < familyCount ? families[queueFamilyIndex].timestampValidBits : 0;
+    _supported = validBits > 0;
+    if(!_supported) {
+        std::cout << "GPU profiler: timestamps unsupported on the graphics queue, timings disabled." << std::endl;
+        return;
+    }
+    _timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+    VkQueryPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = MAX_SCOPES * 2 * LIVE_FRAMES;
+    VX_CHECK(vkCreateQueryPool(_device, &poolInfo, nullptr, &_queryPool), "vkCreateQueryPool");
+}
+
+void GpuProfiler::destroy() {
+    if(_queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(_device, _queryPool, nullptr);
+        _queryPool = VK_NULL_HANDLE;
+    }
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer cmd, uint32_t frameIndex) {
+    if(!_supported) {
+        return;
+    }
+
+    _frameIndex = frameIndex;
+    FrameQueries& frame = _frames[frameIndex];
+    uint32_t firstQuery = frameIndex * MAX_SCOPES * 2;
+
+    // The slot's fence has been waited, so its timestamps are available.
+    if(frame.written > 0) {
+        uint64_t timestamps[MAX_SCOPES * 2];
+        VkResult result = vkGetQueryPoolResults(_device, _queryPool, firstQuery, frame.written,
+            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if(result == VK_SUCCESS) {
+            _results.clear();
+            for(uint32_t scope = 0; scope < frame.written / 2; scope++) {
+                uint64_t ticks = (timestamps[scope * 2 + 1] - timestamps[scope * 2]) & _timestampMask;
+                double ms = static_cast<double>(ticks) * _timestampPeriodNs / 1000000.0;
+
+                bool merged = false;
+                for(ScopeResult& existing : _results) {
+                    if(std::strcmp(existing.name, frame.names[scope]) == 0) {
+                        existing.ms += ms;
+                        merged = true;
+                        break;
+                    }
+                }
+                if(!merged) {
+                    _results.push_back(ScopeResult{ frame.names[scope], ms });
+                }
+            }
+
+#ifdef VX_TRACING
+            if(Tracer::Get().capturing()) {
+                trace_frame(timestamps, frame);
+            }
+#endif
+        }
+    }
+
+    frame.names.clear();
+    frame.written = 0;
+    vkCmdResetQueryPool(cmd, _queryPool, firstQuery, MAX_SCOPES * 2);
+}
+
+void GpuProfiler::begin_scope(VkCommandBuffer cmd, const char* name) {
+    FrameQueries& frame = _frames[_frameIndex];
+    if(!_supported || _scopeOpen || frame.written >= MAX_SCOPES * 2) {
+        return;
+    }
+
+    frame.names.push_back(name);
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, _queryPool, _frameIndex * MAX_SCOPES * 2 + frame.written++);
+    _scopeOpen = true;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmd) {
+    if(!_scopeOpen) {
+        return;
+    }
+
+    FrameQueries& frame = _frames[_frameIndex];
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, _queryPool, _frameIndex * MAX_SCOPES * 2 + frame.written++);
+    _scopeOpen = false;
+}
+
+void GpuProfiler::mark_submitted() {
+    _frames[_frameIndex].submitNs = Tracer::now_ns();
+}
+
+// Maps the frame's timestamps onto the Tracer clock and records a span per scope.
+void GpuProfiler::trace_frame(const uint64_t* timestamps, const FrameQueries& frame) {
+    uint64_t anchorTicks = timestamps[0];
+    int64_t anchorNs = frame.submitNs;
+    if(_getCalibratedTimestamps) {
+        VkCalibratedTimestampInfoEXT infos[2] = {
+            { .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT },
+            { .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = HOST_TIME_DOMAIN } };
+        uint64_t calibration[2];
+        uint64_t maxDeviation;
+        if(_getCalibratedTimestamps(_device, 2, infos, calibration, &maxDeviation) == VK_SUCCESS) {
+            anchorTicks = calibration[0];
+            anchorNs = hostTimestampToNs(calibration[1]);
+        }
+    }
+
+    // Ticks relative to the anchor, which may be later than the timestamp. Counters narrower than
+    // 64 bits wrap, so the difference is sign extended from the valid bits.
+    auto toNs = [this, anchorTicks, anchorNs](uint64_t ticks) {
+        uint64_t delta = (ticks - anchorTicks) & _timestampMask;
+        if(_timestampMask != ~0ull && delta > (_timestampMask >> 1)) {
+            delta |= ~_timestampMask;
+        }
+        return anchorNs + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(delta)) * _timestampPeriodNs);
+    };
+
+    for(uint32_t scope = 0; scope < frame.written / 2; scope++) {
+        Tracer::Get().record(frame.names[scope], toNs(timestamps[scope * 2]), toNs(timestamps[scope * 2 + 1]), _traceTrack);
+    }
+}
+
+double GpuProfiler::scope_ms(const char* name) const {
+    for(const ScopeResult& result : _results) {
+        if(std::strcmp(result.name, name) == 0) {
+            return result.ms;
+        }
+    }
+    return -1.0;
+}
+
+void GpuProfiler::draw_imgui(const char* title) {
+    if(ImGui::Begin(title)) {
+        if(!_supported) {
+            ImGui::TextDisabled("Timestamp queries unsupported");
+        }
+
+        double total = 0.0;
+        for(const ScopeResult& result : _results) {
+            ImGui::Text("%-16s %7.3f ms", result.name, result.ms);
+            total += result.ms;
+        }
+        ImGui::Separator();
+        ImGui::Text("%-16s %7.3f ms", "total", total);
+    }
+    ImGui::End();
+}
+
+} // namespace VxEngine
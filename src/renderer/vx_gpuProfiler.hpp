@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vx_utils.hpp"
+
+#include <vector>
+
+// GPU pass timings from timestamp queries. Each frame slot owns a range of the query pool,
+// so results are read back without stalling once that slot's fence has been waited, i.e.
+// the timings always lag the current frame by LIVE_FRAMES.
+//
+// During a trace capture every resolved scope also goes to the Tracer, on the profiler's own track.
+// With VK_EXT_calibrated_timestamps the spans are placed on the CPU timeline exactly; without it the
+// frame's first timestamp is pinned to the moment it was submitted, which hides GPU queueing delay.
+
+namespace VxEngine {
+
+class GpuProfiler {
+public:
+    static constexpr uint32_t MAX_SCOPES = 32; // Per frame.
+
+    struct ScopeResult {
+        const char* name; // As passed to begin_scope.
+        double ms;
+    };
+
+    // calibratedTimestamps: VK_EXT_calibrated_timestamps is enabled and calibration_supported() holds.
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+        const char* traceTrack = "gpu", bool calibratedTimestamps = false);
+    void destroy();
+
+    // The device can sample its timestamps together with the host clock the Tracer uses.
+    static bool calibration_supported(VkInstance instance, VkPhysicalDevice physicalDevice);
+
+    // Reads back the slot's previous results and resets its queries. Must be recorded before any scope.
+    void begin_frame(VkCommandBuffer cmd, uint32_t frameIndex);
+
+    // Scopes may not nest. Scopes sharing a name are summed in the results.
+    void begin_scope(VkCommandBuffer cmd, const char* name);
+    void end_scope(VkCommandBuffer cmd);
+
+    // Right after the frame's command buffer is submitted, anchors its trace spans without calibration.
+    void mark_submitted();
+
+    bool supported() const { return _supported; }
+
+    // Latest resolved frame.
+    const std::vector<ScopeResult>& results() const { return _results; }
+    // Time of a named scope in the latest resolved frame, or a negative value if it wasn't recorded.
+    double scope_ms(const char* name) const;
+
+    void draw_imgui(const char* title = "gpu timings");
+
+private:
+    struct FrameQueries {
+        std::vector<const char*> names;
+        uint32_t written = 0; // Timestamps written this frame.
+        int64_t submitNs = 0; // Tracer clock.
+    };
+
+    void trace_frame(const uint64_t* timestamps, const FrameQueries& frame);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkQueryPool _queryPool = VK_NULL_HANDLE;
+    bool _supported = false;
+    bool _scopeOpen = false;
+    double _timestampPeriodNs = 1.0;
+    uint64_t _timestampMask = ~0ull;
+    uint32_t _traceTrack = 0;
+    PFN_vkGetCalibratedTimestampsEXT _getCalibratedTimestamps = nullptr; // Not exported by the loader.
+
+    uint32_t _frameIndex = 0;
+    FrameQueries _frames[LIVE_FRAMES];
+    std::vector<ScopeResult> _results;
+};
+
+} // namespace VxEngine
@@ -32,6 +32,13 @@ namespace VxEngine {
         vkCmdBlitImage2(cmd, &blitInfo);
     }
 
+    bool isDepthLayout(VkImageLayout layout) {
+        return layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL
+            || layout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL
+            || layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+            || layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+
     // Transition image layout from one layout to another.
     // This is a temporary, simple, stupid implementation with performance implications.
     // TODO: Implement a more efficient way to transition image layouts.
@@ -47,7 +54,7 @@ namespace VxEngine {
         imageBarrier.oldLayout = currentLayout;
         imageBarrier.newLayout = newLayout;
     
-        VkImageAspectFlags aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        VkImageAspectFlags aspectMask = (isDepthLayout(newLayout) || isDepthLayout(currentLayout)) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
     
         // VkImageSubresourceRange subImage{};
         // subImage.aspectMask = aspectMask;
@@ -14,6 +14,7 @@ struct AllocatedImage{
 };
 
 void copyImageToImage(VkCommandBuffer cmd, VkImage srcImage, VkImage dstImage, VkExtent2D srcExtent, VkExtent2D dstExtent);
+bool isDepthLayout(VkImageLayout layout);
 void transitionImageLayout(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
 
 }
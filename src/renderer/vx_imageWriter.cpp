@@ -0,0 +1,359 @@
+#include "vx_imageWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace VxEngine {
+
+namespace {
+
+const std::array<uint32_t, 256>& crcTable() {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> result{};
+        for(uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            result[n] = c;
+        }
+        return result;
+    }();
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    const std::array<uint32_t, 256>& table = crcTable();
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t getBE32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+        (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
+
+void putBE32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+template<typename T>
+void putLE(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T)); // Little endian hosts only, like the rest of the engine.
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void putString(std::vector<uint8_t>& out, const char* text) {
+    out.insert(out.end(), text, text + strlen(text) + 1); // Including the terminator.
+}
+
+void pngChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+    putBE32(out, static_cast<uint32_t>(data.size()));
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBE32(out, crc32(out.data() + typeStart, out.size() - typeStart));
+}
+
+// EXR attribute: name, type name, size, value.
+void exrAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value) {
+    putString(out, name);
+    putString(out, type);
+    putLE<int32_t>(out, static_cast<int32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+} // namespace
+
+std::vector<uint8_t> encodePNG(uint32_t width, uint32_t height, const uint8_t* rgba8) {
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    std::vector<uint8_t> header;
+    putBE32(header, width);
+    putBE32(header, height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit, RGBA, deflate, no filter method, no interlace.
+    pngChunk(png, "IHDR", header);
+
+    // Scanlines with filter type 0 (none).
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for(uint32_t y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba8 + y * rowBytes, rgba8 + (y + 1) * rowBytes);
+    }
+
+    // zlib stream made of stored deflate blocks.
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    size_t offset = 0;
+    do {
+        size_t blockSize = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + blockSize == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(blockSize));
+        zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+        zlib.push_back(static_cast<uint8_t>(~blockSize));
+        zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+        for(size_t i = offset; i < offset + blockSize; i++) {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        offset += blockSize;
+    } while(offset < raw.size());
+    putBE32(zlib, (adlerB << 16) | adlerA);
+
+    pngChunk(png, "IDAT", zlib);
+    pngChunk(png, "IEND", {});
+    return png;
+}
+
+bool decodePNG(const std::vector<uint8_t>& png, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba8) {
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if(png.size() < 8 || memcmp(png.data(), SIGNATURE, 8) != 0) {
+        return false;
+    }
+
+    // Chunks: IHDR, then the IDAT data concatenated.
+    std::vector<uint8_t> zlib;
+    bool header = false;
+    size_t offset = 8;
+    while(offset + 12 <= png.size()) {
+        uint32_t length = getBE32(png.data() + offset);
+        const uint8_t* type = png.data() + offset + 4;
+        const uint8_t* data = type + 4;
+        if(offset + 12 + length > png.size()) {
+            return false;
+        }
+
+        if(memcmp(type, "IHDR", 4) == 0) {
+            // 8 bit, RGBA, deflate, no filter method, no interlace, as encodePNG writes it.
+            const uint8_t expected[5] = { 8, 6, 0, 0, 0 };
+            if(length != 13 || memcmp(data + 8, expected, 5) != 0) {
+                return false;
+            }
+            width = getBE32(data);
+            height = getBE32(data + 4);
+            header = true;
+        } else if(memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), data, data + length);
+        } else if(memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        offset += 12 + length;
+    }
+    if(!header || zlib.size() < 2) {
+        return false;
+    }
+
+    // Stored deflate blocks only.
+    std::vector<uint8_t> raw;
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    raw.reserve((rowBytes + 1) * height);
+    offset = 2;
+    bool last = false;
+    while(!last) {
+        if(offset + 5 > zlib.size() || (zlib[offset] & 0x06) != 0) {
+            return false; // Truncated, or a compressed block.
+        }
+        last = (zlib[offset] & 1) != 0;
+        size_t blockSize = zlib[offset + 1] | (zlib[offset + 2] << 8);
+        offset += 5;
+        if(offset + blockSize > zlib.size()) {
+            return false;
+        }
+        raw.insert(raw.end(), zlib.begin() + offset, zlib.begin() + offset + blockSize);
+        offset += blockSize;
+    }
+    if(raw.size() != (rowBytes + 1) * height) {
+        return false;
+    }
+
+    rgba8.resize(rowBytes * height);
+    for(uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = raw.data() + y * (rowBytes + 1);
+        if(row[0] != 0) {
+            return false; // Filtered scanline.
+        }
+        memcpy(rgba8.data() + y * rowBytes, row + 1, rowBytes);
+    }
+    return true;
+}
+
+std::vector<uint8_t> encodeEXR(uint32_t width, uint32_t height, const uint16_t* rgbaHalf) {
+    std::vector<uint8_t> exr;
+    putLE<uint32_t>(exr, 20000630); // Magic.
+    putLE<uint32_t>(exr, 2);        // Version 2, single part scanline.
+
+    // Channels are stored in alphabetical order.
+    const char* channelNames[4] = { "A", "B", "G", "R" };
+    const int channelSource[4] = { 3, 2, 1, 0 }; // Component index in RGBA.
+
+    std::vector<uint8_t> channels;
+    for(const char* name : channelNames) {
+        putString(channels, name);
+        putLE<int32_t>(channels, 1); // HALF
+        channels.insert(channels.end(), { 0, 0, 0, 0 }); // pLinear + reserved.
+        putLE<int32_t>(channels, 1); // xSampling
+        putLE<int32_t>(channels, 1); // ySampling
+    }
+    channels.push_back(0);
+    exrAttribute(exr, "channels", "chlist", channels);
+    exrAttribute(exr, "compression", "compression", { 0 });
+
+    std::vector<uint8_t> window;
+    putLE<int32_t>(window, 0);
+    putLE<int32_t>(window, 0);
+    putLE<int32_t>(window, static_cast<int32_t>(width) - 1);
+    putLE<int32_t>(window, static_cast<int32_t>(height) - 1);
+    exrAttribute(exr, "dataWindow", "box2i", window);
+    exrAttribute(exr, "displayWindow", "box2i", window);
+    exrAttribute(exr, "lineOrder", "lineOrder", { 0 }); // Increasing Y.
+
+    std::vector<uint8_t> one;
+    putLE<float>(one, 1.0f);
+    exrAttribute(exr, "pixelAspectRatio", "float", one);
+
+    std::vector<uint8_t> center;
+    putLE<float>(center, 0.0f);
+    putLE<float>(center, 0.0f);
+    exrAttribute(exr, "screenWindowCenter", "v2f", center);
+    exrAttribute(exr, "screenWindowWidth", "float", one);
+    exr.push_back(0); // End of header.
+
+    // Offset table, one entry per scanline.
+    size_t lineDataBytes = static_cast<size_t>(width) * 4 * sizeof(uint16_t);
+    size_t lineBytes = 8 + lineDataBytes;
+    uint64_t firstLine = exr.size() + static_cast<size_t>(height) * sizeof(uint64_t);
+    for(uint32_t y = 0; y < height; y++) {
+        putLE<uint64_t>(exr, firstLine + y * lineBytes);
+    }
+
+    exr.reserve(exr.size() + lineBytes * height);
+    for(uint32_t y = 0; y < height; y++) {
+        putLE<int32_t>(exr, static_cast<int32_t>(y));
+        putLE<int32_t>(exr, static_cast<int32_t>(lineDataBytes));
+        const uint16_t* row = rgbaHalf + static_cast<size_t>(y) * width * 4;
+        for(int channel = 0; channel < 4; channel++) {
+            for(uint32_t x = 0; x < width; x++) {
+                putLE<uint16_t>(exr, row[x * 4 + channelSource[channel]]);
+            }
+        }
+    }
+    return exr;
+}
+
+bool writeFile(const char* path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open image file: " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return file.good();
+}
+
+bool readFile(const char* path, std::vector<uint8_t>& bytes) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+        return false;
+    }
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+bool readPNG(const char* path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba8) {
+    std::vector<uint8_t> bytes;
+    return readFile(path, bytes) && decodePNG(bytes, width, height, rgba8);
+}
+
+bool writePNG(const char* path, uint32_t width, uint32_t height, const uint8_t* rgba8) {
+    return writeFile(path, encodePNG(width, height, rgba8));
+}
+
+bool writeEXR(const char* path, uint32_t width, uint32_t height, const uint16_t* rgbaHalf) {
+    return writeFile(path, encodeEXR(width, height, rgbaHalf));
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if(((bits >> 23) & 0xff) == 0xff) { // Inf / NaN.
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if(exponent >= 31) { // Overflow to infinity.
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if(exponent <= 0) { // Subnormal or zero.
+        if(exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if(remainder > midpoint || (remainder == midpoint && (half & 1))) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++; // Rounds into the exponent correctly, up to infinity.
+    }
+    return static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if(exponent == 0) {
+        if(mantissa == 0) {
+            bits = sign;
+        } else { // Subnormal, normalize it.
+            exponent = 127 - 15 + 1;
+            while((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3ff;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    } else if(exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+} // namespace VxEngine
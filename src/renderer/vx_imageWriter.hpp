@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Minimal, dependency free image encoders for captures.
+//  * PNG: 8 bit RGBA. The zlib stream uses stored (uncompressed) deflate blocks, so files are
+//    roughly the size of the raw pixels, but encoding costs little more than a memcpy and a CRC.
+//  * EXR: half float RGBA, single part scanline image without compression.
+// decodePNG reads back only what encodePNG writes, e.g. the golden images of regression runs.
+
+namespace VxEngine {
+
+std::vector<uint8_t> encodePNG(uint32_t width, uint32_t height, const uint8_t* rgba8);
+std::vector<uint8_t> encodeEXR(uint32_t width, uint32_t height, const uint16_t* rgbaHalf);
+
+// 8 bit RGBA with stored deflate blocks and unfiltered rows. False for any other PNG.
+bool decodePNG(const std::vector<uint8_t>& png, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba8);
+
+bool writePNG(const char* path, uint32_t width, uint32_t height, const uint8_t* rgba8);
+bool writeEXR(const char* path, uint32_t width, uint32_t height, const uint16_t* rgbaHalf);
+bool writeFile(const char* path, const std::vector<uint8_t>& bytes);
+bool readPNG(const char* path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba8);
+bool readFile(const char* path, std::vector<uint8_t>& bytes);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+} // namespace VxEngine
@@ -0,0 +1,223 @@
+#include "vx_memoryTelemetry.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+
+#include "../../3rdparty/imgui/imgui.h"
+
+namespace VxEngine {
+
+namespace {
+    constexpr const char* CATEGORY_NAMES[] = { "render_targets", "buffers", "staging", "textures" };
+    static_assert(std::size(CATEGORY_NAMES) == static_cast<size_t>(AllocationCategory::Count));
+
+    constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+
+    // Category is stored in the VMA user data offset by one so untagged allocations read as null.
+    void* encode_category(AllocationCategory category) {
+        return reinterpret_cast<void*>(static_cast<uintptr_t>(category) + 1);
+    }
+
+    bool decode_category(void* userData, AllocationCategory* category) {
+        uintptr_t value = reinterpret_cast<uintptr_t>(userData);
+        if(value == 0 || value > static_cast<uintptr_t>(AllocationCategory::Count)) {
+            return false;
+        }
+        *category = static_cast<AllocationCategory>(value - 1);
+        return true;
+    }
+}
+
+const char* allocation_category_name(AllocationCategory category) {
+    return CATEGORY_NAMES[static_cast<size_t>(category)];
+}
+
+void MemoryTelemetry::init(VmaAllocator allocator, bool budgetExtensionEnabled) {
+    _allocator = allocator;
+    _budgetExtensionEnabled = budgetExtensionEnabled;
+    update();
+}
+
+void MemoryTelemetry::track(VmaAllocation allocation, AllocationCategory category, const char* name) {
+    vmaSetAllocationUserData(_allocator, allocation, encode_category(category));
+    vmaSetAllocationName(_allocator, allocation, name ? name : allocation_category_name(category));
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(_allocator, allocation, &info);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    CategoryStats& stats = _categories[static_cast<size_t>(category)];
+    stats.bytes += info.size;
+    stats.count++;
+}
+
+void MemoryTelemetry::untrack(VmaAllocation allocation) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(_allocator, allocation, &info);
+
+    AllocationCategory category;
+    if(!decode_category(info.pUserData, &category)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    CategoryStats& stats = _categories[static_cast<size_t>(category)];
+    stats.bytes -= info.size;
+    stats.count--;
+}
+
+void MemoryTelemetry::update() {
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+    vmaGetMemoryProperties(_allocator, &memoryProperties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(_allocator, budgets);
+
+    std::vector<BudgetWarning> warnings;
+    std::vector<WarningListener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        uint32_t heapCount = memoryProperties->memoryHeapCount;
+        _heaps.resize(heapCount);
+        _heapOverThreshold.resize(heapCount, false);
+
+        for(uint32_t i = 0; i < heapCount; i++) {
+            const VmaBudget& budget = budgets[i];
+            _heaps[i] = HeapStats{
+                .heapIndex = i,
+                .flags = memoryProperties->memoryHeaps[i].flags,
+                .size = memoryProperties->memoryHeaps[i].size,
+                .budget = budget.budget,
+                .usage = budget.usage,
+                .blockBytes = budget.statistics.blockBytes,
+                .allocationBytes = budget.statistics.allocationBytes,
+                .allocationCount = budget.statistics.allocationCount };
+
+            float ratio = budget.budget > 0 ? static_cast<float>(budget.usage) / static_cast<float>(budget.budget) : 0.0f;
+            bool over = ratio >= _warningRatio;
+            if(over && !_heapOverThreshold[i]) {
+                warnings.push_back(BudgetWarning{ .heapIndex = i, .usage = budget.usage, .budget = budget.budget, .ratio = ratio });
+            }
+            _heapOverThreshold[i] = over;
+        }
+
+        if(!warnings.empty()) {
+            listeners = _listeners;
+        }
+    }
+
+    // Listeners run outside the lock so they can query the telemetry themselves.
+    for(const BudgetWarning& warning : warnings) {
+        std::cout << "GPU memory warning: heap " << warning.heapIndex << " at "
+                  << static_cast<int>(warning.ratio * 100.0f) << "% of budget ("
+                  << warning.usage / BYTES_PER_MB << " / " << warning.budget / BYTES_PER_MB << " MB)" << std::endl;
+        for(const WarningListener& listener : listeners) {
+            listener(warning);
+        }
+    }
+}
+
+std::vector<MemoryTelemetry::HeapStats> MemoryTelemetry::heap_stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _heaps;
+}
+
+MemoryTelemetry::CategoryStats MemoryTelemetry::category_stats(AllocationCategory category) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _categories[static_cast<size_t>(category)];
+}
+
+VkDeviceSize MemoryTelemetry::device_local_headroom() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    VkDeviceSize headroom = 0;
+    for(const HeapStats& heap : _heaps) {
+        if((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.budget > heap.usage) {
+            headroom += heap.budget - heap.usage;
+        }
+    }
+    return headroom;
+}
+
+void MemoryTelemetry::set_warning_ratio(float ratio) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _warningRatio = ratio;
+}
+
+void MemoryTelemetry::add_warning_listener(WarningListener listener) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _listeners.push_back(std::move(listener));
+}
+
+void MemoryTelemetry::draw_imgui(float& warningRatio) {
+    if(ImGui::Begin("memory")) {
+        if(!_budgetExtensionEnabled) {
+            ImGui::TextDisabled("VK_EXT_memory_budget unavailable, budgets are estimates");
+        }
+
+        std::vector<HeapStats> heaps = heap_stats();
+        for(const HeapStats& heap : heaps) {
+            float ratio = heap.budget > 0 ? static_cast<float>(heap.usage) / static_cast<float>(heap.budget) : 0.0f;
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", heap.usage / BYTES_PER_MB, heap.budget / BYTES_PER_MB);
+
+            ImGui::Text("Heap %u%s", heap.heapIndex, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "");
+            ImGui::ProgressBar(ratio, ImVec2(-1.0f, 0.0f), overlay);
+            ImGui::Text("  %u allocations, %.1f MB allocated in %.1f MB of blocks",
+                heap.allocationCount, heap.allocationBytes / BYTES_PER_MB, heap.blockBytes / BYTES_PER_MB);
+        }
+
+        ImGui::Separator();
+        for(size_t i = 0; i < static_cast<size_t>(AllocationCategory::Count); i++) {
+            CategoryStats stats = category_stats(static_cast<AllocationCategory>(i));
+            ImGui::Text("%-16s %6.1f MB (%u)", CATEGORY_NAMES[i], stats.bytes / BYTES_PER_MB, stats.count);
+        }
+
+        ImGui::SliderFloat("Warning ratio", &warningRatio, 0.5f, 1.0f);
+        if(ImGui::Button("Dump JSON")) {
+            dump_json("memory_stats.json");
+        }
+    }
+    ImGui::End();
+}
+
+void MemoryTelemetry::write_json(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    out << "{\n  \"heaps\": [\n";
+    for(size_t i = 0; i < _heaps.size(); i++) {
+        const HeapStats& heap = _heaps[i];
+        out << "    { \"index\": " << heap.heapIndex
+            << ", \"deviceLocal\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+            << ", \"size\": " << heap.size
+            << ", \"budget\": " << heap.budget
+            << ", \"usage\": " << heap.usage
+            << ", \"blockBytes\": " << heap.blockBytes
+            << ", \"allocationBytes\": " << heap.allocationBytes
+            << ", \"allocationCount\": " << heap.allocationCount << " }"
+            << (i + 1 < _heaps.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n  \"categories\": {\n";
+    for(size_t i = 0; i < _categories.size(); i++) {
+        out << "    \"" << CATEGORY_NAMES[i] << "\": { \"bytes\": " << _categories[i].bytes
+            << ", \"count\": " << _categories[i].count << " }"
+            << (i + 1 < _categories.size() ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+}
+
+bool MemoryTelemetry::dump_json(const char* path) const {
+    std::ofstream file(path);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open memory stats file: " << path << std::endl;
+        return false;
+    }
+
+    write_json(file);
+    std::cout << "Memory stats written to " << path << std::endl;
+    return true;
+}
+
+} // namespace VxEngine
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "vx_utils.hpp"
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Tracks GPU memory use per heap (budget vs usage from VMA) and per allocation category.
+// Owned by the renderer, but any subsystem (e.g. texture streaming) can query it
+// to decide when to evict.
+
+namespace VxEngine {
+
+enum class AllocationCategory : uint32_t {
+    RenderTarget = 0,
+    Buffer,
+    Staging,
+    Texture,
+    Count
+};
+
+const char* allocation_category_name(AllocationCategory category);
+
+class MemoryTelemetry {
+public:
+    struct HeapStats {
+        uint32_t heapIndex;
+        VkMemoryHeapFlags flags;
+        VkDeviceSize size;            // Physical heap size.
+        VkDeviceSize budget;          // Estimated amount the process can use.
+        VkDeviceSize usage;           // Estimated current usage, including other VMA-external allocations.
+        VkDeviceSize blockBytes;      // Bytes in VkDeviceMemory blocks allocated by VMA.
+        VkDeviceSize allocationBytes; // Bytes in allocations handed out by VMA.
+        uint32_t allocationCount;
+    };
+
+    struct CategoryStats {
+        VkDeviceSize bytes = 0;
+        uint32_t count = 0;
+    };
+
+    struct BudgetWarning {
+        uint32_t heapIndex;
+        VkDeviceSize usage;
+        VkDeviceSize budget;
+        float ratio;
+    };
+
+    using WarningListener = std::function<void(const BudgetWarning&)>;
+
+    static constexpr float DEFAULT_WARNING_RATIO = 0.9f;
+
+    void init(VmaAllocator allocator, bool budgetExtensionEnabled);
+
+    // Tags an allocation with its category (VMA user data) and a debug name, and adds it to the totals.
+    void track(VmaAllocation allocation, AllocationCategory category, const char* name = nullptr);
+    // Must be called before the allocation is freed.
+    void untrack(VmaAllocation allocation);
+
+    // Refreshes the heap budgets and fires warnings. Called once per frame.
+    void update();
+
+    std::vector<HeapStats> heap_stats() const;
+    CategoryStats category_stats(AllocationCategory category) const;
+
+    // Remaining budget summed over the device local heaps. Eviction decisions should use this.
+    VkDeviceSize device_local_headroom() const;
+
+    void set_warning_ratio(float ratio);
+    void add_warning_listener(WarningListener listener);
+
+    // warningRatio is the UI's copy of the ratio, the owner applies it through set_warning_ratio on
+    // the thread that calls update().
+    void draw_imgui(float& warningRatio);
+    void write_json(std::ostream& out) const;
+    bool dump_json(const char* path) const;
+
+private:
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    bool _budgetExtensionEnabled = false;
+
+    mutable std::mutex _mutex;
+    float _warningRatio = DEFAULT_WARNING_RATIO;
+    std::vector<HeapStats> _heaps;
+    std::vector<bool> _heapOverThreshold; // Warnings are edge triggered per heap.
+    std::array<CategoryStats, static_cast<size_t>(AllocationCategory::Count)> _categories{};
+    std::vector<WarningListener> _listeners;
+};
+
+} // namespace VxEngine
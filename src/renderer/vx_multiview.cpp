@@ -0,0 +1,215 @@
+#include "vx_multiview.hpp"
+#include "vx_pipelineCache.hpp"
+
+#include "../../3rdparty/glm/glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace VxEngine {
+
+// Reverse-Z.
+constexpr RasterState MULTIVIEW_STATE = { .depthTest = VK_TRUE, .depthWrite = VK_TRUE, .depthCompare = VK_COMPARE_OP_GREATER_OR_EQUAL };
+
+std::pmr::vector<glm::mat4> multiviewMatrices(const Camera& camera, MultiviewLayout layout, std::pmr::memory_resource* memory) {
+    std::pmr::vector<glm::mat4> views(memory);
+    views.reserve(MultiviewPass::MAX_VIEWS);
+
+    switch(layout) {
+        case MultiviewLayout::Stereo: {
+            constexpr float IPD = 0.064f;
+            glm::mat4 projection = camera.projection(1.0f);
+            glm::mat4 view = camera.view();
+            for(float eye : { -0.5f, 0.5f }) {
+                // Shifting in view space moves the eye along the camera's right axis.
+                glm::mat4 eyeOffset = glm::translate(glm::mat4(1.0f), glm::vec3(-eye * IPD, 0.0f, 0.0f));
+                views.push_back(projection * eyeOffset * view);
+            }
+            break;
+        }
+        case MultiviewLayout::Cubemap: {
+            // Cubemap face convention (t runs down -Y on the side faces). Vulkan's clip space is already
+            // Y down, so the face projection doesn't flip Y like the main camera does.
+            glm::mat4 projection = reverseZPerspective(glm::radians(90.0f), 1.0f, camera.zNear);
+            projection[1][1] = -projection[1][1];
+
+            const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+            const glm::vec3 ups[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+            for(uint32_t face = 0; face < 6; face++) {
+                views.push_back(projection * glm::lookAt(camera.position, camera.position + directions[face], ups[face]));
+            }
+            break;
+        }
+        case MultiviewLayout::Wall: {
+            constexpr float SPREAD = glm::radians(25.0f);
+            for(uint32_t i = 0; i < MultiviewPass::MAX_VIEWS; i++) {
+                Camera wallCamera = camera;
+                wallCamera.yaw += (static_cast<float>(i) - 0.5f * (MultiviewPass::MAX_VIEWS - 1)) * SPREAD;
+                views.push_back(wallCamera.view_projection(1.0f));
+            }
+            break;
+        }
+    }
+
+    return views;
+}
+
+void MultiviewPass::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, PipelineCache& pipelineCache, VkFormat colorFormat, VkFormat depthFormat) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+    _colorFormat = colorFormat;
+    _depthFormat = depthFormat;
+
+    for(AllocatedBuffer& viewBuffer : _viewBuffers) {
+        viewBuffer = createBuffer(_allocator, *_telemetry, sizeof(glm::mat4) * MAX_VIEWS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, AllocationCategory::Buffer, "multiview views");
+    }
+
+    VkShaderModule vertexShader = pipelineCache.shader("src/renderer/shaders/multiview.vert.spv");
+    VkShaderModule fragmentShader = pipelineCache.shader("src/renderer/shaders/multiview.frag.spv");
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MultiviewPushConstants);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkPipelineLayoutCreateInfo layoutInfo = pipelineLayoutCreateInfo();
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VX_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout), "Multiview pipeline layout creation failed.");
+
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder._layout = _pipelineLayout;
+    pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader, "main");
+    pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader, "main");
+    pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipelineBuilder.set_multisampling_none();
+    pipelineBuilder.set_raster_state(MULTIVIEW_STATE);
+    pipelineBuilder.set_color_attachment_format(colorFormat);
+    pipelineBuilder.set_depth_format(depthFormat);
+    _dynamicState = pipelineCache.dynamic_state();
+
+    // The pipeline's view mask has to match the pass, so there is one pipeline per view count.
+    for(uint32_t count = 1; count <= MAX_VIEWS; count++) {
+        pipelineBuilder.set_view_mask((1u << count) - 1u);
+        _pipelines[count - 1] = pipelineCache.graphics(pipelineBuilder);
+    }
+}
+
+void MultiviewPass::destroy() {
+    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+
+    for(const AllocatedBuffer& viewBuffer : _viewBuffers) {
+        destroyBuffer(_allocator, *_telemetry, viewBuffer);
+    }
+}
+
+void MultiviewPass::request_targets(TransientImagePool& pool, uint32_t pass) {
+    VkExtent3D extent = { VIEW_EXTENT.width, VIEW_EXTENT.height, 1 };
+    _colorHandle = pool.request(TransientImageDesc{
+        .format = _colorFormat,
+        .extent = extent,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+        .layers = MAX_VIEWS,
+        .firstPass = pass,
+        .lastPass = pass,
+        .name = "multiview color" });
+    _depthHandle = pool.request(TransientImageDesc{
+        .format = _depthFormat,
+        .extent = extent,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        .aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .layers = MAX_VIEWS,
+        .firstPass = pass,
+        .lastPass = pass,
+        .name = "multiview depth" });
+}
+
+void MultiviewPass::acquire_targets(const TransientImagePool& pool) {
+    _color = pool.get(_colorHandle);
+    _depth = pool.get(_depthHandle);
+}
+
+void MultiviewPass::set_views(uint32_t frameIndex, std::span<const glm::mat4> viewProjs) {
+    _frameIndex = frameIndex;
+    _viewCount = static_cast<uint32_t>(std::min(viewProjs.size(), static_cast<size_t>(MAX_VIEWS)));
+
+    // The slot's fence has been waited, so the GPU is done with its view buffer.
+    memcpy(_viewBuffers[frameIndex].info.pMappedData, viewProjs.data(), sizeof(glm::mat4) * _viewCount);
+    vmaFlushAllocation(_allocator, _viewBuffers[frameIndex].allocation, 0, sizeof(glm::mat4) * _viewCount);
+}
+
+void MultiviewPass::draw(CommandRecorder& cmd, VkDeviceAddress objectBuffer, uint32_t objectCount) {
+    if(_viewCount == 0) {
+        return;
+    }
+
+    // Previous contents are discarded, every layer is cleared. The targets alias earlier passes'
+    // memory, which these full barriers also order against.
+    cmd.transition_image(_color.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    cmd.transition_image(_depth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+
+    VkClearValue clearColor = {};
+    clearColor.color = { { 0.02f, 0.02f, 0.03f, 1.0f } };
+    VkRenderingAttachmentInfo colorAttachment = createRenderingAttachmentInfo(_color.imageView, &clearColor, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkRenderingAttachmentInfo depthAttachment = createDepthAttachmentInfo(_depth.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, true, REVERSE_Z_CLEAR_DEPTH);
+
+    uint32_t viewMask = (1u << _viewCount) - 1u;
+    VkRenderingInfo renderInfo = createRenderingInfo(VIEW_EXTENT, &colorAttachment, &depthAttachment, viewMask);
+    cmd.begin_rendering(renderInfo);
+
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines[_viewCount - 1], _pipelineLayout);
+    cmd.set_raster_state(MULTIVIEW_STATE, _dynamicState);
+
+    VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(VIEW_EXTENT.width), static_cast<float>(VIEW_EXTENT.height), 0.0f, 1.0f };
+    cmd.set_viewport(viewport);
+    VkRect2D scissor = { VkOffset2D{ 0, 0 }, VIEW_EXTENT };
+    cmd.set_scissor(scissor);
+
+    MultiviewPushConstants pushConstants = { _viewBuffers[_frameIndex].address, objectBuffer };
+    cmd.push_constants(_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MultiviewPushConstants), &pushConstants);
+
+    // One draw for every object in every view.
+    cmd.draw(3, objectCount, 0, 0);
+
+    cmd.end_rendering();
+}
+
+void MultiviewPass::composite(CommandRecorder& cmd, VkImage target, VkExtent2D targetExtent) {
+    if(_viewCount == 0) {
+        return;
+    }
+
+    cmd.transition_image(_color.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    cmd.transition_image(target, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    int32_t tile = static_cast<int32_t>(std::min(targetExtent.width / _viewCount, targetExtent.height / 3));
+    int32_t top = static_cast<int32_t>(targetExtent.height) - tile;
+
+    VkImageBlit2 regions[MAX_VIEWS];
+    for(uint32_t view = 0; view < _viewCount; view++) {
+        VkImageBlit2& region = regions[view];
+        region = { .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2, .pNext = nullptr };
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, view, 1 };
+        region.srcOffsets[1] = { static_cast<int32_t>(VIEW_EXTENT.width), static_cast<int32_t>(VIEW_EXTENT.height), 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.dstOffsets[0] = { static_cast<int32_t>(view) * tile, top, 0 };
+        region.dstOffsets[1] = { static_cast<int32_t>(view + 1) * tile, top + tile, 1 };
+    }
+
+    VkBlitImageInfo2 blitInfo = { .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2, .pNext = nullptr };
+    blitInfo.srcImage = _color.image;
+    blitInfo.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    blitInfo.dstImage = target;
+    blitInfo.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    blitInfo.filter = VK_FILTER_LINEAR;
+    blitInfo.regionCount = _viewCount;
+    blitInfo.pRegions = regions;
+    vkCmdBlitImage2(cmd.buffer(), &blitInfo);
+
+    cmd.transition_image(target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+} // namespace VxEngine
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_buffer.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_camera.hpp"
+#include "vx_memoryTelemetry.hpp"
+#include "vx_transientPool.hpp"
+
+#include "../../3rdparty/glm/glm/glm.hpp"
+
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+// Layered rendering of several viewpoints in one pass with multiview (core in Vulkan 1.1).
+// The pass renders into a layered color and depth target, one layer per view, with a view mask
+// covering the active views. The vertex shader (shaders/multiview.vert) picks the view's matrix
+// with gl_ViewIndex from a per frame view buffer, so the whole scene is one draw call and the
+// cost of recording and submitting geometry doesn't depend on the view count.
+//
+// Every object is drawn in every view: the occlusion culler's draw lists are built for the main
+// camera only.
+//
+// The layered targets come from the transient pool and are only live during the pass, so they
+// share memory with targets of the earlier passes and take none while the preview is off.
+
+namespace VxEngine {
+
+enum class MultiviewLayout : uint32_t {
+    Stereo = 0, // Two eyes around the main camera.
+    Cubemap,    // Six 90 degree faces at the camera position, +X -X +Y -Y +Z -Z.
+    Wall,       // A fan of cameras around the main camera, for the preview wall.
+};
+
+// View matrices for a layout, at most MultiviewPass::MAX_VIEWS. Views are square.
+// The array comes from memory, e.g. the frame arena.
+std::pmr::vector<glm::mat4> multiviewMatrices(const Camera& camera, MultiviewLayout layout,
+    std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+class PipelineCache;
+
+class MultiviewPass {
+public:
+    // The spec guarantees maxMultiviewViewCount >= 6, enough for a cubemap.
+    static constexpr uint32_t MAX_VIEWS = 6;
+    static constexpr VkExtent2D VIEW_EXTENT = { 512, 512 };
+
+    // Pipelines and shaders come from pipelineCache, which must outlive the pass.
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, PipelineCache& pipelineCache, VkFormat colorFormat, VkFormat depthFormat);
+    void destroy();
+
+    // Uploads the views into the frame slot's view buffer. Views past MAX_VIEWS are ignored.
+    void set_views(uint32_t frameIndex, std::span<const glm::mat4> viewProjs);
+    uint32_t view_count() const { return _viewCount; }
+
+    // Requests the color and depth targets, live for pass only. acquire_targets picks them up once
+    // the pool is realized, before draw().
+    void request_targets(TransientImagePool& pool, uint32_t pass);
+    void acquire_targets(const TransientImagePool& pool);
+
+    // Renders every view. Leaves the color layers in COLOR_ATTACHMENT_OPTIMAL.
+    void draw(CommandRecorder& cmd, VkDeviceAddress objectBuffer, uint32_t objectCount);
+    // Blits the views side by side along the bottom of target, which must be in COLOR_ATTACHMENT_OPTIMAL
+    // and is returned to it.
+    void composite(CommandRecorder& cmd, VkImage target, VkExtent2D targetExtent);
+
+    const AllocatedImage& color() const { return _color; }
+
+private:
+    struct MultiviewPushConstants {
+        VkDeviceAddress views;
+        VkDeviceAddress objectBuffer;
+    };
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    uint32_t _frameIndex = 0;
+    uint32_t _viewCount = 0;
+    VkFormat _colorFormat = VK_FORMAT_UNDEFINED;
+    VkFormat _depthFormat = VK_FORMAT_UNDEFINED;
+
+    // MAX_VIEWS layers each, owned by the transient pool and valid for the current frame.
+    TransientImageHandle _colorHandle = 0;
+    TransientImageHandle _depthHandle = 0;
+    AllocatedImage _color = {};
+    AllocatedImage _depth = {};
+    AllocatedBuffer _viewBuffers[LIVE_FRAMES]; // Host visible, mat4 per view.
+
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _pipelines[MAX_VIEWS] = {}; // Indexed by view count - 1.
+    uint32_t _dynamicState = 0;            // The cache's DynamicStateFlags.
+};
+
+} // namespace VxEngine
@@ -0,0 +1,330 @@
+#include "vx_occlusionCuller.hpp"
+#include "vx_pipeline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace VxEngine {
+
+void OcclusionCuller::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, uint32_t maxObjects) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+    _maxObjects = maxObjects;
+
+    // Buffers
+    _visibilityBuffer = createBuffer(_allocator, *_telemetry, sizeof(uint32_t) * maxObjects,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "occlusion visibility");
+
+    for(AllocatedBuffer& drawBuffer : _drawBuffers) {
+        drawBuffer = createBuffer(_allocator, *_telemetry, DRAW_COMMANDS_OFFSET + sizeof(VkDrawIndirectCommand) * maxObjects,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "occlusion draw list");
+    }
+
+    for(AllocatedBuffer& statsBuffer : _statsBuffers) {
+        statsBuffer = createBuffer(_allocator, *_telemetry, sizeof(uint32_t) * static_cast<size_t>(Phase::Count),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "occlusion stats");
+        std::fill_n(static_cast<uint32_t*>(statsBuffer.info.pMappedData), static_cast<size_t>(Phase::Count), 0u);
+    }
+
+    // Descriptors
+    std::vector<DescriptorManager::PoolSizeRatio> sizes = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+    };
+    _descriptorAllocator.init_pool(_device, LIVE_FRAMES * (MAX_HIZ_MIPS + 1), sizes);
+
+    DescriptorManager::DescriptorLayoutBuilder buildLayoutBuilder;
+    buildLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    buildLayoutBuilder.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    _buildSetLayout = buildLayoutBuilder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr, 0);
+
+    DescriptorManager::DescriptorLayoutBuilder cullLayoutBuilder;
+    cullLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    _cullSetLayout = cullLayoutBuilder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr, 0);
+
+    for(uint32_t frame = 0; frame < LIVE_FRAMES; frame++) {
+        for(uint32_t mip = 0; mip < MAX_HIZ_MIPS; mip++) {
+            _buildSets[frame][mip] = _descriptorAllocator.allocate(_device, _buildSetLayout);
+        }
+        _cullSets[frame] = _descriptorAllocator.allocate(_device, _cullSetLayout);
+    }
+
+    // texelFetch ignores filtering, the sampler only has to exist.
+    VkSamplerCreateInfo samplerInfo = { .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VX_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler), "vkCreateSampler");
+
+    // Pipelines
+    VkPipelineLayoutCreateInfo buildLayoutInfo = pipelineLayoutCreateInfo();
+    buildLayoutInfo.setLayoutCount = 1;
+    buildLayoutInfo.pSetLayouts = &_buildSetLayout;
+    VX_CHECK(vkCreatePipelineLayout(_device, &buildLayoutInfo, nullptr, &_buildPipelineLayout), "Hi-Z build pipeline layout creation failed.");
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo = pipelineLayoutCreateInfo();
+    cullLayoutInfo.setLayoutCount = 1;
+    cullLayoutInfo.pSetLayouts = &_cullSetLayout;
+    cullLayoutInfo.pushConstantRangeCount = 1;
+    cullLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VX_CHECK(vkCreatePipelineLayout(_device, &cullLayoutInfo, nullptr, &_cullPipelineLayout), "Occlusion cull pipeline layout creation failed.");
+
+    _buildPipeline = create_compute_pipeline("src/renderer/shaders/hiz_build.comp.spv", _device, _buildPipelineLayout);
+    _cullPipeline = create_compute_pipeline("src/renderer/shaders/occlusion_cull.comp.spv", _device, _cullPipelineLayout);
+}
+
+void OcclusionCuller::destroy() {
+    DeletionManager immediate;
+    destroy_pyramid(immediate);
+    immediate.delete_objects();
+
+    vkDestroyPipeline(_device, _buildPipeline, nullptr);
+    vkDestroyPipeline(_device, _cullPipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _buildPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(_device, _cullPipelineLayout, nullptr);
+    vkDestroySampler(_device, _sampler, nullptr);
+
+    _descriptorAllocator.destroy_pool(_device);
+    vkDestroyDescriptorSetLayout(_device, _buildSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _cullSetLayout, nullptr);
+
+    destroyBuffer(_allocator, *_telemetry, _visibilityBuffer);
+    for(const AllocatedBuffer& drawBuffer : _drawBuffers) {
+        destroyBuffer(_allocator, *_telemetry, drawBuffer);
+    }
+    for(const AllocatedBuffer& statsBuffer : _statsBuffers) {
+        destroyBuffer(_allocator, *_telemetry, statsBuffer);
+    }
+}
+
+void OcclusionCuller::create_pyramid(VkExtent2D depthExtent) {
+    // Level 0 is half the depth resolution, every level after that halves again (rounding down).
+    _pyramidExtent = { std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u) };
+    _pyramidMips = static_cast<uint32_t>(std::floor(std::log2(std::max(_pyramidExtent.width, _pyramidExtent.height)))) + 1;
+    _pyramidMips = std::min(_pyramidMips, MAX_HIZ_MIPS);
+
+    _pyramid.format = VK_FORMAT_R32_SFLOAT;
+    _pyramid.extent = { _pyramidExtent.width, _pyramidExtent.height, 1 };
+
+    VkImageCreateInfo imageInfo = createImageCreateInfo(_pyramid.format,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, _pyramid.extent);
+    imageInfo.mipLevels = _pyramidMips;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VX_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_pyramid.image, &_pyramid.allocation, nullptr), "vmaCreateImage");
+    _telemetry->track(_pyramid.allocation, AllocationCategory::RenderTarget, "hi-z pyramid");
+
+    VkImageViewCreateInfo viewInfo = createImageViewCreateInfo(_pyramid.format, _pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    viewInfo.subresourceRange.levelCount = _pyramidMips;
+    VX_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_pyramid.imageView), "vkCreateImageView");
+
+    for(uint32_t mip = 0; mip < _pyramidMips; mip++) {
+        VkImageViewCreateInfo mipViewInfo = createImageViewCreateInfo(_pyramid.format, _pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+        mipViewInfo.subresourceRange.baseMipLevel = mip;
+        VX_CHECK(vkCreateImageView(_device, &mipViewInfo, nullptr, &_pyramidMipViews[mip]), "vkCreateImageView");
+    }
+
+    _depthExtent = depthExtent;
+    _pyramidNeedsClear = true;
+}
+
+void OcclusionCuller::destroy_pyramid(DeletionManager& frameDeletion) {
+    if(_pyramid.image == VK_NULL_HANDLE) {
+        return;
+    }
+
+    AllocatedImage pyramid = _pyramid;
+    std::vector<VkImageView> mipViews(_pyramidMipViews, _pyramidMipViews + _pyramidMips);
+    frameDeletion.push_function([this, pyramid, mipViews]() {
+        for(VkImageView view : mipViews) {
+            vkDestroyImageView(_device, view, nullptr);
+        }
+        vkDestroyImageView(_device, pyramid.imageView, nullptr);
+        _telemetry->untrack(pyramid.allocation);
+        vmaDestroyImage(_allocator, pyramid.image, pyramid.allocation);
+    });
+
+    _pyramid = {};
+    std::fill(std::begin(_pyramidMipViews), std::end(_pyramidMipViews), VkImageView(VK_NULL_HANDLE));
+    _pyramidMips = 0;
+}
+
+void OcclusionCuller::begin_frame(uint32_t frameIndex, VkExtent2D depthExtent, DeletionManager& frameDeletion) {
+    _frameIndex = frameIndex;
+
+    // The fence for this slot has been waited, so its counts are final.
+    const AllocatedBuffer& statsBuffer = _statsBuffers[frameIndex];
+    vmaInvalidateAllocation(_allocator, statsBuffer.allocation, 0, VK_WHOLE_SIZE);
+    const uint32_t* counts = static_cast<const uint32_t*>(statsBuffer.info.pMappedData);
+    _stats.objects = _lastObjectCount[frameIndex];
+    _stats.early = counts[static_cast<size_t>(Phase::Early)];
+    _stats.late = counts[static_cast<size_t>(Phase::Late)];
+
+    if(depthExtent.width != _depthExtent.width || depthExtent.height != _depthExtent.height) {
+        destroy_pyramid(frameDeletion);
+        create_pyramid(depthExtent);
+    }
+}
+
+void OcclusionCuller::cull(CommandRecorder& cmd, Phase phase, const glm::mat4& viewProj, VkDeviceAddress objects, uint32_t objectCount, bool cullEnabled) {
+    objectCount = std::min(objectCount, _maxObjects);
+
+    if(phase == Phase::Early) {
+        _lastObjectCount[_frameIndex] = objectCount;
+
+        if(_pyramidNeedsClear) {
+            // Depth 0 is the far plane with reverse-Z, so a cleared pyramid occludes nothing.
+            cmd.transition_image(_pyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            VkClearColorValue clearValue = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+            VkImageSubresourceRange clearRange = createImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+            vkCmdClearColorImage(cmd.buffer(), _pyramid.image, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
+            _pyramidNeedsClear = false;
+        }
+
+        // The previous frame's indirect draws and culling must be done before the lists are reset.
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        for(const AllocatedBuffer& drawBuffer : _drawBuffers) {
+            vkCmdFillBuffer(cmd.buffer(), drawBuffer.buffer, 0, sizeof(uint32_t), 0);
+        }
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+        VkDescriptorImageInfo pyramidInfo = {};
+        pyramidInfo.sampler = _sampler;
+        pyramidInfo.imageView = _pyramid.imageView;
+        pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = _cullSets[_frameIndex];
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &pyramidInfo;
+        vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+    } else {
+        // Late phase reads the early visibility flags and the freshly built pyramid.
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+    }
+
+    CullPushConstants pushConstants = {};
+    pushConstants.viewProj = viewProj;
+    pushConstants.objectBuffer = objects;
+    pushConstants.visibilityBuffer = _visibilityBuffer.address;
+    pushConstants.drawBuffer = _drawBuffers[static_cast<size_t>(phase)].address;
+    pushConstants.hizSize = glm::vec2(static_cast<float>(_pyramidExtent.width), static_cast<float>(_pyramidExtent.height));
+    pushConstants.hizMips = _pyramidMips;
+    pushConstants.objectCount = objectCount;
+    pushConstants.phase = static_cast<uint32_t>(phase);
+    pushConstants.cullEnabled = cullEnabled ? 1 : 0;
+
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline, _cullPipelineLayout);
+    cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipelineLayout, 0, 1, &_cullSets[_frameIndex]);
+    cmd.push_constants(_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+    cmd.dispatch((objectCount + 63) / 64, 1, 1);
+
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT);
+}
+
+void OcclusionCuller::build_pyramid(CommandRecorder& cmd, const AllocatedImage& depth) {
+    // Early culling must be done reading the old pyramid before it is overwritten.
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT);
+
+    VkDescriptorImageInfo srcInfos[MAX_HIZ_MIPS] = {};
+    VkDescriptorImageInfo dstInfos[MAX_HIZ_MIPS] = {};
+    VkWriteDescriptorSet writes[MAX_HIZ_MIPS * 2] = {};
+
+    for(uint32_t mip = 0; mip < _pyramidMips; mip++) {
+        srcInfos[mip].sampler = _sampler;
+        srcInfos[mip].imageView = mip == 0 ? depth.imageView : _pyramidMipViews[mip - 1];
+        srcInfos[mip].imageLayout = mip == 0 ? VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        dstInfos[mip].imageView = _pyramidMipViews[mip];
+        dstInfos[mip].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet& srcWrite = writes[mip * 2];
+        srcWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        srcWrite.dstSet = _buildSets[_frameIndex][mip];
+        srcWrite.dstBinding = 0;
+        srcWrite.descriptorCount = 1;
+        srcWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        srcWrite.pImageInfo = &srcInfos[mip];
+
+        VkWriteDescriptorSet& dstWrite = writes[mip * 2 + 1];
+        dstWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        dstWrite.dstSet = _buildSets[_frameIndex][mip];
+        dstWrite.dstBinding = 1;
+        dstWrite.descriptorCount = 1;
+        dstWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        dstWrite.pImageInfo = &dstInfos[mip];
+    }
+    vkUpdateDescriptorSets(_device, _pyramidMips * 2, writes, 0, nullptr);
+
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, _buildPipeline, _buildPipelineLayout);
+    for(uint32_t mip = 0; mip < _pyramidMips; mip++) {
+        uint32_t width = std::max(_pyramidExtent.width >> mip, 1u);
+        uint32_t height = std::max(_pyramidExtent.height >> mip, 1u);
+
+        cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, _buildPipelineLayout, 0, 1, &_buildSets[_frameIndex][mip]);
+        cmd.dispatch((width + 7) / 8, (height + 7) / 8, 1);
+
+        // Each level reads the one before it.
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_READ_BIT);
+    }
+}
+
+void OcclusionCuller::draw_indirect(CommandRecorder& cmd, Phase phase) {
+    const AllocatedBuffer& drawBuffer = _drawBuffers[static_cast<size_t>(phase)];
+    cmd.draw_indirect_count(drawBuffer.buffer, DRAW_COMMANDS_OFFSET, drawBuffer.buffer, 0, _maxObjects, sizeof(VkDrawIndirectCommand));
+}
+
+void OcclusionCuller::end_frame(CommandRecorder& cmd) {
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_READ_BIT);
+
+    for(uint32_t phase = 0; phase < static_cast<uint32_t>(Phase::Count); phase++) {
+        VkBufferCopy region = { .srcOffset = 0, .dstOffset = sizeof(uint32_t) * phase, .size = sizeof(uint32_t) };
+        vkCmdCopyBuffer(cmd.buffer(), _drawBuffers[phase].buffer, _statsBuffers[_frameIndex].buffer, 1, &region);
+    }
+}
+
+} // namespace VxEngine
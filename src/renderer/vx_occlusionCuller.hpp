@@ -0,0 +1,111 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_image.hpp"
+#include "vx_buffer.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_descriptors.hpp"
+#include "vx_deletionManager.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include "../../3rdparty/glm/glm/glm.hpp"
+
+// Two phase Hi-Z occlusion culling. See shaders/occlusion_cull.comp for the phases.
+// The pyramid is built once per frame from the depth of the early phase and is what the
+// next frame's early phase tests against. Draws go through vkCmdDrawIndirectCount with the
+// draw lists written by the cull shader, so the CPU never sees the visible set.
+
+namespace VxEngine {
+
+// Per object data, shared by the geometry and culling shaders (std430).
+struct GPUObjectData {
+    glm::mat4 model;
+    glm::vec4 aabbMin; // World space bounds.
+    glm::vec4 aabbMax;
+};
+
+class OcclusionCuller {
+public:
+    static constexpr uint32_t MAX_HIZ_MIPS = 16;
+
+    enum class Phase : uint32_t {
+        Early = 0,
+        Late = 1,
+        Count
+    };
+
+    struct Stats {
+        uint32_t objects = 0;
+        uint32_t early = 0;
+        uint32_t late = 0;
+    };
+
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, uint32_t maxObjects);
+    void destroy();
+
+    // Called once the frame's fence has been waited. Reads back the stats for that frame slot
+    // and (re)creates the pyramid to match the depth extent.
+    void begin_frame(uint32_t frameIndex, VkExtent2D depthExtent, DeletionManager& frameDeletion);
+
+    void cull(CommandRecorder& cmd, Phase phase, const glm::mat4& viewProj, VkDeviceAddress objects, uint32_t objectCount, bool cullEnabled);
+    // The depth image must be in VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL.
+    void build_pyramid(CommandRecorder& cmd, const AllocatedImage& depth);
+    void draw_indirect(CommandRecorder& cmd, Phase phase);
+    // Copies the draw counts so the CPU can read them once the frame is done.
+    void end_frame(CommandRecorder& cmd);
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct CullPushConstants {
+        glm::mat4 viewProj;
+        VkDeviceAddress objectBuffer;
+        VkDeviceAddress visibilityBuffer;
+        VkDeviceAddress drawBuffer;
+        glm::vec2 hizSize;
+        uint32_t hizMips;
+        uint32_t objectCount;
+        uint32_t phase;
+        uint32_t cullEnabled;
+    };
+
+    static constexpr VkDeviceSize DRAW_COMMANDS_OFFSET = 16; // Draw count lives in the first 16 bytes.
+
+    void create_pyramid(VkExtent2D depthExtent);
+    void destroy_pyramid(DeletionManager& frameDeletion);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    uint32_t _maxObjects = 0;
+    uint32_t _frameIndex = 0;
+
+    // Pyramid, kept in VK_IMAGE_LAYOUT_GENERAL.
+    AllocatedImage _pyramid = {};
+    VkImageView _pyramidMipViews[MAX_HIZ_MIPS] = {};
+    VkExtent2D _pyramidExtent = { 0, 0 };
+    VkExtent2D _depthExtent = { 0, 0 };
+    uint32_t _pyramidMips = 0;
+    bool _pyramidNeedsClear = false;
+    VkSampler _sampler = VK_NULL_HANDLE;
+
+    AllocatedBuffer _visibilityBuffer;
+    AllocatedBuffer _drawBuffers[static_cast<size_t>(Phase::Count)];
+    AllocatedBuffer _statsBuffers[LIVE_FRAMES]; // Host visible copies of the draw counts.
+    uint32_t _lastObjectCount[LIVE_FRAMES] = {};
+    Stats _stats;
+
+    DescriptorManager::DescriptorAllocator _descriptorAllocator;
+    VkDescriptorSetLayout _buildSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _cullSetLayout = VK_NULL_HANDLE;
+    // Sets are rewritten every frame, so each frame slot has its own.
+    VkDescriptorSet _buildSets[LIVE_FRAMES][MAX_HIZ_MIPS] = {};
+    VkDescriptorSet _cullSets[LIVE_FRAMES] = {};
+
+    VkPipelineLayout _buildPipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout _cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _buildPipeline = VK_NULL_HANDLE;
+    VkPipeline _cullPipeline = VK_NULL_HANDLE;
+};
+
+} // namespace VxEngine
@@ -0,0 +1,227 @@
+#include "vx_particles.hpp"
+#include "vx_pipelineCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace VxEngine {
+
+namespace {
+
+// Reverse-Z, tested against the scene's depth without writing it, alpha blended.
+constexpr RasterState PARTICLE_STATE = { .depthTest = VK_TRUE, .depthWrite = VK_FALSE, .depthCompare = VK_COMPARE_OP_GREATER_OR_EQUAL, .blendEnable = VK_TRUE };
+
+constexpr uint32_t GROUP_SIZE = 64;
+
+} // namespace
+
+void ParticleSystem::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, PipelineCache& pipelineCache,
+    uint32_t maxParticles, VkFormat colorFormat, VkFormat depthFormat) {
+    // The reset pass covers every particle in one dispatch, and maxComputeWorkGroupCount is at least 65535.
+    assert(maxParticles <= 65535u * GROUP_SIZE);
+    // Keeps the second alive list 16 byte aligned, buffer references assume it.
+    assert(maxParticles % 4 == 0);
+
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+    _maxParticles = maxParticles;
+    _stats.capacity = maxParticles;
+
+    // Buffers
+    _particleBuffer = createBuffer(_allocator, *_telemetry, sizeof(GPUParticle) * maxParticles,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "particles");
+    _aliveBuffer = createBuffer(_allocator, *_telemetry, sizeof(uint32_t) * 2 * maxParticles,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "particle alive lists");
+    _deadBuffer = createBuffer(_allocator, *_telemetry, sizeof(uint32_t) * maxParticles,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "particle dead list");
+    _counterBuffer = createBuffer(_allocator, *_telemetry, sizeof(ParticleCounters),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "particle counters");
+
+    for(AllocatedBuffer& statsBuffer : _statsBuffers) {
+        statsBuffer = createBuffer(_allocator, *_telemetry, sizeof(uint32_t),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "particle stats");
+    }
+
+    // Simulation pipelines, one layout for all of them.
+    VkPushConstantRange computeRange = {};
+    computeRange.offset = 0;
+    computeRange.size = sizeof(ParticlePushConstants);
+    computeRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo computeLayoutInfo = pipelineLayoutCreateInfo();
+    computeLayoutInfo.pushConstantRangeCount = 1;
+    computeLayoutInfo.pPushConstantRanges = &computeRange;
+    VX_CHECK(vkCreatePipelineLayout(_device, &computeLayoutInfo, nullptr, &_computeLayout), "Particle compute pipeline layout creation failed.");
+
+    _resetPipeline = pipelineCache.compute(pipelineCache.shader("src/renderer/shaders/particle_reset.comp.spv"), _computeLayout);
+    _preparePipeline = pipelineCache.compute(pipelineCache.shader("src/renderer/shaders/particle_prepare.comp.spv"), _computeLayout);
+    _emitPipeline = pipelineCache.compute(pipelineCache.shader("src/renderer/shaders/particle_emit.comp.spv"), _computeLayout);
+    _simulatePipeline = pipelineCache.compute(pipelineCache.shader("src/renderer/shaders/particle_simulate.comp.spv"), _computeLayout);
+
+    // Draw pipeline
+    VkPushConstantRange drawRange = {};
+    drawRange.offset = 0;
+    drawRange.size = sizeof(ParticleDrawPushConstants);
+    drawRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkPipelineLayoutCreateInfo drawLayoutInfo = pipelineLayoutCreateInfo();
+    drawLayoutInfo.pushConstantRangeCount = 1;
+    drawLayoutInfo.pPushConstantRanges = &drawRange;
+    VX_CHECK(vkCreatePipelineLayout(_device, &drawLayoutInfo, nullptr, &_drawLayout), "Particle draw pipeline layout creation failed.");
+
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder._layout = _drawLayout;
+    pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, pipelineCache.shader("src/renderer/shaders/particle.vert.spv"), "main");
+    pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT, pipelineCache.shader("src/renderer/shaders/particle.frag.spv"), "main");
+    pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipelineBuilder.set_multisampling_none();
+    pipelineBuilder.set_raster_state(PARTICLE_STATE);
+    pipelineBuilder.set_color_attachment_format(colorFormat);
+    pipelineBuilder.set_depth_format(depthFormat);
+    _drawPipeline = pipelineCache.graphics(pipelineBuilder);
+    _dynamicState = pipelineCache.dynamic_state();
+}
+
+void ParticleSystem::destroy() {
+    // The pipelines belong to the cache.
+    vkDestroyPipelineLayout(_device, _computeLayout, nullptr);
+    vkDestroyPipelineLayout(_device, _drawLayout, nullptr);
+
+    destroyBuffer(_allocator, *_telemetry, _particleBuffer);
+    destroyBuffer(_allocator, *_telemetry, _aliveBuffer);
+    destroyBuffer(_allocator, *_telemetry, _deadBuffer);
+    destroyBuffer(_allocator, *_telemetry, _counterBuffer);
+    for(const AllocatedBuffer& statsBuffer : _statsBuffers) {
+        destroyBuffer(_allocator, *_telemetry, statsBuffer);
+    }
+}
+
+void ParticleSystem::begin_frame(uint32_t frameIndex) {
+    _frameIndex = frameIndex;
+
+    // The fence for this slot has been waited, so its count is final.
+    if(_statsPending[frameIndex]) {
+        const AllocatedBuffer& statsBuffer = _statsBuffers[frameIndex];
+        vmaInvalidateAllocation(_allocator, statsBuffer.allocation, 0, VK_WHOLE_SIZE);
+        _stats.alive = *static_cast<const uint32_t*>(statsBuffer.info.pMappedData);
+        _statsPending[frameIndex] = false;
+    }
+}
+
+void ParticleSystem::read_alive_count(bool enabled) {
+    _readAlive = enabled;
+    if(!enabled) {
+        _stats.alive = 0;
+        for(bool& pending : _statsPending) {
+            pending = false;
+        }
+    }
+}
+
+void ParticleSystem::update(CommandRecorder& cmd, const ParticleEmitter& emitter, float seconds) {
+    seconds = std::clamp(seconds, 0.0f, MAX_STEP);
+
+    // Whole particles are emitted, the fraction is carried over so low rates still emit on average.
+    float emit = std::max(emitter.rate, 0.0f) * seconds + _emitRemainder;
+    uint32_t emitRequest = static_cast<uint32_t>(std::min(emit, static_cast<float>(_maxParticles)));
+    _emitRemainder = emitRequest < _maxParticles ? emit - static_cast<float>(emitRequest) : 0.0f;
+
+    ParticlePushConstants pushConstants = {};
+    pushConstants.particles = _particleBuffer.address;
+    pushConstants.aliveLists = _aliveBuffer.address;
+    pushConstants.deadList = _deadBuffer.address;
+    pushConstants.counters = _counterBuffer.address;
+    pushConstants.emitter = glm::vec4(emitter.position, emitter.speed);
+    pushConstants.gravityStep = glm::vec4(emitter.gravity, seconds);
+    pushConstants.maxParticles = _maxParticles;
+    pushConstants.emitRequest = emitRequest;
+    pushConstants.current = _current;
+    pushConstants.seed = _seed++;
+    pushConstants.lifetime = emitter.lifetime;
+    pushConstants.spread = emitter.spread;
+
+    auto bind = [&](VkPipeline pipeline) {
+        cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline, _computeLayout);
+        cmd.push_constants(_computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticlePushConstants), &pushConstants);
+    };
+    auto computeToCompute = [&]() {
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+    };
+
+    // The previous update's passes, its draw and its stats copy must be done with the lists first.
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+    if(_needsReset) {
+        bind(_resetPipeline);
+        cmd.dispatch((_maxParticles + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+        computeToCompute();
+        _needsReset = false;
+    }
+
+    bind(_preparePipeline);
+    cmd.dispatch(1, 1, 1);
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+    bind(_emitPipeline);
+    cmd.dispatch_indirect(_counterBuffer.buffer, offsetof(ParticleCounters, emitArgs));
+    computeToCompute();
+
+    bind(_simulatePipeline);
+    cmd.dispatch_indirect(_counterBuffer.buffer, offsetof(ParticleCounters, simulateArgs));
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+
+    // The survivors are drawn now and simulated next.
+    _current = 1 - _current;
+    _updated = true;
+
+    if(!_readAlive) {
+        return;
+    }
+    VkBufferCopy region = {};
+    region.srcOffset = offsetof(ParticleCounters, draws) + sizeof(VkDrawIndirectCommand) * _current + offsetof(VkDrawIndirectCommand, instanceCount);
+    region.dstOffset = 0;
+    region.size = sizeof(uint32_t);
+    vkCmdCopyBuffer(cmd.buffer(), _counterBuffer.buffer, _statsBuffers[_frameIndex].buffer, 1, &region);
+    _statsPending[_frameIndex] = true;
+}
+
+void ParticleSystem::draw(CommandRecorder& cmd, const ParticleEmitter& emitter, const Camera& camera, float aspect) {
+    if(!_updated) {
+        return;
+    }
+
+    // The view's first two rows are the camera's right and up axes in world space.
+    glm::mat4 view = camera.view();
+    ParticleDrawPushConstants pushConstants = {};
+    pushConstants.viewProj = camera.projection(aspect) * view;
+    pushConstants.right = glm::vec4(view[0][0], view[1][0], view[2][0], emitter.size);
+    pushConstants.up = glm::vec4(view[0][1], view[1][1], view[2][1], 0.0f);
+    pushConstants.particles = _particleBuffer.address;
+    pushConstants.aliveList = _aliveBuffer.address + sizeof(uint32_t) * _maxParticles * _current;
+
+    cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, _drawPipeline, _drawLayout);
+    cmd.set_raster_state(PARTICLE_STATE, _dynamicState);
+    cmd.push_constants(_drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ParticleDrawPushConstants), &pushConstants);
+    cmd.draw_indirect(_counterBuffer.buffer, offsetof(ParticleCounters, draws) + sizeof(VkDrawIndirectCommand) * _current, 1, sizeof(VkDrawIndirectCommand));
+}
+
+} // namespace VxEngine
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_buffer.hpp"
+#include "vx_commandRecorder.hpp"
+#include "vx_camera.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include "../../3rdparty/glm/glm/glm.hpp"
+
+// GPU particles. Emission, simulation and drawing never involve the CPU beyond recording:
+//  1. shaders/particle_prepare.comp, one invocation, clamps the requested emission to the dead
+//     particles left and writes the emit and simulate dispatch sizes.
+//  2. shaders/particle_emit.comp pops particles off the dead list and appends them to the current
+//     alive list.
+//  3. shaders/particle_simulate.comp integrates the current alive list and appends survivors to
+//     the other alive list and expired particles to the dead list, so both stay compact.
+//  4. draw() is a vkCmdDrawIndirect whose instance count is the survivor list's length, which the
+//     simulate pass counted atomically.
+// The alive lists swap roles every update. Particle state, the lists and the counters live in
+// device local buffers and nothing is read back per frame. For debugging, read_alive_count() copies
+// the alive count to the host, read a few frames late like the occlusion culler's stats.
+
+namespace VxEngine {
+
+class PipelineCache;
+
+// Matches Particle in the particle shaders (std430).
+struct GPUParticle {
+    glm::vec4 positionAge;      // xyz: world position, w: seconds lived.
+    glm::vec4 velocityLifetime; // xyz: world velocity, w: seconds it lives.
+};
+
+struct ParticleEmitter {
+    glm::vec3 position{ 0.0f, -1.0f, -1.0f };
+    float rate = 100000.0f;   // Particles per second.
+    float speed = 3.0f;       // Initial speed, randomized by +-25%.
+    float spread = 0.35f;     // Radius of the emission cone at unit height.
+    float lifetime = 2.0f;    // Average seconds a particle lives, randomized by +-50%.
+    glm::vec3 gravity{ 0.0f, -2.5f, 0.0f };
+    float size = 0.01f;       // Half the quad's width in world units.
+};
+
+class ParticleSystem {
+public:
+    static constexpr float MAX_STEP = 1.0f / 20.0f; // Longer frames are simulated as this, so a hitch doesn't scatter everything.
+
+    struct Stats {
+        uint32_t alive = 0;   // After the simulate pass of the frame last finished on this slot, 0 unless read_alive_count is on.
+        uint32_t capacity = 0;
+    };
+
+    // Pipelines and shaders come from pipelineCache, which must outlive the system. The draw pipeline
+    // renders into colorFormat with depth tested against depthFormat.
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry, PipelineCache& pipelineCache,
+        uint32_t maxParticles, VkFormat colorFormat, VkFormat depthFormat);
+    void destroy();
+
+    // Called once the frame's fence has been waited. Reads back that slot's alive count.
+    void begin_frame(uint32_t frameIndex);
+
+    // Records the emit and simulate passes for a step of seconds, at most MAX_STEP. The first update
+    // after init or reset() also records putting every particle on the dead list.
+    void update(CommandRecorder& cmd, const ParticleEmitter& emitter, float seconds);
+    // Draws the alive particles of the last update, inside a rendering pass with a depth attachment
+    // and with the viewport set. Depth is tested, not written.
+    void draw(CommandRecorder& cmd, const ParticleEmitter& emitter, const Camera& camera, float aspect);
+    // Kills every particle on the next update.
+    void reset() { _needsReset = true; }
+    // Debug readback of the alive count into stats(), off by default. Adds a copy to every update.
+    void read_alive_count(bool enabled);
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct ParticlePushConstants {
+        VkDeviceAddress particles;
+        VkDeviceAddress aliveLists;
+        VkDeviceAddress deadList;
+        VkDeviceAddress counters;
+        glm::vec4 emitter;     // xyz: position, w: initial speed.
+        glm::vec4 gravityStep; // xyz: gravity, w: time step in seconds.
+        uint32_t maxParticles;
+        uint32_t emitRequest;
+        uint32_t current;
+        uint32_t seed;
+        float lifetime;
+        float spread;
+        uint32_t pad[2];
+    };
+
+    struct ParticleDrawPushConstants {
+        glm::mat4 viewProj;
+        glm::vec4 right; // xyz: camera right axis, w: particle size.
+        glm::vec4 up;
+        VkDeviceAddress particles;
+        VkDeviceAddress aliveList;
+    };
+
+    // Matches Counters in the particle shaders. The draws come first so their offsets are the
+    // indirect draw offsets.
+    struct ParticleCounters {
+        VkDrawIndirectCommand draws[2]; // Per alive list, instanceCount is its length.
+        VkDispatchIndirectCommand emitArgs;
+        VkDispatchIndirectCommand simulateArgs;
+        uint32_t deadCount;
+        uint32_t emitCount;
+    };
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    uint32_t _maxParticles = 0;
+    uint32_t _frameIndex = 0;
+
+    uint32_t _current = 0;    // Alive list drawn after the last update and simulated by the next.
+    bool _needsReset = true;
+    bool _updated = false;    // Whether an update was recorded since the last reset, otherwise draw() has nothing to draw.
+    float _emitRemainder = 0.0f; // Fractional particles carried over to the next step.
+    uint32_t _seed = 0;
+
+    AllocatedBuffer _particleBuffer;
+    AllocatedBuffer _aliveBuffer;    // Two lists of _maxParticles indices.
+    AllocatedBuffer _deadBuffer;
+    AllocatedBuffer _counterBuffer;
+    AllocatedBuffer _statsBuffers[LIVE_FRAMES]; // Host visible copies of the drawn list's length.
+    bool _statsPending[LIVE_FRAMES] = {};
+    bool _readAlive = false;
+    Stats _stats;
+
+    VkPipelineLayout _computeLayout = VK_NULL_HANDLE;
+    VkPipeline _resetPipeline = VK_NULL_HANDLE;
+    VkPipeline _preparePipeline = VK_NULL_HANDLE;
+    VkPipeline _emitPipeline = VK_NULL_HANDLE;
+    VkPipeline _simulatePipeline = VK_NULL_HANDLE;
+
+    VkPipelineLayout _drawLayout = VK_NULL_HANDLE;
+    VkPipeline _drawPipeline = VK_NULL_HANDLE;
+    uint32_t _dynamicState = 0; // The cache's DynamicStateFlags.
+};
+
+} // namespace VxEngine
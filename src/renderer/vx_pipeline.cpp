@@ -1,12 +1,36 @@
 #include "vx_pipeline.hpp"
 #include "vx_utils.hpp"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <vector>
 
 namespace VxEngine {
 
+    PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable = nullptr;
+
+    namespace {
+
+    // Topologies a pipeline with dynamic topology may switch between without a rebuild.
+    uint32_t topologyClass(VkPrimitiveTopology topology) {
+        switch(topology) {
+            case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+                return 0;
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+                return 1;
+            case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+                return 3;
+            default:
+                return 2; // Triangles.
+        }
+    }
+
+    } // namespace
+
     void PipelineBuilder::clear() {
         _inputAssembly = { .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
         _rasterizer = { .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
@@ -16,11 +40,12 @@ namespace VxEngine {
         _depthStencil = { .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
         _renderInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
         _colorFormat = VK_FORMAT_UNDEFINED;
+        _dynamicState = 0;
         _stages.clear();
     }
     
     // Build an empty pipeline to fill with information.
-    VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
+    VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkPipelineCache cache) const {
         VkPipelineViewportStateCreateInfo viewportState = {};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.pNext = nullptr;
@@ -36,7 +61,7 @@ namespace VxEngine {
 
         colorBlending.logicOpEnable = VK_FALSE;
         colorBlending.pNext = nullptr;
-        colorBlending.attachmentCount = 1;
+        colorBlending.attachmentCount = _renderInfo.colorAttachmentCount;
         colorBlending.pAttachments = &_colorBlendAttachment;
 
         // Clear VertexInputStateCreateInfo as we are not using it.
@@ -58,15 +83,27 @@ namespace VxEngine {
         pipelineInfo.pDepthStencilState = &_depthStencil;
         pipelineInfo.layout = _layout;
 
-        VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        if(_dynamicState & DYNAMIC_STATE_CULL_MODE) {
+            dynamicStates.insert(dynamicStates.end(), { VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_FRONT_FACE });
+        }
+        if(_dynamicState & DYNAMIC_STATE_DEPTH) {
+            dynamicStates.insert(dynamicStates.end(), { VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP });
+        }
+        if(_dynamicState & DYNAMIC_STATE_TOPOLOGY) {
+            dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY);
+        }
+        if(_dynamicState & DYNAMIC_STATE_BLEND_ENABLE) {
+            dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+        }
         VkPipelineDynamicStateCreateInfo dynamicState = { .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-        dynamicState.pDynamicStates = &dynamicStates[0];
-        dynamicState.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+        dynamicState.pDynamicStates = dynamicStates.data();
+        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
 
         pipelineInfo.pDynamicState = &dynamicState;
 
         VkPipeline pipeline;
-        if(vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        if(vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
             std::cout << "Failed to create graphics pipeline." << std::endl;
             return VK_NULL_HANDLE;
         }
@@ -74,6 +111,77 @@ namespace VxEngine {
         return pipeline;
     }
 
+    namespace {
+        template<typename T>
+        void appendKey(std::string& key, const T& value) {
+            key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+    } // namespace
+
+    // Field by field rather than the create infos' bytes, which carry pointers and padding.
+    std::string PipelineBuilder::key() const {
+        std::string bytes;
+        bytes.reserve(256);
+        appendKey(bytes, static_cast<uint32_t>(_stages.size()));
+        for(const VkPipelineShaderStageCreateInfo& stage : _stages) {
+            appendKey(bytes, stage.stage);
+            appendKey(bytes, stage.module);
+            bytes.append(stage.pName, strlen(stage.pName) + 1); // With the terminator, so names can't run into the next field.
+        }
+        appendKey(bytes, _layout);
+        appendKey(bytes, _dynamicState);
+
+        uint32_t topology = (_dynamicState & DYNAMIC_STATE_TOPOLOGY) ? topologyClass(_inputAssembly.topology) : static_cast<uint32_t>(_inputAssembly.topology);
+        appendKey(bytes, topology);
+        appendKey(bytes, _inputAssembly.primitiveRestartEnable);
+
+        appendKey(bytes, _rasterizer.polygonMode);
+        appendKey(bytes, _rasterizer.lineWidth);
+        if(!(_dynamicState & DYNAMIC_STATE_CULL_MODE)) {
+            appendKey(bytes, _rasterizer.cullMode);
+            appendKey(bytes, _rasterizer.frontFace);
+        }
+
+        appendKey(bytes, _multisampling.rasterizationSamples);
+        appendKey(bytes, _multisampling.sampleShadingEnable);
+        appendKey(bytes, _multisampling.minSampleShading);
+        appendKey(bytes, _multisampling.alphaToCoverageEnable);
+        appendKey(bytes, _multisampling.alphaToOneEnable);
+
+        if(!(_dynamicState & DYNAMIC_STATE_DEPTH)) {
+            appendKey(bytes, _depthStencil.depthTestEnable);
+            appendKey(bytes, _depthStencil.depthWriteEnable);
+            appendKey(bytes, _depthStencil.depthCompareOp);
+        }
+        appendKey(bytes, _depthStencil.depthBoundsTestEnable);
+        appendKey(bytes, _depthStencil.stencilTestEnable);
+
+        if(_renderInfo.colorAttachmentCount > 0) {
+            if(!(_dynamicState & DYNAMIC_STATE_BLEND_ENABLE)) {
+                appendKey(bytes, _colorBlendAttachment.blendEnable);
+            }
+            appendKey(bytes, _colorBlendAttachment.srcColorBlendFactor);
+            appendKey(bytes, _colorBlendAttachment.dstColorBlendFactor);
+            appendKey(bytes, _colorBlendAttachment.colorBlendOp);
+            appendKey(bytes, _colorBlendAttachment.srcAlphaBlendFactor);
+            appendKey(bytes, _colorBlendAttachment.dstAlphaBlendFactor);
+            appendKey(bytes, _colorBlendAttachment.alphaBlendOp);
+            appendKey(bytes, _colorBlendAttachment.colorWriteMask);
+            appendKey(bytes, _colorFormat);
+        }
+
+        appendKey(bytes, _renderInfo.viewMask);
+        appendKey(bytes, _renderInfo.colorAttachmentCount);
+        appendKey(bytes, _renderInfo.depthAttachmentFormat);
+        appendKey(bytes, _renderInfo.stencilAttachmentFormat);
+        return bytes;
+    }
+
+    uint64_t PipelineBuilder::hash() const {
+        std::string bytes = key();
+        return hashBytes(bytes.data(), bytes.size());
+    }
+
     void PipelineBuilder::add_shader_stage(VkShaderStageFlagBits stage, VkShaderModule module, const char* entryPoint) {
         _stages.push_back(createShaderStageCreateInfo(stage, module, entryPoint));
     }
@@ -119,6 +227,49 @@ namespace VxEngine {
         _renderInfo.depthAttachmentFormat = format;
     }
 
+    void PipelineBuilder::set_view_mask(uint32_t viewMask) {
+        _renderInfo.viewMask = viewMask;
+    }
+
+    void PipelineBuilder::disable_color_attachment() {
+        _colorFormat = VK_FORMAT_UNDEFINED;
+        _renderInfo.colorAttachmentCount = 0;
+        _renderInfo.pColorAttachmentFormats = nullptr;
+    }
+
+    void PipelineBuilder::enable_depth_test(bool depthWriteEnable, VkCompareOp op) {
+        _depthStencil.depthTestEnable = VK_TRUE;
+        _depthStencil.depthWriteEnable = depthWriteEnable ? VK_TRUE : VK_FALSE;
+        _depthStencil.depthCompareOp = op;
+        _depthStencil.depthBoundsTestEnable = VK_FALSE;
+        _depthStencil.stencilTestEnable = VK_FALSE;
+        _depthStencil.front = {};
+        _depthStencil.back = {};
+        _depthStencil.minDepthBounds = 0.0f;
+        _depthStencil.maxDepthBounds = 1.0f;
+    }
+
+    // Blending, where it is enabled, is regular alpha blending. The factors are set either way, so a
+    // pipeline with dynamic blend enable can turn it on.
+    void PipelineBuilder::set_raster_state(const RasterState& state) {
+        set_input_topology(state.topology);
+        set_cull_mode(state.cullMode, state.frontFace);
+        if(state.depthTest) {
+            enable_depth_test(state.depthWrite, state.depthCompare);
+        } else {
+            disable_depth_test();
+        }
+
+        disable_blending();
+        _colorBlendAttachment.blendEnable = state.blendEnable;
+        _colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        _colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        _colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        _colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        _colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        _colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+
     void PipelineBuilder::disable_depth_test() {
         _depthStencil.depthTestEnable = VK_FALSE;
         _depthStencil.depthWriteEnable = VK_FALSE;
@@ -162,4 +313,23 @@ namespace VxEngine {
         return true;
     }
 
+    VkPipeline create_compute_pipeline(const char* filePath, VkDevice device, VkPipelineLayout layout) {
+        VkShaderModule shaderModule;
+        if(!load_shader_module(filePath, device, &shaderModule)) {
+            throw std::runtime_error("Failed to load compute shader module");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = nullptr;
+        pipelineInfo.stage = createShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule, "main");
+        pipelineInfo.layout = layout;
+
+        VkPipeline pipeline;
+        VX_CHECK(vkCreateComputePipelines(device, nullptr, 1, &pipelineInfo, nullptr, &pipeline), "Compute pipeline creation failed.");
+
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+        return pipeline;
+    }
+
 } // namespace VxEngine
\ No newline at end of file
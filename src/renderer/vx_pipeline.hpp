@@ -10,6 +10,15 @@
 
 namespace VxEngine {
 
+    // Per pass data for the geometry passes. Per object data (model matrix) is read from
+    // objectBuffer, indexed by the instance index the cull shader writes into each draw.
+    // clusterParams points at the frame's GPUClusterParams for the fragment stage.
+    struct GeometryPushConstants {
+        glm::mat4 viewProj;
+        VkDeviceAddress objectBuffer;
+        VkDeviceAddress clusterParams;
+    };
+
     struct ComputePushConstants {
         glm::vec4 data1;
         glm::vec4 data2;
@@ -17,6 +26,35 @@ namespace VxEngine {
         glm::vec4 data4;
     };
     
+    // Fixed function state a graphics pipeline can leave to the command buffer. Pipelines that only
+    // differ in dynamic state are one pipeline, so the less is baked in the fewer permutations are built.
+    enum DynamicStateFlags : uint32_t {
+        DYNAMIC_STATE_CULL_MODE = 1u << 0,    // Cull mode and front face.
+        DYNAMIC_STATE_DEPTH = 1u << 1,        // Depth test, depth write and compare op.
+        DYNAMIC_STATE_TOPOLOGY = 1u << 2,     // Only within the topology class the pipeline was built with.
+        DYNAMIC_STATE_BLEND_ENABLE = 1u << 3, // VK_EXT_extended_dynamic_state3, optional.
+    };
+
+    // Core in Vulkan 1.3, so always available on the devices we run on.
+    constexpr uint32_t CORE_DYNAMIC_STATE = DYNAMIC_STATE_CULL_MODE | DYNAMIC_STATE_DEPTH | DYNAMIC_STATE_TOPOLOGY;
+
+    // The state covered by DynamicStateFlags. Baked into pipelines through PipelineBuilder::set_raster_state,
+    // and set while recording through CommandRecorder::set_raster_state for the parts that are dynamic.
+    // VkBool32 rather than bool, so there is no padding and the struct hashes by its bytes.
+    struct RasterState {
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+        VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+        VkBool32 depthTest = VK_FALSE;
+        VkBool32 depthWrite = VK_FALSE;
+        VkCompareOp depthCompare = VK_COMPARE_OP_ALWAYS;
+        VkBool32 blendEnable = VK_FALSE;
+    };
+
+    // vkCmdSetColorBlendEnableEXT isn't exported by the loader. PipelineCache::init loads it when
+    // DYNAMIC_STATE_BLEND_ENABLE is supported, otherwise it stays null.
+    extern PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable;
+
     // Wrapper class for a compute pipeline.
     struct ComputePipeline {
         std::string name;
@@ -41,11 +79,20 @@ namespace VxEngine {
             VkPipelineDepthStencilStateCreateInfo _depthStencil;
             VkPipelineRenderingCreateInfo _renderInfo;
             VkFormat _colorFormat;
+            uint32_t _dynamicState; // DynamicStateFlags, the matching baked state is ignored.
 
             void clear();
             void clear_stages() { _stages.clear(); };
 
-            VkPipeline build_pipeline(VkDevice device);
+            // cache is an optional driver side VkPipelineCache. Prefer PipelineCache::graphics, which
+            // returns the already built pipeline when the same state is requested again.
+            VkPipeline build_pipeline(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE) const;
+
+            // Identifies the pipeline build_pipeline would create, as canonical bytes that compare equal
+            // exactly when the pipelines would. Dynamic state isn't part of it, and shader modules are
+            // identified by handle, so they must stay alive as long as the key is used.
+            std::string key() const;
+            uint64_t hash() const; // Of key().
 
             void add_shader_stage(VkShaderStageFlagBits stage, VkShaderModule module, const char* entryPoint);
             void set_input_topology(VkPrimitiveTopology topo);
@@ -55,10 +102,18 @@ namespace VxEngine {
             void disable_blending();
             void set_color_attachment_format(VkFormat format);
             void set_depth_format(VkFormat format);
+            void disable_color_attachment(); // Depth only pipelines (e.g. the depth prepass).
             void disable_depth_test();
+            void enable_depth_test(bool depthWriteEnable, VkCompareOp op);
+            void set_view_mask(uint32_t viewMask); // Multiview, must match the view mask the pass renders with.
+            void set_raster_state(const RasterState& state); // Topology, cull mode, depth and blending at once.
+            void set_dynamic_state(uint32_t dynamicState) { _dynamicState = dynamicState; }
     };
 
     // Load a shader module from a file.
     bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* module);
+
+    // Load a compute shader and build its pipeline. Throws if the shader can't be loaded.
+    VkPipeline create_compute_pipeline(const char* filePath, VkDevice device, VkPipelineLayout layout);
     
 } // namespace VxEngine
\ No newline at end of file
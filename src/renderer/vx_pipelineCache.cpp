@@ -0,0 +1,113 @@
+#include "vx_pipelineCache.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+namespace VxEngine {
+
+namespace {
+
+std::string pipeline_key(VkPipelineBindPoint bindPoint) {
+    return std::string(reinterpret_cast<const char*>(&bindPoint), sizeof(bindPoint));
+}
+
+} // namespace
+
+void PipelineCache::init(VkDevice device, uint32_t dynamicState) {
+    _device = device;
+    _dynamicState = dynamicState;
+
+    if(_dynamicState & DYNAMIC_STATE_BLEND_ENABLE) {
+        cmdSetColorBlendEnable = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT"));
+        if(!cmdSetColorBlendEnable) {
+            _dynamicState &= ~DYNAMIC_STATE_BLEND_ENABLE;
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    VX_CHECK(vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_driverCache), "vkCreatePipelineCache");
+}
+
+void PipelineCache::destroy() {
+    for(auto& [key, pipeline] : _pipelines) {
+        vkDestroyPipeline(_device, pipeline, nullptr);
+    }
+    for(auto& [path, module] : _shaders) {
+        vkDestroyShaderModule(_device, module, nullptr);
+    }
+    _pipelines.clear();
+    _shaders.clear();
+
+    vkDestroyPipelineCache(_device, _driverCache, nullptr);
+    _driverCache = VK_NULL_HANDLE;
+    cmdSetColorBlendEnable = nullptr;
+}
+
+VkShaderModule PipelineCache::shader(const char* filePath) {
+    auto it = _shaders.find(filePath);
+    if(it != _shaders.end()) {
+        return it->second;
+    }
+
+    VkShaderModule module;
+    if(!load_shader_module(filePath, _device, &module)) {
+        throw std::runtime_error(std::string("Failed to load shader module ") + filePath);
+    }
+    _shaders.emplace(filePath, module);
+    return module;
+}
+
+VkPipeline PipelineCache::graphics(const PipelineBuilder& builder) {
+    PipelineBuilder request = builder;
+    request.set_dynamic_state(_dynamicState);
+    // set_color_attachment_format points the copy's rendering info at the original's format.
+    if(request._renderInfo.colorAttachmentCount > 0) {
+        request._renderInfo.pColorAttachmentFormats = &request._colorFormat;
+    }
+
+    std::string key = pipeline_key(VK_PIPELINE_BIND_POINT_GRAPHICS);
+    key += request.key();
+    auto it = _pipelines.find(key);
+    if(it != _pipelines.end()) {
+        _stats.hits++;
+        return it->second;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkPipeline pipeline = request.build_pipeline(_device, _driverCache);
+    _stats.buildMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    if(pipeline == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE; // Not cached, a later request tries again.
+    }
+
+    _stats.built++;
+    _pipelines.emplace(std::move(key), pipeline);
+    return pipeline;
+}
+
+VkPipeline PipelineCache::compute(VkShaderModule module, VkPipelineLayout layout) {
+    std::string key = pipeline_key(VK_PIPELINE_BIND_POINT_COMPUTE);
+    key.append(reinterpret_cast<const char*>(&module), sizeof(module));
+    key.append(reinterpret_cast<const char*>(&layout), sizeof(layout));
+    auto it = _pipelines.find(key);
+    if(it != _pipelines.end()) {
+        _stats.hits++;
+        return it->second;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo = { .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    pipelineInfo.stage = createShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, module, "main");
+    pipelineInfo.layout = layout;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    VkPipeline pipeline;
+    VX_CHECK(vkCreateComputePipelines(_device, _driverCache, 1, &pipelineInfo, nullptr, &pipeline), "Compute pipeline creation failed.");
+    _stats.buildMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    _stats.built++;
+    _pipelines.emplace(std::move(key), pipeline);
+    return pipeline;
+}
+
+} // namespace VxEngine
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_pipeline.hpp"
+
+#include <string>
+#include <unordered_map>
+
+// Owns every pipeline and shader module built through it, keyed by what identifies them: graphics
+// pipelines by PipelineBuilder::key, compute pipelines by module and layout, shader modules by path.
+// Keys are compared in full on lookup, so a hash collision can't return another request's pipeline.
+// Asking for the same state again returns the existing handle instead of compiling another copy, so
+// passes and materials can request pipelines freely without tracking which ones already exist.
+//
+// Graphics pipelines are built with every DynamicStateFlags bit the device supports, which folds the
+// variants that only differ in cull mode, depth state, topology or blending into one pipeline. Code
+// drawing with them sets that state through CommandRecorder::set_raster_state.
+//
+// Shader modules stay loaded until destroy(), builder hashes identify modules by handle and a
+// destroyed module's handle could come back for a different shader. Pipeline layouts have the
+// same requirement and are owned by the passes, which destroy them at shutdown only.
+
+namespace VxEngine {
+
+class PipelineCache {
+public:
+    struct Stats {
+        uint32_t built = 0;     // Pipelines compiled.
+        uint32_t hits = 0;      // Requests answered with an existing pipeline.
+        double buildMs = 0.0;   // Spent in vkCreate*Pipelines.
+    };
+
+    // dynamicState is the DynamicStateFlags the device supports. Loads cmdSetColorBlendEnable when it
+    // includes DYNAMIC_STATE_BLEND_ENABLE.
+    void init(VkDevice device, uint32_t dynamicState);
+    void destroy();
+
+    // Throws if the file can't be loaded.
+    VkShaderModule shader(const char* filePath);
+
+    // The builder's own dynamic state is replaced with the supported one. Shader stages should use
+    // modules from shader(). Returns VK_NULL_HANDLE if the pipeline fails to build.
+    VkPipeline graphics(const PipelineBuilder& builder);
+    VkPipeline compute(VkShaderModule module, VkPipelineLayout layout);
+
+    uint32_t dynamic_state() const { return _dynamicState; }
+    const Stats& stats() const { return _stats; }
+
+private:
+    VkDevice _device = VK_NULL_HANDLE;
+    uint32_t _dynamicState = 0;
+    VkPipelineCache _driverCache = VK_NULL_HANDLE; // Lets the driver reuse compiled code between similar pipelines.
+
+    std::unordered_map<std::string, VkPipeline> _pipelines; // By bind point followed by the request's key.
+    std::unordered_map<std::string, VkShaderModule> _shaders;
+    Stats _stats;
+};
+
+} // namespace VxEngine
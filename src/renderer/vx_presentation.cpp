@@ -0,0 +1,217 @@
+#include "vx_presentation.hpp"
+
+#include "../../3rdparty/imgui/imgui.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace VxEngine {
+
+namespace {
+
+struct PresentModeName {
+    const char* name;
+    VkPresentModeKHR mode;
+};
+
+constexpr PresentModeName PRESENT_MODE_NAMES[] = {
+    { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+    { "relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+    { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+    { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+};
+
+float milliseconds(LatencyClock::time_point from, LatencyClock::time_point to) {
+    return std::chrono::duration<float, std::milli>(to - from).count();
+}
+
+} // namespace
+
+bool parsePresentMode(const char* name, VkPresentModeKHR& mode) {
+    for(const PresentModeName& entry : PRESENT_MODE_NAMES) {
+        if(strcmp(name, entry.name) == 0) {
+            mode = entry.mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* presentModeName(VkPresentModeKHR mode) {
+    for(const PresentModeName& entry : PRESENT_MODE_NAMES) {
+        if(entry.mode == mode) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
+
+VkPresentModeKHR choosePresentMode(VkPresentModeKHR requested, const std::vector<VkPresentModeKHR>& supported) {
+    std::vector<VkPresentModeKHR> preference;
+    switch(requested) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            preference = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+            break;
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            preference = { VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+            break;
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            preference = { VK_PRESENT_MODE_MAILBOX_KHR };
+            break;
+        default:
+            break;
+    }
+
+    for(VkPresentModeKHR mode : preference) {
+        if(std::find(supported.begin(), supported.end(), mode) != supported.end()) {
+            return mode;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t chooseSwapchainImageCount(uint32_t requested, const VkSurfaceCapabilitiesKHR& capabilities) {
+    uint32_t count = requested > 0 ? requested : capabilities.minImageCount + 1;
+    count = std::max(count, capabilities.minImageCount);
+    if(capabilities.maxImageCount > 0) { // 0 means no upper limit.
+        count = std::min(count, capabilities.maxImageCount);
+    }
+    return count;
+}
+
+void LatencyTracker::init(VkDevice device, bool presentWait) {
+    _device = device;
+    if(presentWait) {
+        _waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+    }
+    if(_waitForPresent) {
+        _stop = false;
+        _waiter = std::thread([this]() { wait_loop(); });
+    }
+}
+
+void LatencyTracker::destroy() {
+    if(_waiter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        _waiter.join();
+    }
+    _pendingCount = 0;
+    _swapchain = VK_NULL_HANDLE;
+    _waitForPresent = nullptr;
+}
+
+void LatencyTracker::set_swapchain(VkSwapchainKHR swapchain) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return !_waiting; });
+
+    // Presents on the old swapchain still count towards the CPU side latencies.
+    for(uint32_t i = 0; i < _pendingCount; i++) {
+        add_sample(_pending[(_pendingFirst + i) % MAX_PENDING]);
+    }
+    _pendingCount = 0;
+    _swapchain = swapchain;
+}
+
+void LatencyTracker::record(const FrameTimestamps& frame) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(frame.presentId == 0 || !_waiter.joinable() || _pendingCount == MAX_PENDING) {
+            add_sample(frame);
+            return;
+        }
+        _pending[(_pendingFirst + _pendingCount++) % MAX_PENDING] = frame;
+    }
+    _wake.notify_one();
+}
+
+void LatencyTracker::wait_loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true) {
+        _wake.wait(lock, [this]() { return _stop || _pendingCount > 0; });
+        if(_stop) {
+            return;
+        }
+
+        FrameTimestamps frame = _pending[_pendingFirst];
+        _pendingFirst = (_pendingFirst + 1) % MAX_PENDING;
+        _pendingCount--;
+        VkSwapchainKHR swapchain = _swapchain;
+        _waiting = true;
+        lock.unlock();
+
+        // Ids increase with every present, so waiting on them in order never skips a completion.
+        VkResult result = _waitForPresent(_device, swapchain, frame.presentId, DEFAULT_TIMEOUT_NS);
+        LatencyClock::time_point now = LatencyClock::now();
+
+        lock.lock();
+        _waiting = false;
+        if(result == VK_SUCCESS) {
+            frame.displayed = true;
+            frame.display = now;
+        }
+        add_sample(frame); // Timed out or out of date frames keep their CPU side timestamps.
+        _idle.notify_all();
+    }
+}
+
+void LatencyTracker::add_sample(const FrameTimestamps& frame) {
+    _history[_historyNext] = frame;
+    _historyNext = (_historyNext + 1) % HISTORY;
+    _historyCount = std::min(_historyCount + 1, HISTORY);
+}
+
+LatencyTracker::Averages LatencyTracker::averages() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Averages averages;
+    uint32_t inputDisplayed = 0;
+    for(uint32_t i = 0; i < _historyCount; i++) {
+        const FrameTimestamps& frame = _history[i];
+        averages.frames++;
+        averages.startToSubmitMs += milliseconds(frame.frameStart, frame.submit);
+        averages.submitToPresentMs += milliseconds(frame.submit, frame.present);
+        if(frame.hasInput) {
+            averages.inputFrames++;
+            averages.inputToPresentMs += milliseconds(frame.input, frame.present);
+        }
+        if(frame.displayed) {
+            averages.displayedFrames++;
+            averages.presentToDisplayMs += milliseconds(frame.present, frame.display);
+            if(frame.hasInput) {
+                inputDisplayed++;
+                averages.inputToDisplayMs += milliseconds(frame.input, frame.display);
+            }
+        }
+    }
+
+    auto average = [](float& sum, uint32_t count) { sum = count > 0 ? sum / static_cast<float>(count) : 0.0f; };
+    average(averages.startToSubmitMs, averages.frames);
+    average(averages.submitToPresentMs, averages.frames);
+    average(averages.inputToPresentMs, averages.inputFrames);
+    average(averages.presentToDisplayMs, averages.displayedFrames);
+    average(averages.inputToDisplayMs, inputDisplayed);
+    return averages;
+}
+
+void LatencyTracker::draw_imgui() {
+    Averages latency = averages();
+    if(ImGui::Begin("latency")) {
+        ImGui::Text("Frames: %u, with input: %u, displayed: %u", latency.frames, latency.inputFrames, latency.displayedFrames);
+        ImGui::Text("%-18s %7.3f ms", "start to submit", latency.startToSubmitMs);
+        ImGui::Text("%-18s %7.3f ms", "submit to present", latency.submitToPresentMs);
+        ImGui::Text("%-18s %7.3f ms", "input to present", latency.inputToPresentMs);
+        if(present_wait()) {
+            ImGui::Text("%-18s %7.3f ms", "present to display", latency.presentToDisplayMs);
+            ImGui::Text("%-18s %7.3f ms", "input to display", latency.inputToDisplayMs);
+        } else {
+            ImGui::TextDisabled("Present wait unsupported, display times unavailable");
+        }
+    }
+    ImGui::End();
+}
+
+} // namespace VxEngine
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "vx_utils.hpp"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Present mode and swapchain image count selection, and frame latency measurement. Every presented
+// frame is timestamped at its oldest input event, when the render thread picks it up, after submit
+// and after present. With VK_KHR_present_id and VK_KHR_present_wait a waiter thread also blocks on
+// each present id, which adds the moment the image actually reached the display.
+
+namespace VxEngine {
+
+using LatencyClock = std::chrono::high_resolution_clock;
+
+// The modes offered in the UI, in the order of their --present-mode names.
+inline constexpr VkPresentModeKHR SELECTABLE_PRESENT_MODES[] = {
+    VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+
+// fifo, relaxed, mailbox or immediate, as passed to --present-mode.
+bool parsePresentMode(const char* name, VkPresentModeKHR& mode);
+const char* presentModeName(VkPresentModeKHR mode);
+
+// requested if the surface supports it, otherwise the closest supported mode: tearing modes fall back
+// to the lowest latency mode left, tear free ones only to other tear free modes. FIFO always exists.
+VkPresentModeKHR choosePresentMode(VkPresentModeKHR requested, const std::vector<VkPresentModeKHR>& supported);
+
+// requested clamped to the surface's limits, 0 asks for one more than the minimum.
+uint32_t chooseSwapchainImageCount(uint32_t requested, const VkSurfaceCapabilitiesKHR& capabilities);
+
+struct FrameTimestamps {
+    uint64_t presentId = 0; // 0 if the frame's present completion isn't waited for.
+    bool hasInput = false;
+    LatencyClock::time_point input;      // Oldest input event the frame responds to.
+    LatencyClock::time_point frameStart; // Render thread picked the frame up.
+    LatencyClock::time_point submit;     // vkQueueSubmit2 returned.
+    LatencyClock::time_point present;    // vkQueuePresentKHR returned.
+    bool displayed = false;
+    LatencyClock::time_point display;    // vkWaitForPresentKHR returned.
+};
+
+class LatencyTracker {
+public:
+    static constexpr uint32_t HISTORY = 128; // Frames averaged.
+    static constexpr uint32_t MAX_PENDING = 16; // Presents awaiting completion, later ones skip the wait.
+
+    // Averages over the history. Input latencies only count frames that had input, display
+    // latencies only frames whose present completion was observed.
+    struct Averages {
+        float startToSubmitMs = 0.0f;
+        float submitToPresentMs = 0.0f;
+        float presentToDisplayMs = 0.0f;
+        float inputToPresentMs = 0.0f;
+        float inputToDisplayMs = 0.0f;
+        uint32_t frames = 0;
+        uint32_t inputFrames = 0;
+        uint32_t displayedFrames = 0;
+    };
+
+    // presentWait: VK_KHR_present_id and VK_KHR_present_wait are enabled on the device.
+    void init(VkDevice device, bool presentWait);
+    void destroy();
+
+    // Present ids are waited on this swapchain. Waits pending on the previous one are dropped, so
+    // it may be destroyed once this returns.
+    void set_swapchain(VkSwapchainKHR swapchain);
+
+    bool present_wait() const { return _waitForPresent != nullptr; }
+
+    // Id to chain into the next present through VkPresentIdKHR, 0 if completion isn't tracked.
+    uint64_t next_present_id() { return present_wait() ? ++_lastPresentId : 0; }
+
+    // Render thread, once the frame is presented.
+    void record(const FrameTimestamps& frame);
+
+    Averages averages() const;
+    void draw_imgui();
+
+private:
+    void wait_loop();
+    void add_sample(const FrameTimestamps& frame); // _mutex held.
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VkSwapchainKHR _swapchain = VK_NULL_HANDLE;
+    PFN_vkWaitForPresentKHR _waitForPresent = nullptr; // Not exported by the loader, fetched from the device.
+    uint64_t _lastPresentId = 0;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    std::array<FrameTimestamps, MAX_PENDING> _pending; // Presented, completion not yet observed. A ring, so recording doesn't allocate.
+    uint32_t _pendingFirst = 0;
+    uint32_t _pendingCount = 0;
+    bool _waiting = false;                // The waiter is inside vkWaitForPresentKHR.
+    bool _stop = false;
+    std::thread _waiter;
+
+    std::array<FrameTimestamps, HISTORY> _history;
+    uint32_t _historyCount = 0;
+    uint32_t _historyNext = 0;
+};
+
+} // namespace VxEngine
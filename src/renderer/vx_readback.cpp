@@ -0,0 +1,326 @@
+#include "vx_readback.hpp"
+#include "vx_image.hpp"
+#include "vx_imageWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace VxEngine {
+
+void ReadbackService::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = &telemetry;
+    _stopping = false;
+    _worker = std::thread(&ReadbackService::worker_loop, this);
+}
+
+void ReadbackService::destroy() {
+    // Everything recorded has finished, so every in flight copy can be processed.
+    {
+        std::lock_guard<std::mutex> lock(_jobMutex);
+        for(std::vector<Copy>& copies : _inFlight) {
+            for(Copy& copy : copies) {
+                _jobs.push_back(std::move(copy));
+            }
+            copies.clear();
+        }
+        _stopping = true;
+    }
+    _jobCondition.notify_one();
+    if(_worker.joinable()) {
+        _worker.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_requestMutex);
+        for(Request& request : _queued) {
+            request.promise.set_value(ReadbackResult{});
+        }
+        _queued.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    for(const AllocatedBuffer& buffer : _freeBuffers) {
+        destroyBuffer(_allocator, *_telemetry, buffer);
+    }
+    _freeBuffers.clear();
+}
+
+std::future<ReadbackResult> ReadbackService::request(ReadbackTarget target, ImageFileFormat fileFormat, std::string path) {
+    Request request = { target, fileFormat, std::move(path), {} };
+    std::future<ReadbackResult> future = request.promise.get_future();
+
+    std::lock_guard<std::mutex> lock(_requestMutex);
+    _queued.push_back(std::move(request));
+    return future;
+}
+
+void ReadbackService::begin_frame(uint32_t frameIndex, uint64_t frameNumber) {
+    _frameIndex = frameIndex;
+    _frameNumber = frameNumber;
+
+    std::vector<Copy>& finished = _inFlight[frameIndex];
+    if(finished.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_jobMutex);
+        for(Copy& copy : finished) {
+            _jobs.push_back(std::move(copy));
+        }
+    }
+    finished.clear();
+    _jobCondition.notify_one();
+}
+
+void ReadbackService::record(VkCommandBuffer cmd, ReadbackTarget target, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format) {
+    std::vector<Request> requests;
+    {
+        std::lock_guard<std::mutex> lock(_requestMutex);
+        auto split = std::stable_partition(_queued.begin(), _queued.end(), [target](const Request& request) {
+            return request.target != target;
+        });
+        std::move(split, _queued.end(), std::back_inserter(requests));
+        _queued.erase(split, _queued.end());
+    }
+
+    if(requests.empty()) {
+        return;
+    }
+
+    uint32_t texelSize = readbackTexelSize(format);
+    if(texelSize == 0) {
+        std::cerr << "Readback: unsupported format " << string_VkFormat(format) << std::endl;
+        for(Request& request : requests) {
+            request.promise.set_value(ReadbackResult{});
+        }
+        return;
+    }
+
+    if(layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        transitionImageLayout(cmd, image, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * texelSize;
+    for(Request& request : requests) {
+        AllocatedBuffer buffer = acquire_buffer(size);
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0; // Tightly packed.
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { extent.width, extent.height, 1 };
+        vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer.buffer, 1, &region);
+
+        _inFlight[_frameIndex].push_back(Copy{ std::move(request), buffer, _frameNumber, extent.width, extent.height, format });
+    }
+
+    // Make the copies visible to the host once the fence signals.
+    memoryBarrier(cmd,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_HOST_BIT,
+        VK_ACCESS_2_HOST_READ_BIT);
+
+    if(layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        transitionImageLayout(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout);
+    }
+}
+
+uint32_t ReadbackService::pending_count() const {
+    std::lock_guard<std::mutex> lock(_requestMutex);
+    uint32_t count = static_cast<uint32_t>(_queued.size());
+    for(const std::vector<Copy>& copies : _inFlight) {
+        count += static_cast<uint32_t>(copies.size());
+    }
+    return count;
+}
+
+AllocatedBuffer ReadbackService::acquire_buffer(VkDeviceSize size) {
+    {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        // Smallest idle buffer that fits.
+        auto best = _freeBuffers.end();
+        for(auto it = _freeBuffers.begin(); it != _freeBuffers.end(); ++it) {
+            if(it->info.size >= size && (best == _freeBuffers.end() || it->info.size < best->info.size)) {
+                best = it;
+            }
+        }
+        if(best != _freeBuffers.end()) {
+            AllocatedBuffer buffer = *best;
+            _freeBuffers.erase(best);
+            return buffer;
+        }
+    }
+
+    return createBuffer(_allocator, *_telemetry, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "readback");
+}
+
+void ReadbackService::release_buffer(const AllocatedBuffer& buffer) {
+    {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        if(_freeBuffers.size() < MAX_POOLED_BUFFERS) {
+            _freeBuffers.push_back(buffer);
+            return;
+        }
+    }
+    destroyBuffer(_allocator, *_telemetry, buffer);
+}
+
+void ReadbackService::worker_loop() {
+    while(true) {
+        Copy copy;
+        {
+            std::unique_lock<std::mutex> lock(_jobMutex);
+            _jobCondition.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+            if(_jobs.empty()) {
+                return; // Stopping and drained.
+            }
+            copy = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+        process(copy);
+    }
+}
+
+void ReadbackService::process(Copy& copy) {
+    ReadbackResult result;
+    result.frameNumber = copy.frameNumber;
+    result.width = copy.width;
+    result.height = copy.height;
+    result.format = copy.format;
+
+    size_t size = static_cast<size_t>(copy.width) * copy.height * readbackTexelSize(copy.format);
+    vmaInvalidateAllocation(_allocator, copy.buffer.allocation, 0, size);
+    const uint8_t* mapped = static_cast<const uint8_t*>(copy.buffer.info.pMappedData);
+    result.pixels.assign(mapped, mapped + size);
+    release_buffer(copy.buffer);
+
+    result.success = true;
+    if(copy.request.fileFormat != ImageFileFormat::None && !copy.request.path.empty()) {
+        const char* path = copy.request.path.c_str();
+        if(copy.request.fileFormat == ImageFileFormat::PNG) {
+            std::vector<uint8_t> rgba;
+            result.success = convertToRGBA8(copy.format, result.pixels.data(), copy.width, copy.height, rgba)
+                && writePNG(path, copy.width, copy.height, rgba.data());
+        } else {
+            std::vector<uint16_t> rgba;
+            result.success = convertToRGBAHalf(copy.format, result.pixels.data(), copy.width, copy.height, rgba)
+                && writeEXR(path, copy.width, copy.height, rgba.data());
+        }
+
+        if(result.success) {
+            result.path = copy.request.path;
+            std::cout << "Readback: wrote " << path << std::endl;
+        } else {
+            std::cerr << "Readback: failed to write " << path << std::endl;
+        }
+    }
+
+    copy.request.promise.set_value(std::move(result));
+}
+
+uint32_t readbackTexelSize(VkFormat format) {
+    switch(format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+namespace {
+
+// Reads one texel as linear float RGBA (8 bit formats as stored, without decoding sRGB).
+void loadTexel(VkFormat format, const uint8_t* texel, float rgba[4]) {
+    switch(format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            for(int c = 0; c < 4; c++) rgba[c] = texel[c] / 255.0f;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            rgba[0] = texel[2] / 255.0f;
+            rgba[1] = texel[1] / 255.0f;
+            rgba[2] = texel[0] / 255.0f;
+            rgba[3] = texel[3] / 255.0f;
+            break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: {
+            uint16_t halves[4];
+            memcpy(halves, texel, sizeof(halves));
+            for(int c = 0; c < 4; c++) rgba[c] = halfToFloat(halves[c]);
+            break;
+        }
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            memcpy(rgba, texel, sizeof(float) * 4);
+            break;
+        default:
+            rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0.0f;
+            break;
+    }
+}
+
+} // namespace
+
+bool convertToRGBA8(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out) {
+    uint32_t texelSize = readbackTexelSize(format);
+    if(texelSize == 0) {
+        return false;
+    }
+
+    size_t count = static_cast<size_t>(width) * height;
+    out.resize(count * 4);
+    if(format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB) {
+        memcpy(out.data(), pixels, out.size());
+        return true;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        float rgba[4];
+        loadTexel(format, pixels + i * texelSize, rgba);
+        for(int c = 0; c < 4; c++) {
+            out[i * 4 + c] = static_cast<uint8_t>(std::clamp(rgba[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+    return true;
+}
+
+bool convertToRGBAHalf(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint16_t>& out) {
+    uint32_t texelSize = readbackTexelSize(format);
+    if(texelSize == 0) {
+        return false;
+    }
+
+    size_t count = static_cast<size_t>(width) * height;
+    out.resize(count * 4);
+    if(format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+        memcpy(out.data(), pixels, out.size() * sizeof(uint16_t));
+        return true;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        float rgba[4];
+        loadTexel(format, pixels + i * texelSize, rgba);
+        for(int c = 0; c < 4; c++) {
+            out[i * 4 + c] = floatToHalf(rgba[c]);
+        }
+    }
+    return true;
+}
+
+} // namespace VxEngine
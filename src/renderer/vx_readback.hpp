@@ -0,0 +1,114 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_buffer.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous image readback. A request is queued from any thread and returns a future.
+// The renderer records the copy into the frame's own command buffer at the point where the
+// image is readable, into a pooled host visible buffer. Once that frame slot's fence has been
+// waited (begin_frame), the buffer goes to a worker thread which converts and optionally
+// encodes the pixels before resolving the future. The render loop never waits on a readback.
+
+namespace VxEngine {
+
+enum class ReadbackTarget : uint32_t {
+    DrawImage = 0, // The HDR draw image, before ImGui.
+    Swapchain,     // What is presented, including ImGui.
+};
+
+enum class ImageFileFormat : uint32_t {
+    None = 0, // Pixels only.
+    PNG,      // 8 bit, clamped.
+    EXR,      // Half float.
+};
+
+struct ReadbackResult {
+    bool success = false;
+    uint64_t frameNumber = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED; // Format of pixels.
+    std::vector<uint8_t> pixels;           // Tightly packed rows, as copied from the image.
+    std::string path;                      // File written, if any.
+};
+
+class ReadbackService {
+public:
+    // Idle buffers kept for reuse. Buffers released beyond this are destroyed.
+    static constexpr uint32_t MAX_POOLED_BUFFERS = 4;
+
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry& telemetry);
+    // The device must be idle. Requests that were never recorded resolve unsuccessfully.
+    void destroy();
+
+    // Thread safe. The capture happens on the next frame that records the target.
+    std::future<ReadbackResult> request(ReadbackTarget target, ImageFileFormat fileFormat = ImageFileFormat::None, std::string path = {});
+
+    // Called once the frame slot's fence has been waited. Hands the slot's finished copies to the worker.
+    void begin_frame(uint32_t frameIndex, uint64_t frameNumber);
+
+    // Records copies for the queued requests of target. The image is returned to layout afterwards.
+    void record(VkCommandBuffer cmd, ReadbackTarget target, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format);
+
+    uint32_t pending_count() const;
+
+private:
+    struct Request {
+        ReadbackTarget target;
+        ImageFileFormat fileFormat;
+        std::string path;
+        std::promise<ReadbackResult> promise;
+    };
+
+    struct Copy {
+        Request request;
+        AllocatedBuffer buffer;
+        uint64_t frameNumber;
+        uint32_t width;
+        uint32_t height;
+        VkFormat format;
+    };
+
+    AllocatedBuffer acquire_buffer(VkDeviceSize size);
+    void release_buffer(const AllocatedBuffer& buffer);
+
+    void worker_loop();
+    void process(Copy& copy);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    uint32_t _frameIndex = 0;
+    uint64_t _frameNumber = 0;
+
+    mutable std::mutex _requestMutex;
+    std::vector<Request> _queued;
+    std::vector<Copy> _inFlight[LIVE_FRAMES]; // Render thread only.
+
+    std::mutex _poolMutex;
+    std::vector<AllocatedBuffer> _freeBuffers;
+
+    std::thread _worker;
+    std::mutex _jobMutex;
+    std::condition_variable _jobCondition;
+    std::deque<Copy> _jobs;
+    bool _stopping = false;
+};
+
+// Bytes per texel for the formats readback understands, or 0 if unsupported.
+uint32_t readbackTexelSize(VkFormat format);
+
+// Converts tightly packed pixels to 8 bit RGBA / half float RGBA. False for unsupported formats.
+bool convertToRGBA8(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+bool convertToRGBAHalf(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint16_t>& out);
+
+} // namespace VxEngine
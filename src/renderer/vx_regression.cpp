@@ -0,0 +1,299 @@
+#include "vx_regression.hpp"
+#include "vx_renderer.hpp"
+#include "vx_imageWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace VxEngine {
+
+namespace {
+
+struct RegressionCase {
+    std::string name; // Also the golden's file name.
+    std::function<void(FrameState&)> setup;
+};
+
+struct CaseTimings {
+    float recordMs = 0.0f; // Primary command buffer recording, render thread.
+    float mainMs = 0.0f;   // Input and UI, main thread.
+};
+
+struct ImageComparison {
+    uint32_t pixels = 0;
+    uint32_t differentPixels = 0; // Beyond maxDeltaE.
+    float maxDeltaE = 0.0f;
+    float meanDeltaE = 0.0f;
+};
+
+// One case per background effect, drawn behind the default scene, and the geometry pass in the
+// configurations that shade differently.
+std::vector<RegressionCase> regressionCases(const VulkanRenderer& renderer) {
+    std::vector<RegressionCase> cases;
+    for(size_t i = 0; i < renderer._computePipelines.size(); i++) {
+        cases.push_back(RegressionCase{ "background_" + renderer._computePipelines[i].name, [i](FrameState& state) {
+            state.computePipeline = static_cast<int>(i);
+        } });
+    }
+    cases.push_back(RegressionCase{ "geometry_prepass", [](FrameState& state) {
+        state.depthPrepass = true;
+    } });
+    cases.push_back(RegressionCase{ "geometry_lights", [](FrameState& state) {
+        state.lightCount = 1000;
+    } });
+    return cases;
+}
+
+// CIELAB from 8 bit sRGB, D65 white.
+std::array<float, 3> srgbToLab(const uint8_t* rgb) {
+    static const std::array<float, 256> toLinear = []() {
+        std::array<float, 256> table{};
+        for(int i = 0; i < 256; i++) {
+            float c = static_cast<float>(i) / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+
+    float r = toLinear[rgb[0]];
+    float g = toLinear[rgb[1]];
+    float b = toLinear[rgb[2]];
+    float xyz[3] = {
+        (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f,
+        0.2126f * r + 0.7152f * g + 0.0722f * b,
+        (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f };
+    for(float& t : xyz) {
+        t = t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+    }
+    return { 116.0f * xyz[1] - 16.0f, 500.0f * (xyz[0] - xyz[1]), 200.0f * (xyz[1] - xyz[2]) };
+}
+
+// Alpha is ignored, the draw image's is meaningless. diff shows pixels beyond the tolerance in red
+// over a dimmed copy of the actual image.
+ImageComparison compareImages(const std::vector<uint8_t>& actual, const std::vector<uint8_t>& golden, float maxDeltaE, std::vector<uint8_t>& diff) {
+    ImageComparison result;
+    if(actual.size() != golden.size()) {
+        return result;
+    }
+
+    size_t pixels = actual.size() / 4;
+    result.pixels = static_cast<uint32_t>(pixels);
+    diff.resize(actual.size());
+    double totalDeltaE = 0.0;
+    for(size_t i = 0; i < pixels; i++) {
+        std::array<float, 3> a = srgbToLab(&actual[i * 4]);
+        std::array<float, 3> b = srgbToLab(&golden[i * 4]);
+        float deltaE = std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+
+        totalDeltaE += deltaE;
+        result.maxDeltaE = std::max(result.maxDeltaE, deltaE);
+        uint8_t* out = &diff[i * 4];
+        if(deltaE > maxDeltaE) {
+            result.differentPixels++;
+            out[0] = 255;
+            out[1] = 0;
+            out[2] = 0;
+        } else {
+            out[0] = actual[i * 4] / 4;
+            out[1] = actual[i * 4 + 1] / 4;
+            out[2] = actual[i * 4 + 2] / 4;
+        }
+        out[3] = 255;
+    }
+    result.meanDeltaE = pixels > 0 ? static_cast<float>(totalDeltaE / pixels) : 0.0f;
+    return result;
+}
+
+float median(std::vector<float> samples) {
+    if(samples.empty()) {
+        return 0.0f;
+    }
+    auto middle = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), middle, samples.end());
+    return *middle;
+}
+
+// case,record_ms,main_ms per line, after a header.
+std::unordered_map<std::string, CaseTimings> readBaseline(const std::filesystem::path& path) {
+    std::unordered_map<std::string, CaseTimings> baseline;
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line); // Header.
+    while(std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        std::string recordMs;
+        std::string mainMs;
+        if(std::getline(fields, name, ',') && std::getline(fields, recordMs, ',') && std::getline(fields, mainMs, ',')) {
+            baseline[name] = CaseTimings{ std::strtof(recordMs.c_str(), nullptr), std::strtof(mainMs.c_str(), nullptr) };
+        }
+    }
+    return baseline;
+}
+
+bool drawFrames(VulkanRenderer& renderer, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        if(!renderer.frame()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool slower(float ms, float baselineMs, const RegressionOptions& options) {
+    return ms > baselineMs * (1.0f + options.timingThreshold) && ms - baselineMs > options.timingFloorMs;
+}
+
+} // namespace
+
+int runRegression(VulkanRenderer& renderer, const RegressionOptions& options) {
+    const std::filesystem::path directory = options.directory;
+    const std::filesystem::path baselinePath = directory / "timings.csv";
+    if(options.update) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if(error) {
+            std::cerr << "Failed to create " << directory.string() << ": " << error.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if(!std::filesystem::exists(baselinePath)) {
+        std::cout << "Regression check skipped: no baseline in " << directory.string()
+            << ". Generate it with --update on the reference setup, see tests/regression/README.txt." << std::endl;
+        return REGRESSION_SKIPPED;
+    }
+    std::unordered_map<std::string, CaseTimings> baseline = options.update ? std::unordered_map<std::string, CaseTimings>{} : readBaseline(baselinePath);
+
+    struct Row {
+        std::string name;
+        const char* image; // Outcome of the comparison.
+        ImageComparison comparison;
+        CaseTimings timings;
+        bool hasBaseline;
+        CaseTimings baseline;
+        bool slow;
+    };
+    std::vector<Row> rows;
+
+    const FrameState initialState = renderer._frameState;
+    for(const RegressionCase& regressionCase : regressionCases(renderer)) {
+        renderer._frameState = initialState;
+        regressionCase.setup(renderer._frameState);
+
+        if(!drawFrames(renderer, options.settleFrames)) {
+            std::cerr << "Regression run aborted, window closed." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // Recorded into the first timed frame, resolved a few frames later.
+        std::future<ReadbackResult> readback = renderer.capture(ReadbackTarget::DrawImage);
+        std::vector<float> recordMs;
+        std::vector<float> mainMs;
+        for(uint32_t i = 0; i < options.timedFrames || readback.wait_for(std::chrono::seconds(0)) != std::future_status::ready; i++) {
+            if(!renderer.frame()) {
+                std::cerr << "Regression run aborted, window closed." << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(i < options.timedFrames) {
+                recordMs.push_back(renderer._cpuRecordMs);
+                mainMs.push_back(renderer._mainFrameMs);
+            }
+        }
+
+        Row row = { regressionCase.name, "ok" };
+        row.timings = CaseTimings{ median(recordMs), median(mainMs) };
+
+        ReadbackResult result = readback.get();
+        std::vector<uint8_t> actual;
+        if(!result.success || !convertToRGBA8(result.format, result.pixels.data(), result.width, result.height, actual)) {
+            row.image = "no readback";
+            rows.push_back(row);
+            continue;
+        }
+
+        const std::filesystem::path goldenPath = directory / (regressionCase.name + ".png");
+        if(options.update) {
+            row.image = writePNG(goldenPath.string().c_str(), result.width, result.height, actual.data()) ? "updated" : "write failed";
+            rows.push_back(row);
+            continue;
+        }
+
+        uint32_t goldenWidth = 0;
+        uint32_t goldenHeight = 0;
+        std::vector<uint8_t> golden;
+        std::vector<uint8_t> diff;
+        if(!readPNG(goldenPath.string().c_str(), goldenWidth, goldenHeight, golden)) {
+            row.image = "no golden";
+        } else if(goldenWidth != result.width || goldenHeight != result.height) {
+            row.image = "size differs";
+        } else {
+            row.comparison = compareImages(actual, golden, options.maxDeltaE, diff);
+            if(row.comparison.differentPixels > options.maxDifferentPixels * result.width * result.height) {
+                row.image = "DIFFERS";
+            }
+        }
+
+        // Kept next to the golden for inspection.
+        if(std::strcmp(row.image, "ok") != 0) {
+            std::string actualPath = (directory / (regressionCase.name + ".actual.png")).string();
+            writePNG(actualPath.c_str(), result.width, result.height, actual.data());
+            if(!diff.empty()) {
+                std::string diffPath = (directory / (regressionCase.name + ".diff.png")).string();
+                writePNG(diffPath.c_str(), result.width, result.height, diff.data());
+            }
+        }
+
+        auto found = baseline.find(regressionCase.name);
+        row.hasBaseline = found != baseline.end();
+        if(row.hasBaseline) {
+            row.baseline = found->second;
+            row.slow = slower(row.timings.recordMs, row.baseline.recordMs, options) || slower(row.timings.mainMs, row.baseline.mainMs, options);
+        }
+        rows.push_back(row);
+    }
+    renderer._frameState = initialState;
+
+    bool failed = false;
+    std::printf("------- Regression (%u timed frames per case, %s) -------\n", options.timedFrames, options.directory.c_str());
+    std::printf("%-24s %-12s %10s %8s %8s %12s %12s %12s %12s\n", "case", "image", "differ %", "max dE", "mean dE",
+        "record ms", "baseline", "main ms", "baseline");
+    for(const Row& row : rows) {
+        bool imageFailed = std::strcmp(row.image, "ok") != 0 && std::strcmp(row.image, "updated") != 0;
+        failed |= imageFailed || row.slow || (!options.update && !row.hasBaseline);
+        std::printf("%-24s %-12s %10.4f %8.2f %8.2f %12.4f %12.4f %12.4f %12.4f%s\n", row.name.c_str(), row.image,
+            row.comparison.pixels > 0 ? row.comparison.differentPixels * 100.0 / row.comparison.pixels : 0.0,
+            row.comparison.maxDeltaE, row.comparison.meanDeltaE,
+            row.timings.recordMs, row.baseline.recordMs, row.timings.mainMs, row.baseline.mainMs,
+            row.slow ? "  SLOWER" : (!options.update && !row.hasBaseline ? "  no baseline" : ""));
+    }
+    std::printf("(images fail beyond %.3f%% of pixels over dE %.1f; timings are medians and fail %.0f%% and %.2f ms over the baseline)\n",
+        options.maxDifferentPixels * 100.0f, options.maxDeltaE, options.timingThreshold * 100.0f, options.timingFloorMs);
+
+    if(options.update) {
+        std::ofstream csv(baselinePath);
+        if(!csv.is_open()) {
+            std::cerr << "Failed to write the timing baseline: " << baselinePath.string() << std::endl;
+            return EXIT_FAILURE;
+        }
+        csv << "case,record_ms,main_ms\n";
+        for(const Row& row : rows) {
+            csv << row.name << "," << row.timings.recordMs << "," << row.timings.mainMs << "\n";
+        }
+        std::cout << "Wrote goldens and timing baseline to " << options.directory << std::endl;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+} // namespace VxEngine
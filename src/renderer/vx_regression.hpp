@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Golden image and CPU timing regression checks. Every case sets up the frame state, draws a few
+// frames to let the occlusion pyramid and the caches settle, reads the draw image back and compares
+// it to a stored golden image, then times more frames against a stored baseline.
+//
+// Runs headless, so it works on a software ICD in CI without a GPU, e.g. lavapipe with
+// VK_DRIVER_FILES pointing at its ICD manifest and SDL_VIDEODRIVER=offscreen. Goldens are only
+// comparable on the driver they were made with; timings only on the machine.
+//
+// Selected from the command line, see main.cpp:
+//   --regress <dir> [--update] [--frames N]
+// --update writes the goldens and the baseline instead of checking against them.
+
+namespace VxEngine {
+
+class VulkanRenderer;
+
+struct RegressionOptions {
+    std::string directory;             // <case>.png goldens and timings.csv.
+    bool update = false;
+    uint32_t settleFrames = 8;         // Drawn before the readback.
+    uint32_t timedFrames = 60;
+    float maxDeltaE = 2.3f;            // CIE76 color difference a pixel may have, about one just noticeable difference.
+    float maxDifferentPixels = 0.001f; // Fraction of pixels allowed beyond maxDeltaE.
+    float timingThreshold = 0.25f;     // Slowdown over the baseline that fails, as a fraction of it.
+    float timingFloorMs = 0.05f;       // Slowdowns smaller than this are noise and never fail.
+};
+
+// Exit code of a check without a timings.csv in the directory, ctest's SKIP_RETURN_CODE.
+constexpr int REGRESSION_SKIPPED = 77;
+
+// Returns a process exit code, failure if any image or timing regressed or a golden is missing.
+// REGRESSION_SKIPPED if there is no baseline at all yet.
+int runRegression(VulkanRenderer& renderer, const RegressionOptions& options);
+
+} // namespace VxEngine
@@ -0,0 +1,727 @@
+#include "vx_renderServer.hpp"
+#include "vx_renderer.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace VxEngine {
+
+#ifdef __linux__
+
+namespace {
+
+constexpr uint32_t CONVERT_MODE_RGBA8 = 0;       // frame_convert.comp's MODE_RGBA8.
+constexpr int IDLE_POLL_MS = 250;                // Longest wait for clients, to notice a stop signal.
+constexpr VkDeviceSize STAGING_ALIGNMENT = 256;  // Between frames in a batch's staging buffer.
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+struct ConvertPushConstants { // frame_convert.comp's.
+    VkDeviceAddress frame;
+    glm::uvec2 size;
+    uint32_t mode;
+    uint32_t pad;
+};
+
+struct Client {
+    int fd = -1;
+    RenderJobRequest request; // Partially received.
+    size_t received = 0;
+};
+
+struct Job {
+    uint64_t id = 0;
+    int client = -1; // Socket, -1 once the client has gone.
+    uint64_t tag = 0;
+    const ComputePipeline* effect = nullptr;
+    ComputePushConstants data = {};
+    ComputePushConstants step = {};
+    VkExtent2D extent = {};
+    uint32_t frames = 0;
+    size_t frameBytes = 0;
+    uint32_t recorded = 0;  // Frames submitted to the GPU.
+    uint32_t delivered = 0; // Frames copied into the memfd.
+    uint32_t inFlight = 0;
+    int memfd = -1;
+    uint8_t* mapping = nullptr;
+    AllocatedImage image;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
+
+struct BatchFrame {
+    uint64_t job;
+    uint32_t frame;
+    VkDeviceSize offset; // Into the slot's staging buffer.
+};
+
+// One command buffer in flight. Reused once its fence has been waited and its frames delivered.
+struct BatchSlot {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    AllocatedBuffer staging;
+    std::vector<BatchFrame> frames;
+    bool submitted = false;
+};
+
+struct ServerStats {
+    uint64_t jobs = 0;     // Completed.
+    uint64_t rejected = 0;
+    uint64_t frames = 0;   // Delivered.
+    uint64_t batches = 0;
+};
+
+ComputePushConstants frameConstants(const Job& job, uint32_t frame) {
+    float t = static_cast<float>(frame);
+    ComputePushConstants data = job.data;
+    data.data1 += job.step.data1 * t;
+    data.data2 += job.step.data2 * t;
+    data.data3 += job.step.data3 * t;
+    data.data4 += job.step.data4 * t;
+    return data;
+}
+
+ComputePushConstants toPushConstants(const float (&values)[16]) {
+    ComputePushConstants data;
+    static_assert(sizeof(data) == sizeof(values));
+    std::memcpy(&data, values, sizeof(data));
+    return data;
+}
+
+class RenderServer {
+public:
+    RenderServer(VulkanRenderer& renderer, const RenderServerOptions& options) : _renderer(renderer), _options(options) {}
+
+    bool init();
+    void run();
+    void destroy();
+
+private:
+    void poll_clients(int timeoutMs);
+    void accept_clients();
+    bool receive(Client& client);
+    void handle_request(Client& client);
+    bool create_job(Job& job);
+    void release_job(uint64_t id);
+    void disconnect(Client& client);
+    void send_reply(int fd, const RenderJobReply& reply, int memfd);
+
+    bool record_batch(BatchSlot& slot);
+    void retire_batch(BatchSlot& slot);
+    bool has_work() const;
+
+    VulkanRenderer& _renderer;
+    RenderServerOptions _options;
+
+    int _listenFd = -1;
+    bool _bound = false;
+    std::vector<Client> _clients;
+
+    std::unordered_map<uint64_t, Job> _jobs;
+    std::vector<uint64_t> _order; // Job ids in arrival order, for round robin batching.
+    uint64_t _nextJobId = 1;
+    uint64_t _queuedBytes = 0;    // memfd bytes of the jobs in _jobs.
+
+    VkDescriptorSetLayout _imageLayout = VK_NULL_HANDLE;
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout _convertLayout = VK_NULL_HANDLE;
+    VkPipeline _convertPipeline = VK_NULL_HANDLE; // Owned by the renderer's pipeline cache.
+
+    BatchSlot _slots[LIVE_FRAMES];
+    uint32_t _slotIndex = 0;
+    CommandStats _commandStats;
+    ServerStats _stats;
+};
+
+bool RenderServer::init() {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(_options.socketPath.empty() || _options.socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Render server: socket path must be 1 to " << sizeof(address.sun_path) - 1 << " characters" << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, _options.socketPath.c_str(), _options.socketPath.size());
+
+    // A socket left behind by a server that didn't shut down cleanly. Anything else is not ours to remove.
+    struct stat existing;
+    if(lstat(_options.socketPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        unlink(_options.socketPath.c_str());
+    }
+
+    _listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(_listenFd < 0 || bind(_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Render server: failed to bind " << _options.socketPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    _bound = true;
+    if(listen(_listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Render server: failed to listen: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    VkDevice device = _renderer._device;
+
+    // Identical to the draw image layout, so job sets bind with the background effects' pipeline layout.
+    DescriptorManager::DescriptorLayoutBuilder layoutBuilder;
+    layoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    _imageLayout = layoutBuilder.build(device, VK_SHADER_STAGE_ALL, nullptr, 0);
+
+    // Sets come and go with jobs, so unlike the renderer's pool this one frees them individually.
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _options.maxJobs };
+    VkDescriptorPoolCreateInfo poolInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets = _options.maxJobs;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VX_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &_descriptorPool), "Render server descriptor pool creation failed.");
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ConvertPushConstants);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo layoutInfo = pipelineLayoutCreateInfo();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &_imageLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    VX_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &_convertLayout), "Render server convert pipeline layout creation failed.");
+    _convertPipeline = _renderer._pipelineCache.compute(_renderer._pipelineCache.shader("src/renderer/shaders/frame_convert.comp.spv"), _convertLayout);
+
+    VkCommandPoolCreateInfo commandPoolInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = _renderer._graphicsQueueFamilyIndex;
+    VkFenceCreateInfo fenceInfo = createFenceInfo(0);
+    for(BatchSlot& slot : _slots) {
+        VX_CHECK(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &slot.commandPool), "failed to create render server command pool");
+        VkCommandBufferAllocateInfo allocInfo = createCommandBufferAllocateInfo(slot.commandPool, 1, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        VX_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer), "failed to allocate render server command buffer");
+        VX_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &slot.fence), "failed to create render server fence");
+        slot.staging = createBuffer(_renderer._allocator, _renderer._memoryTelemetry, _options.batchBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "render server batch");
+    }
+
+    return true;
+}
+
+void RenderServer::destroy() {
+    VkDevice device = _renderer._device;
+    if(_convertLayout != VK_NULL_HANDLE) {
+        VX_CHECK(vkDeviceWaitIdle(device), "vkDeviceWaitIdle");
+    }
+
+    std::vector<uint64_t> remaining = _order;
+    for(uint64_t id : remaining) {
+        release_job(id);
+    }
+    for(Client& client : _clients) {
+        close(client.fd);
+    }
+    _clients.clear();
+
+    for(BatchSlot& slot : _slots) {
+        if(slot.staging.buffer != VK_NULL_HANDLE) {
+            destroyBuffer(_renderer._allocator, _renderer._memoryTelemetry, slot.staging);
+        }
+        vkDestroyFence(device, slot.fence, nullptr);
+        vkDestroyCommandPool(device, slot.commandPool, nullptr);
+        slot = BatchSlot{};
+    }
+    vkDestroyPipelineLayout(device, _convertLayout, nullptr);
+    vkDestroyDescriptorPool(device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, _imageLayout, nullptr);
+    _convertLayout = VK_NULL_HANDLE;
+    _descriptorPool = VK_NULL_HANDLE;
+    _imageLayout = VK_NULL_HANDLE;
+
+    if(_listenFd >= 0) {
+        close(_listenFd);
+        _listenFd = -1;
+    }
+    if(_bound) {
+        unlink(_options.socketPath.c_str());
+        _bound = false;
+    }
+}
+
+void RenderServer::run() {
+    stopRequested = 0;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cout << "Render server listening on " << _options.socketPath << std::endl;
+    while(!stopRequested) {
+        poll_clients(has_work() ? 0 : IDLE_POLL_MS);
+
+        // Slots are used in turn. Waiting on the older one here is the only place the server blocks on
+        // the GPU, and by then the newer batch is already queued behind it.
+        BatchSlot& slot = _slots[_slotIndex];
+        if(slot.submitted) {
+            retire_batch(slot);
+        }
+        if(record_batch(slot)) {
+            VkCommandBufferSubmitInfo commandInfo = createCommandBufferSubmitInfo(slot.commandBuffer);
+            VkSubmitInfo2 submitInfo = createSubmitInfo2(&commandInfo, nullptr, nullptr);
+            VX_CHECK(vkQueueSubmit2(_renderer._graphicsQueue, 1, &submitInfo, slot.fence), "failed to submit render server batch");
+            slot.submitted = true;
+            _stats.batches++;
+        }
+        _slotIndex = (_slotIndex + 1) % LIVE_FRAMES;
+    }
+
+    std::printf("------- Render server -------\n");
+    std::printf("%llu jobs, %llu frames in %llu batches (%.1f frames per batch), %llu requests rejected\n",
+        static_cast<unsigned long long>(_stats.jobs), static_cast<unsigned long long>(_stats.frames),
+        static_cast<unsigned long long>(_stats.batches), _stats.batches > 0 ? static_cast<double>(_stats.frames) / _stats.batches : 0.0,
+        static_cast<unsigned long long>(_stats.rejected));
+}
+
+bool RenderServer::has_work() const {
+    for(const BatchSlot& slot : _slots) {
+        if(slot.submitted) {
+            return true;
+        }
+    }
+    for(const auto& [id, job] : _jobs) {
+        if(job.client >= 0 && job.recorded < job.frames) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RenderServer::poll_clients(int timeoutMs) {
+    VX_TRACE_SCOPE("poll clients");
+    std::vector<pollfd> fds;
+    fds.reserve(_clients.size() + 1);
+    fds.push_back(pollfd{ _listenFd, POLLIN, 0 });
+    for(const Client& client : _clients) {
+        fds.push_back(pollfd{ client.fd, POLLIN, 0 });
+    }
+
+    if(poll(fds.data(), fds.size(), timeoutMs) <= 0) {
+        return; // Timed out, or interrupted by a stop signal.
+    }
+
+    // Clients accepted below are polled from the next call on, so fds still lines up with _clients.
+    size_t polledClients = _clients.size();
+    if(fds[0].revents & POLLIN) {
+        accept_clients();
+    }
+
+    std::vector<size_t> closed;
+    for(size_t i = 0; i < polledClients; i++) {
+        if(fds[i + 1].revents != 0 && !receive(_clients[i])) {
+            closed.push_back(i);
+        }
+    }
+    for(auto it = closed.rbegin(); it != closed.rend(); ++it) {
+        disconnect(_clients[*it]);
+        _clients.erase(_clients.begin() + static_cast<std::ptrdiff_t>(*it));
+    }
+}
+
+void RenderServer::accept_clients() {
+    while(true) {
+        int fd = accept4(_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            return; // EAGAIN once the backlog is drained.
+        }
+        Client client;
+        client.fd = fd;
+        _clients.push_back(client);
+    }
+}
+
+// Reads whatever has arrived and handles every request completed by it. False once the client has gone.
+bool RenderServer::receive(Client& client) {
+    while(true) {
+        char* destination = reinterpret_cast<char*>(&client.request) + client.received;
+        ssize_t count = recv(client.fd, destination, sizeof(RenderJobRequest) - client.received, 0);
+        if(count > 0) {
+            client.received += static_cast<size_t>(count);
+            if(client.received == sizeof(RenderJobRequest)) {
+                handle_request(client);
+                client.received = 0;
+            }
+        } else if(count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else if(count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+}
+
+void RenderServer::handle_request(Client& client) {
+    const RenderJobRequest& request = client.request;
+
+    RenderJobReply reply;
+    reply.tag = request.tag;
+    reply.width = request.width;
+    reply.height = request.height;
+    reply.frames = request.frames;
+
+    char effectName[sizeof(request.effect) + 1] = {};
+    std::memcpy(effectName, request.effect, sizeof(request.effect));
+    const ComputePipeline* effect = nullptr;
+    for(const ComputePipeline& pipeline : _renderer._computePipelines) {
+        if(pipeline.name == effectName) {
+            effect = &pipeline;
+        }
+    }
+
+    // Checked by division, so no option or request value can overflow the 64 bit size. A job beyond
+    // the whole queue budget would never fit, so it is too large rather than busy.
+    uint64_t pixels = static_cast<uint64_t>(request.width) * request.height;
+    uint64_t byteLimit = std::min(_options.maxJobBytes, _options.maxQueuedBytes);
+    bool tooManyBytes = request.frames > 0 && pixels > byteLimit / (4ull * request.frames);
+    uint64_t jobBytes = tooManyBytes ? 0 : pixels * 4 * request.frames;
+
+    if(request.magic != RENDER_SERVER_MAGIC || request.version != RENDER_SERVER_VERSION
+        || request.width == 0 || request.height == 0 || request.frames == 0) {
+        reply.status = RenderJobStatus::BadRequest;
+    } else if(request.width > _options.maxExtent || request.height > _options.maxExtent || request.frames > _options.maxFrames || tooManyBytes) {
+        reply.status = RenderJobStatus::TooLarge;
+    } else if(effect == nullptr) {
+        reply.status = RenderJobStatus::UnknownEffect;
+    } else if(_jobs.size() >= _options.maxJobs || jobBytes > _options.maxQueuedBytes - _queuedBytes) {
+        reply.status = RenderJobStatus::Busy;
+    }
+
+    if(reply.status != RenderJobStatus::Ok) {
+        _stats.rejected++;
+        send_reply(client.fd, reply, -1);
+        return;
+    }
+
+    Job job;
+    job.id = _nextJobId++;
+    job.client = client.fd;
+    job.tag = request.tag;
+    job.effect = effect;
+    job.data = toPushConstants(request.data);
+    job.step = toPushConstants(request.step);
+    job.extent = { request.width, request.height };
+    job.frames = request.frames;
+    job.frameBytes = static_cast<size_t>(pixels * 4);
+
+    bool created = false;
+    try {
+        created = create_job(job);
+    } catch(const std::exception& e) {
+        std::cerr << "Render server: " << e.what() << std::endl;
+    }
+    _jobs.emplace(job.id, job);
+    _order.push_back(job.id);
+    _queuedBytes += jobBytes;
+
+    if(!created) {
+        _stats.rejected++;
+        reply.status = RenderJobStatus::Failed;
+        send_reply(client.fd, reply, -1);
+        release_job(job.id);
+    }
+}
+
+// The image and the memfd the frames land in. Whatever was created is released by release_job.
+bool RenderServer::create_job(Job& job) {
+    size_t totalBytes = job.frameBytes * job.frames;
+    job.memfd = memfd_create("vx render job", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(job.memfd < 0 || ftruncate(job.memfd, static_cast<off_t>(totalBytes)) != 0) {
+        std::cerr << "Render server: failed to create a " << totalBytes << " byte memfd: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // The client maps it at this size, so neither side may change it.
+    fcntl(job.memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+
+    void* mapping = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE, MAP_SHARED, job.memfd, 0);
+    if(mapping == MAP_FAILED) {
+        std::cerr << "Render server: failed to map the job memfd: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    job.mapping = static_cast<uint8_t*>(mapping);
+
+    VkDevice device = _renderer._device;
+    job.image.format = _renderer._drawImage.format;
+    job.image.extent = { job.extent.width, job.extent.height, 1 };
+
+    VkImageCreateInfo imageInfo = createImageCreateInfo(job.image.format, VK_IMAGE_USAGE_STORAGE_BIT, job.image.extent);
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VX_CHECK(vmaCreateImage(_renderer._allocator, &imageInfo, &allocInfo, &job.image.image, &job.image.allocation, nullptr), "vmaCreateImage");
+    _renderer._memoryTelemetry.track(job.image.allocation, AllocationCategory::RenderTarget, "render server job");
+
+    VkImageViewCreateInfo viewInfo = createImageViewCreateInfo(job.image.format, job.image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    VX_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &job.image.imageView), "vkCreateImageView");
+
+    VkDescriptorSetAllocateInfo setInfo = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    setInfo.descriptorPool = _descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &_imageLayout;
+    VX_CHECK(vkAllocateDescriptorSets(device, &setInfo, &job.descriptorSet), "vkAllocateDescriptorSets");
+
+    VkDescriptorImageInfo descriptorImageInfo = {};
+    descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    descriptorImageInfo.imageView = job.image.imageView;
+
+    VkWriteDescriptorSet write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding = 0;
+    write.dstSet = job.descriptorSet;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.descriptorCount = 1;
+    write.pImageInfo = &descriptorImageInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return true;
+}
+
+// The job's frames must not be in flight.
+void RenderServer::release_job(uint64_t id) {
+    auto found = _jobs.find(id);
+    if(found == _jobs.end()) {
+        return;
+    }
+    Job& job = found->second;
+
+    VkDevice device = _renderer._device;
+    if(job.descriptorSet != VK_NULL_HANDLE) {
+        vkFreeDescriptorSets(device, _descriptorPool, 1, &job.descriptorSet);
+    }
+    if(job.image.imageView != VK_NULL_HANDLE) {
+        vkDestroyImageView(device, job.image.imageView, nullptr);
+    }
+    if(job.image.image != VK_NULL_HANDLE) {
+        _renderer._memoryTelemetry.untrack(job.image.allocation);
+        vmaDestroyImage(_renderer._allocator, job.image.image, job.image.allocation);
+    }
+    if(job.mapping != nullptr) {
+        munmap(job.mapping, job.frameBytes * job.frames);
+    }
+    if(job.memfd >= 0) {
+        close(job.memfd);
+    }
+
+    _queuedBytes -= static_cast<uint64_t>(job.frameBytes) * job.frames;
+    _jobs.erase(found);
+    _order.erase(std::find(_order.begin(), _order.end(), id));
+}
+
+// Jobs still in flight are released as their frames retire; the rest right away.
+void RenderServer::disconnect(Client& client) {
+    std::vector<uint64_t> orphaned;
+    for(auto& [id, job] : _jobs) {
+        if(job.client == client.fd) {
+            job.client = -1;
+            if(job.inFlight == 0) {
+                orphaned.push_back(id);
+            }
+        }
+    }
+    for(uint64_t id : orphaned) {
+        release_job(id);
+    }
+    close(client.fd);
+}
+
+void RenderServer::send_reply(int fd, const RenderJobReply& reply, int memfd) {
+    iovec data = {};
+    data.iov_base = const_cast<RenderJobReply*>(&reply);
+    data.iov_len = sizeof(reply);
+
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    if(memfd >= 0) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &memfd, sizeof(int));
+    }
+
+    // The reply is far below the socket buffer, so a partial send only happens to a client that stopped
+    // reading; its poll reports the hang up.
+    if(sendmsg(fd, &message, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(reply))) {
+        std::cerr << "Render server: failed to reply to a client: " << std::strerror(errno) << std::endl;
+    }
+}
+
+// Takes frames round robin across the jobs, so a long job doesn't hold back short ones, until the batch
+// is full. A frame is the effect into the job's image followed by the convert into the staging buffer.
+bool RenderServer::record_batch(BatchSlot& slot) {
+    VX_TRACE_SCOPE("record batch");
+    VkDeviceSize used = 0;
+    bool full = false;
+    bool added = true;
+    while(added && !full) {
+        added = false;
+        for(uint64_t id : _order) {
+            Job& job = _jobs.at(id);
+            if(job.client < 0 || job.recorded == job.frames) {
+                continue;
+            }
+            VkDeviceSize offset = (used + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+            if((!slot.frames.empty() && offset + job.frameBytes > _options.batchBytes) || slot.frames.size() == _options.maxBatchFrames) {
+                full = true;
+                break;
+            }
+            slot.frames.push_back(BatchFrame{ id, job.recorded, offset });
+            job.recorded++;
+            job.inFlight++;
+            used = offset + job.frameBytes;
+            added = true;
+        }
+    }
+
+    if(slot.frames.empty()) {
+        return false;
+    }
+
+    // Only a frame larger than batchBytes gets here with a bigger batch. The slot's fence was waited.
+    if(used > slot.staging.info.size) {
+        destroyBuffer(_renderer._allocator, _renderer._memoryTelemetry, slot.staging);
+        slot.staging = createBuffer(_renderer._allocator, _renderer._memoryTelemetry, used, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_TO_CPU, AllocationCategory::Staging, "render server batch");
+    }
+
+    VX_CHECK(vkResetCommandBuffer(slot.commandBuffer, 0), "failed to reset render server command buffer");
+    VkCommandBufferBeginInfo beginInfo = beginCommandBufferInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VX_CHECK(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo), "failed to begin render server command buffer");
+
+    CommandRecorder cmd(slot.commandBuffer, _commandStats);
+    for(const BatchFrame& frame : slot.frames) {
+        const Job& job = _jobs.at(frame.job);
+        const ComputePipeline& effect = *job.effect;
+
+        // The effect overwrites the whole image. The transition also orders it after the previous
+        // frame's convert read the image.
+        cmd.transition_image(job.image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+        ComputePushConstants data = frameConstants(job, frame.frame);
+        cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipeline, effect.pipelineLayout);
+        cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipelineLayout, 0, 1, &job.descriptorSet);
+        cmd.push_constants(effect.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &data);
+        cmd.dispatch((job.extent.width + 15) / 16, (job.extent.height + 15) / 16, 1);
+
+        cmd.memory_barrier(
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+        ConvertPushConstants pushConstants = {};
+        pushConstants.frame = slot.staging.address + frame.offset;
+        pushConstants.size = glm::uvec2(job.extent.width, job.extent.height);
+        pushConstants.mode = CONVERT_MODE_RGBA8;
+        cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, _convertPipeline, _convertLayout);
+        cmd.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, _convertLayout, 0, 1, &job.descriptorSet);
+        cmd.push_constants(_convertLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ConvertPushConstants), &pushConstants);
+        cmd.dispatch((job.extent.width + 7) / 8, (job.extent.height + 7) / 8, 1);
+    }
+
+    // Make the converted frames visible to the host once the fence signals.
+    cmd.memory_barrier(
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_HOST_BIT,
+        VK_ACCESS_2_HOST_READ_BIT);
+
+    VX_CHECK(vkEndCommandBuffer(slot.commandBuffer), "failed to end render server command buffer");
+    return true;
+}
+
+// Waits for the slot's batch, copies its frames into the jobs' memfds and replies for finished jobs.
+void RenderServer::retire_batch(BatchSlot& slot) {
+    VkDevice device = _renderer._device;
+    {
+        VX_TRACE_SCOPE("batch wait");
+        VX_CHECK(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, DEFAULT_TIMEOUT_NS), "failed to wait for render server batch");
+    }
+    VX_CHECK(vkResetFences(device, 1, &slot.fence), "failed to reset render server fence");
+    slot.submitted = false;
+
+    VX_TRACE_SCOPE("deliver batch");
+    // GPU_TO_CPU memory may be cached but not coherent; the barrier alone doesn't reach the host's view.
+    vmaInvalidateAllocation(_renderer._allocator, slot.staging.allocation, 0, VK_WHOLE_SIZE);
+    const uint8_t* staging = static_cast<const uint8_t*>(slot.staging.info.pMappedData);
+    for(const BatchFrame& frame : slot.frames) {
+        Job& job = _jobs.at(frame.job);
+        job.inFlight--;
+        if(job.client < 0) {
+            if(job.inFlight == 0) {
+                release_job(frame.job);
+            }
+            continue;
+        }
+
+        std::memcpy(job.mapping + frame.frame * job.frameBytes, staging + frame.offset, job.frameBytes);
+        job.delivered++;
+        _stats.frames++;
+        if(job.delivered < job.frames) {
+            continue;
+        }
+
+        RenderJobReply reply;
+        reply.tag = job.tag;
+        reply.width = job.extent.width;
+        reply.height = job.extent.height;
+        reply.frames = job.frames;
+        reply.frameBytes = job.frameBytes;
+        send_reply(job.client, reply, job.memfd);
+        _stats.jobs++;
+        release_job(frame.job);
+    }
+    slot.frames.clear();
+}
+
+} // namespace
+
+int runRenderServer(VulkanRenderer& renderer, const RenderServerOptions& options) {
+    RenderServer server(renderer, options);
+    bool ready = server.init();
+    if(ready) {
+        server.run();
+    }
+    server.destroy();
+    return ready ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else
+
+int runRenderServer(VulkanRenderer& renderer, const RenderServerOptions& options) {
+    std::cerr << "The render server needs Linux: Unix domain sockets and memfd." << std::endl;
+    return EXIT_FAILURE;
+}
+
+#endif
+
+} // namespace VxEngine
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Headless render service for other processes. The server listens on a Unix domain socket and
+// renders background effect jobs:
+//  1. A client sends a RenderJobRequest: effect name, push constants, resolution and frame count.
+//     Requests may be pipelined on one connection; tag tells the replies apart.
+//  2. Frames of every queued job are interleaved into one command buffer per batch. The effect
+//     writes a per job image and the recorder's convert shader packs it to RGBA8 in a host visible
+//     staging buffer. LIVE_FRAMES batches are in flight, so the next batch is recorded while the GPU
+//     works on the previous one.
+//  3. Once a batch's fence has signalled its frames are copied into each job's memfd. When a job's
+//     last frame lands the server replies with a RenderJobReply and passes the memfd along with
+//     SCM_RIGHTS; the pixels never go through the socket.
+//
+// Linux only (memfd). Selected from the command line, see main.cpp:
+//   --serve <socket path>
+// Runs until SIGINT or SIGTERM.
+
+namespace VxEngine {
+
+class VulkanRenderer;
+
+constexpr uint32_t RENDER_SERVER_MAGIC = 0x53525856; // "VXRS"
+constexpr uint32_t RENDER_SERVER_VERSION = 1;
+
+// Wire format, native byte order, fixed size. Both sides are on the same machine.
+struct RenderJobRequest {
+    uint32_t magic = RENDER_SERVER_MAGIC;
+    uint32_t version = RENDER_SERVER_VERSION;
+    uint64_t tag = 0;      // Echoed in the reply.
+    char effect[32] = {};  // Background effect name, e.g. "gradient" or "sky". Zero terminated.
+    float data[16] = {};   // ComputePushConstants data1..data4 of the first frame.
+    float step[16] = {};   // Added to data for every further frame, to animate the effect.
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frames = 1;
+    uint32_t reserved = 0;
+};
+
+enum class RenderJobStatus : uint32_t {
+    Ok = 0,
+    BadRequest,    // Wrong magic or version, or a zero size.
+    UnknownEffect,
+    TooLarge,      // Beyond RenderServerOptions' limits.
+    Busy,          // Too many jobs or bytes queued, retry later.
+    Failed,        // Server side error, e.g. out of memory.
+};
+
+// Sent once per request. With RenderJobStatus::Ok the message carries a memfd holding frames
+// images of frameBytes each, back to back: tightly packed 8 bit RGBA rows, top row first.
+struct RenderJobReply {
+    uint32_t magic = RENDER_SERVER_MAGIC;
+    RenderJobStatus status = RenderJobStatus::Ok;
+    uint64_t tag = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frames = 0;
+    uint32_t reserved = 0;
+    uint64_t frameBytes = 0;
+};
+
+struct RenderServerOptions {
+    std::string socketPath;
+    uint32_t maxExtent = 4096;             // Largest width or height of a job.
+    uint32_t maxFrames = 1024;             // Per job.
+    uint32_t maxJobs = 64;                 // Queued or in flight at once, across clients.
+    uint64_t maxJobBytes = 1ull << 30;     // memfd size of a job, all its frames.
+    uint64_t maxQueuedBytes = 4ull << 30;  // memfd bytes of all queued or in flight jobs, across clients.
+    uint32_t maxBatchFrames = 64;          // Frames recorded into one command buffer.
+    uint64_t batchBytes = 64ull << 20;     // Staging per batch; a single larger frame gets a batch to itself.
+};
+
+// Serves until interrupted. Returns a process exit code.
+int runRenderServer(VulkanRenderer& renderer, const RenderServerOptions& options);
+
+} // namespace VxEngine
@@ -12,6 +12,11 @@
 #include <cmath>
 #include <optional>
 #include <chrono>
+#include <future>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <new>
 
 // 3rd party includes that for some reason dont work with the cmake build system.
 #define VMA_IMPLEMENTATION
@@ -26,38 +31,126 @@
 namespace VxEngine {
 
 constexpr bool USE_VALIDATION_LAYERS = true;
+constexpr uint32_t MAX_SCENE_OBJECTS = 4096;
+
+// Triangle pass state, baked into the pipelines or set while drawing, see PipelineCache.
+// Reverse-Z: nearer fragments have larger depth values.
+constexpr RasterState TRIANGLE_STATE = { .depthTest = VK_TRUE, .depthWrite = VK_TRUE, .depthCompare = VK_COMPARE_OP_GREATER_OR_EQUAL };
+// Color pass after a depth prepass: only the visible fragment of each pixel is shaded.
+constexpr RasterState TRIANGLE_EQUAL_STATE = { .depthTest = VK_TRUE, .depthWrite = VK_FALSE, .depthCompare = VK_COMPARE_OP_EQUAL };
 VulkanRenderer* renderer = nullptr;
 
 VulkanRenderer& VulkanRenderer::Get() {
     return *renderer;
 }
 
+// Events a frame responds to, timed for the latency readout.
+static bool isInputEvent(uint32_t type) {
+    switch(type) {
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_KEY_UP:
+        case SDL_EVENT_MOUSE_MOTION:
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_UP:
+        case SDL_EVENT_MOUSE_WHEEL:
+            return true;
+        default:
+            return false;
+    }
+}
+
 void VulkanRenderer::init() {
-    std::cout << "Initializing renderer" << std::endl;
+    Tracer::Get().set_thread_name("main");
+    if(!_tracePath.empty()) {
+        Tracer::Get().start(_tracePath);
+    }
+    _startupProfiler.begin();
+    VX_STARTUP_PHASE(_startupProfiler, "init total");
 
     assert(renderer == nullptr);
     renderer = this;
 
-    init_window();
-    std::cout << "Window initialized" << std::endl;
-    init_vulkan();
-    std::cout << "Vulkan initialized" << std::endl;
-    init_swapchain();
-    std::cout << "Swapchain initialized" << std::endl;
-    init_commands();
-    std::cout << "Commands initialized" << std::endl;
-    init_sync_structures();
-    std::cout << "Sync structures initialized" << std::endl;
-    init_descriptors();
-    std::cout << "Descriptors initialized" << std::endl;
-    init_pipelines();
-    std::cout << "Pipelines initialized" << std::endl;
-    init_imgui();
-    std::cout << "Imgui initialized" << std::endl;
+    // Window, device and swapchain creation are strictly ordered.
+    {
+        VX_STARTUP_PHASE(_startupProfiler, "window");
+        init_window();
+    }
+    {
+        VX_STARTUP_PHASE(_startupProfiler, "vulkan");
+        init_vulkan();
+    }
+    {
+        VX_STARTUP_PHASE(_startupProfiler, "swapchain");
+        init_swapchain();
+    }
+    {
+        VX_STARTUP_PHASE(_startupProfiler, "descriptors");
+        init_descriptors(); // Pipeline layouts reference the draw image descriptor layout.
+    }
+
+    // Everything below only depends on the device. Pipeline compilation is the slowest phase,
+    // so it runs on a worker while the main thread creates the command/sync objects and ImGui
+    // (which must stay on the main thread since the SDL backend touches the window). The worker
+    // pushes its cleanup into _pipelineDeletionManager, appended once it is done, so the teardown
+    // order is the same on every run instead of interleaving with the main thread's pushes.
+    std::future<void> pipelines = std::async(std::launch::async, [this]() {
+        VX_STARTUP_PHASE(_startupProfiler, "pipelines");
+        init_pipelines();
+    });
+
+    try {
+        {
+            VX_STARTUP_PHASE(_startupProfiler, "commands");
+            init_commands();
+        }
+        {
+            VX_STARTUP_PHASE(_startupProfiler, "sync structures");
+            init_sync_structures();
+        }
+        {
+            VX_STARTUP_PHASE(_startupProfiler, "imgui");
+            init_imgui();
+        }
+    } catch(...) {
+        pipelines.wait(); // Don't unwind while the worker still references the renderer.
+        _engineDeletionManager.append(_pipelineDeletionManager);
+        throw;
+    }
+
+    pipelines.wait();
+    _engineDeletionManager.append(_pipelineDeletionManager); // Also what a failed worker created.
+    pipelines.get(); // Rethrows any pipeline creation failure.
+
+    {
+        VX_STARTUP_PHASE(_startupProfiler, "scene");
+        init_scene(); // Uploads through immediate_submit, so it needs the command objects.
+    }
+
     print_vulkan_info();
 
+    // From here on the UI edits the main thread's copy, which reaches the renderer through frame packets.
+    _frameState.camera = _camera;
+    _frameState.computePipeline = _currentComputePipeline;
+    for(size_t i = 0; i < _computePipelines.size(); i++) { // At most MAX_BACKGROUND_EFFECTS, see add_background_effect.
+        _frameState.effectData[i] = _computePipelines[i].data;
+    }
+    _frameState.depthPrepass = _depthPrepass;
+    _frameState.occlusionCulling = _occlusionCulling;
+    _frameState.cpuCulling = _cpuCulling;
+    _frameState.cullDistance = _cullDistance;
+    _frameState.reuseCommandBuffers = _reuseCommandBuffers;
+    _frameState.asyncCompute = _asyncComputeEnabled;
+    _frameState.multiviewPreview = _multiviewPreview;
+    _frameState.multiviewLayout = _multiviewLayout;
+    _frameState.lightCount = _lightCount;
+    _frameState.particles = _particlesEnabled;
+    _frameState.particleRate = _particleEmitter.rate;
+    _frameState.presentMode = _presentMode;
+    _frameState.memoryWarningRatio = MemoryTelemetry::DEFAULT_WARNING_RATIO;
+
+    _frameArena.init(FRAME_ARENA_BYTES);
+
     _isInitialized = true;
-    std::cout << "Renderer initialized" << std::endl;
 }
 
 // Function to print Vulkan version information
@@ -68,16 +161,14 @@ void VulkanRenderer::print_vulkan_info() {
     uint32_t minor = VK_VERSION_MINOR(version);
     uint32_t patch = VK_VERSION_PATCH(version);
     
-    std::cout << "------- Vulkan Info -------" << std::endl;
-    std::cout << "Device: " << _deviceProperties.deviceName << std::endl;
-    std::cout << "Vulkan Version: " << major << "." << minor << "." << patch << std::endl;
-    std::cout << "Driver Version: " << _deviceProperties.driverVersion << std::endl;
-    std::cout << "--------------------------" << std::endl;
+    std::cout << "------- Vulkan Info -------\n"
+              << "Device: " << _deviceProperties.deviceName << "\n"
+              << "Vulkan Version: " << major << "." << minor << "." << patch << "\n"
+              << "Driver Version: " << _deviceProperties.driverVersion << "\n"
+              << "--------------------------" << std::endl;
 }
 
 void VulkanRenderer::init_window() {
-    std::cout << "Initializing SDL" << std::endl;
-
     if (SDL_Init(SDL_INIT_VIDEO) != true) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_Init Error: %s", SDL_GetError());
         throw std::runtime_error("Failed to initialize SDL");
@@ -88,11 +179,12 @@ void VulkanRenderer::init_window() {
         throw std::runtime_error("Failed to load Vulkan library");
     }
 
-    std::cout << "Vulkan library loaded" << std::endl;
-
     SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
-
-    std::cout << "Creating window" << std::endl;
+    if(_headless) {
+        window_flags |= SDL_WINDOW_HIDDEN; // The window only provides the surface the device is picked for.
+    } else {
+        window_flags |= SDL_WINDOW_RESIZABLE;
+    }
 
     _window = SDL_CreateWindow("Vulkan Test", _windowExtent.width, _windowExtent.height, window_flags);
 
@@ -101,7 +193,23 @@ void VulkanRenderer::init_window() {
         throw std::runtime_error("Failed to create window");
     }
 
-    std::cout << "Window created successfully" << std::endl;
+    int pixelWidth = 0;
+    int pixelHeight = 0;
+    SDL_GetWindowSizeInPixels(_window, &pixelWidth, &pixelHeight);
+    _windowExtent = { static_cast<uint32_t>(pixelWidth), static_cast<uint32_t>(pixelHeight) };
+
+    // The draw image is sized for the largest display, so resizing or maximizing never reallocates it.
+    // Headless frames keep the window's size.
+    _maxDrawExtent = _windowExtent;
+    int displayCount = 0;
+    SDL_DisplayID* displays = _headless ? nullptr : SDL_GetDisplays(&displayCount);
+    for(int i = 0; i < displayCount; i++) {
+        if(const SDL_DisplayMode* mode = SDL_GetDesktopDisplayMode(displays[i])) {
+            _maxDrawExtent.width = std::max(_maxDrawExtent.width, static_cast<uint32_t>(mode->w * mode->pixel_density));
+            _maxDrawExtent.height = std::max(_maxDrawExtent.height, static_cast<uint32_t>(mode->h * mode->pixel_density));
+        }
+    }
+    SDL_free(displays);
 }
 
 void VulkanRenderer::init_vulkan() {
@@ -131,27 +239,91 @@ void VulkanRenderer::init_vulkan() {
     features13.dynamicRendering = VK_TRUE;
     features13.synchronization2 = VK_TRUE;
 
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.multiview = VK_TRUE; // Layered multiview pass.
+
     VkPhysicalDeviceVulkan12Features features12{};
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.bufferDeviceAddress = VK_TRUE;
     features12.descriptorIndexing = VK_TRUE;
+    features12.drawIndirectCount = VK_TRUE; // GPU written draw counts from the occlusion culler.
+    features12.timelineSemaphore = VK_TRUE; // Orders the graphics and async compute queues.
+
+    VkPhysicalDeviceFeatures features{};
+    features.drawIndirectFirstInstance = VK_TRUE; // The object index is passed as firstInstance.
     
     vkb::PhysicalDeviceSelector selector(vkbInstance);
     vkb::PhysicalDevice physical_device = selector
         .set_minimum_version(VK_VERSION_MAJOR_MIN, VK_VERSION_MINOR_MIN)
         .set_required_features_13(features13)
         .set_required_features_12(features12)
+        .set_required_features_11(features11)
+        .set_required_features(features)
         .set_surface(_surface)
         .select()
         .value();
 
+    // Lets VMA report real per-heap budgets instead of estimating them from heap sizes.
+    bool memoryBudgetEnabled = physical_device.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Present ids and waits time when frames reach the display. Optional, the latency readout
+    // falls back to CPU side timestamps without them.
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+    bool presentWaitEnabled = !_headless &&
+        physical_device.enable_extensions_if_present({ VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME });
+    if(presentWaitEnabled) {
+        presentWaitFeatures.pNext = &presentIdFeatures;
+        VkPhysicalDeviceFeatures2 supported = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &presentWaitFeatures };
+        vkGetPhysicalDeviceFeatures2(physical_device.physical_device, &supported);
+        presentWaitEnabled = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        presentWaitFeatures.pNext = nullptr; // vk-bootstrap links the chain itself.
+    }
+
+    // Blend enable as dynamic state, on top of the extended dynamic state that is core in 1.3.
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT };
+    bool blendEnableDynamic = physical_device.enable_extension_if_present(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+    if(blendEnableDynamic) {
+        VkPhysicalDeviceFeatures2 supported = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &dynamicState3Features };
+        vkGetPhysicalDeviceFeatures2(physical_device.physical_device, &supported);
+        blendEnableDynamic = dynamicState3Features.extendedDynamicState3ColorBlendEnable;
+        dynamicState3Features = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT };
+        dynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE; // Only what we use.
+    }
+    _dynamicState = CORE_DYNAMIC_STATE | (blendEnableDynamic ? DYNAMIC_STATE_BLEND_ENABLE : 0);
+
+    // Places GPU timestamps on the CPU timeline in trace captures.
+    bool calibratedTimestamps = physical_device.enable_extension_if_present(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) &&
+        GpuProfiler::calibration_supported(_instance, physical_device.physical_device);
+
     vkb::DeviceBuilder device_builder(physical_device);
+    if(presentWaitEnabled) {
+        device_builder.add_pNext(&presentIdFeatures);
+        device_builder.add_pNext(&presentWaitFeatures);
+    }
+    if(blendEnableDynamic) {
+        device_builder.add_pNext(&dynamicState3Features);
+    }
     vkb::Device vkbDevice = device_builder.build().value();
     _device = vkbDevice.device;
     _physicalDevice = physical_device.physical_device;
 
     _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     _graphicsQueueFamilyIndex = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+
+    // A compute family apart from graphics, preferably one without transfer support either.
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t computeQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    auto computeIndex = vkbDevice.get_dedicated_queue_index(vkb::QueueType::compute);
+    if(!computeIndex.has_value()) {
+        computeIndex = vkbDevice.get_queue_index(vkb::QueueType::compute);
+    }
+    if(computeIndex.has_value()) {
+        computeQueueFamily = computeIndex.value();
+        vkGetDeviceQueue(_device, computeQueueFamily, 0, &computeQueue);
+    }
+    std::cout << "Async compute: " << (computeQueue != VK_NULL_HANDLE ? "queue family " + std::to_string(computeQueueFamily) : "unavailable") << std::endl;
     
     // Get the physical device properties after selecting the device
     vkGetPhysicalDeviceProperties(_physicalDevice, &_deviceProperties);
@@ -163,33 +335,98 @@ void VulkanRenderer::init_vulkan() {
     allocatorInfo.instance = _instance;
     allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
     allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    allocatorInfo.pAllocationCallbacks = AllocationTracker::vulkan_callbacks(); // VMA's host allocations get counted too.
+    if(memoryBudgetEnabled) {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     VX_CHECK(vmaCreateAllocator(&allocatorInfo, &_allocator), "vmaCreateAllocator");
+    _memoryTelemetry.init(_allocator, memoryBudgetEnabled);
+    _gpuProfiler.init(_device, _physicalDevice, _graphicsQueueFamilyIndex, "gpu graphics", calibratedTimestamps);
+    _readback.init(_device, _allocator, _memoryTelemetry);
+    _latencyTracker.init(_device, presentWaitEnabled);
+    _asyncCompute.init(_device, computeQueue, computeQueueFamily, _graphicsQueueFamilyIndex);
+    if(_asyncCompute.available()) {
+        _computeProfiler.init(_device, _physicalDevice, _asyncCompute.queue_family(), "gpu compute", calibratedTimestamps);
+    }
 
     _engineDeletionManager.push_function([this]() {
+        _latencyTracker.destroy(); // Before the swapchain its waiter blocks on goes away.
+        _computeProfiler.destroy();
+        _asyncCompute.destroy();
+        _readback.destroy();
+        _gpuProfiler.destroy();
         vmaDestroyAllocator(_allocator);
     });
 }
 
-void VulkanRenderer::create_swapchain(/*uint32_t width, uint32_t height*/) {
+void VulkanRenderer::create_swapchain(VkSwapchainKHR oldSwapchain) {
     vkb::SwapchainBuilder swapchainBuilder(_physicalDevice, _device, _surface);
 
     _swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
 
+    // The requested present mode and image count fall back to what the surface supports.
+    uint32_t presentModeCount = 0;
+    VX_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(_physicalDevice, _surface, &presentModeCount, nullptr), "vkGetPhysicalDeviceSurfacePresentModesKHR");
+    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    VX_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(_physicalDevice, _surface, &presentModeCount, presentModes.data()), "vkGetPhysicalDeviceSurfacePresentModesKHR");
+
+    VkSurfaceCapabilitiesKHR capabilities;
+    VX_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_physicalDevice, _surface, &capabilities), "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+
+    _swapchainPresentMode = choosePresentMode(_presentMode, presentModes);
+    if(_swapchainPresentMode != _presentMode) {
+        std::cout << "Present mode " << presentModeName(_presentMode) << " unsupported, using " << presentModeName(_swapchainPresentMode) << std::endl;
+    }
+    _swapchainMinImageCount = std::max(capabilities.minImageCount, 2u); // ImGui requires at least two.
+
     vkb::Swapchain vkbSwapchain = swapchainBuilder
         .use_default_format_selection()
         .set_desired_format(VkSurfaceFormatKHR{ .format = _swapchainImageFormat, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
-        .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+        .set_desired_present_mode(_swapchainPresentMode)
+        .set_desired_min_image_count(chooseSwapchainImageCount(_requestedImageCount, capabilities))
         .set_desired_extent(_windowExtent.width, _windowExtent.height)
-        .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+        .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT) // Source for readback.
+        .set_old_swapchain(oldSwapchain) // Lets the driver hand resources over and keep presenting the old images.
         .build()
         .value();
 
         _swapchainExtent = vkbSwapchain.extent;
-        _drawExtent = _swapchainExtent;
+        _drawExtent = {
+            std::min(_swapchainExtent.width, _maxDrawExtent.width),
+            std::min(_swapchainExtent.height, _maxDrawExtent.height) };
         _swapchain = vkbSwapchain.swapchain;
         _swapchainImages = vkbSwapchain.get_images().value();
         _swapchainImageViews = vkbSwapchain.get_image_views().value();
+        _latencyTracker.set_swapchain(_swapchain);
+}
+
+// Swaps in a swapchain for the current window extent and present mode while frames are still in flight.
+// The old swapchain keeps presenting until the driver retires it; it and its views go through the current
+// slot's deletion queue, which runs after this slot's next fence, by which time every frame that could have
+// used them has completed. Nothing waits for the device to go idle.
+void VulkanRenderer::recreate_swapchain() {
+    VkSwapchainKHR oldSwapchain = _swapchain;
+    std::vector<VkImageView> oldImageViews = std::move(_swapchainImageViews);
+    _swapchainImageViews.clear();
+
+    create_swapchain(oldSwapchain);
+
+    get_current_frame_data()._deletionManager.push_function([this, oldSwapchain, oldImageViews]() {
+        for(VkImageView view : oldImageViews) {
+            vkDestroyImageView(_device, view, nullptr);
+        }
+        vkDestroySwapchainKHR(_device, oldSwapchain, nullptr);
+    });
+
+    // Cached passes reference the old images and extents, and the released handles may be reused.
+    _commandCache.invalidate();
+    _backgroundCache.invalidate();
+
+    // ImGui's MinImageCount only matters for its own platform windows, and changing it waits for the
+    // device to go idle, so it keeps the value it was initialized with.
+    _swapchainDirty = false;
+    _swapchainRecreations++;
 }
 
 void VulkanRenderer::destroy_swapchain() {
@@ -205,7 +442,7 @@ void VulkanRenderer::destroy_swapchain() {
 }
 
 void VulkanRenderer::create_draw_image() {
-    VkExtent3D extent = {_drawExtent.width, _drawExtent.height, 1}; // 3D extent with 1 depth.
+    VkExtent3D extent = {_maxDrawExtent.width, _maxDrawExtent.height, 1}; // 3D extent with 1 depth.
 
     _drawImage.format = VK_FORMAT_R16G16B16A16_SFLOAT; // High precision float format.
     _drawImage.extent = extent; // Assign our extent to the image. The drawImage has a 3d extent, while the swapchain has a 2d extent.
@@ -224,11 +461,13 @@ void VulkanRenderer::create_draw_image() {
 
     // allocate and create the image.
     VX_CHECK(vmaCreateImage(_allocator, &image_info, &allocInfo, &_drawImage.image, &_drawImage.allocation, nullptr), "vmaCreateImage");
+    _memoryTelemetry.track(_drawImage.allocation, AllocationCategory::RenderTarget, "draw image");
 
     VkImageViewCreateInfo view_info = createImageViewCreateInfo(_drawImage.format, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
     VX_CHECK(vkCreateImageView(_device, &view_info, nullptr, &_drawImage.imageView), "vkCreateImageView");
 
     _engineDeletionManager.push_function([this]() {
+        _memoryTelemetry.untrack(_drawImage.allocation);
         vmaDestroyImage(_allocator, _drawImage.image, _drawImage.allocation);
         vkDestroyImageView(_device, _drawImage.imageView, nullptr);
     });
@@ -236,9 +475,13 @@ void VulkanRenderer::create_draw_image() {
 
 void VulkanRenderer::init_swapchain() {
     create_swapchain();
-    std::cout << "Swapchain created" << std::endl;
     create_draw_image();
-    std::cout << "Draw image created" << std::endl;
+
+    // Per-frame render targets (depth, post-process intermediates) come from the transient pool.
+    _transientPool.init(_device, _allocator, &_memoryTelemetry);
+    _engineDeletionManager.push_function([this]() {
+        _transientPool.destroy();
+    });
 }
 
 // TODO: Understand this better.
@@ -278,7 +521,10 @@ void VulkanRenderer::init_commands() {
         // vkFreeCommandBuffers(_device, _immCommandPool, 1, &_immCommandBuffer);
     });
 
-    std::cout << "Initialized command structures" << std::endl;
+    _commandCache.init(_device, _graphicsQueueFamilyIndex);
+    _engineDeletionManager.push_function([this]() {
+        _commandCache.destroy();
+    });
 }
 
 // Init per frame synchronization structures.
@@ -340,8 +586,49 @@ void VulkanRenderer::init_descriptors() {
 }
 
 void VulkanRenderer::init_pipelines() {
+    // First in, so it is destroyed after every pass that draws with its pipelines.
+    _pipelineCache.init(_device, _dynamicState);
+    _pipelineDeletionManager.push_function([this]() {
+        _pipelineCache.destroy();
+    });
+
     init_background_pipelines();
     init_triangle_pipeline();
+
+    _occlusionCuller.init(_device, _allocator, _memoryTelemetry, MAX_SCENE_OBJECTS);
+    _pipelineDeletionManager.push_function([this]() {
+        _occlusionCuller.destroy();
+    });
+
+    _cpuCuller.init();
+    _pipelineDeletionManager.push_function([this]() {
+        _cpuCuller.destroy();
+    });
+
+    // The host written light buffers are read by culling on the compute family and shading on graphics.
+    std::vector<uint32_t> lightingFamilies = { _graphicsQueueFamilyIndex };
+    if(_asyncCompute.queue_family() != _graphicsQueueFamilyIndex) {
+        lightingFamilies.push_back(_asyncCompute.queue_family());
+    }
+    _clusteredLighting.init(_device, _allocator, _memoryTelemetry, lightingFamilies);
+    _pipelineDeletionManager.push_function([this]() {
+        _clusteredLighting.destroy();
+    });
+
+    _frameRecorder.init(_device, _allocator, _memoryTelemetry, _descriptorManager.drawImageDescriptorLayout);
+    _pipelineDeletionManager.push_function([this]() {
+        _frameRecorder.destroy();
+    });
+
+    _multiview.init(_device, _allocator, _memoryTelemetry, _pipelineCache, _drawImage.format, _depthFormat);
+    _pipelineDeletionManager.push_function([this]() {
+        _multiview.destroy();
+    });
+
+    _particles.init(_device, _allocator, _memoryTelemetry, _pipelineCache, MAX_PARTICLES, _drawImage.format, _depthFormat);
+    _pipelineDeletionManager.push_function([this]() {
+        _particles.destroy();
+    });
 }
 
 // Background compute pipeline.
@@ -366,29 +653,9 @@ void VulkanRenderer::init_background_pipelines() {
     // _backgroundComputePipelineLayout is currently a general layout for computes with a single push constant.
     VX_CHECK(vkCreatePipelineLayout(_device, &computeLayoutInfo, nullptr, &_backgroundComputePipelineLayout), "Compute pipeline layout creation failed.");
 
-    VkShaderModule gradientShaderModule;
     // Need to use relative to exe
-    if(!load_shader_module("src/renderer/shaders/color_gradient.comp.spv", _device, &gradientShaderModule)) { // Load the compute shader module.
-        throw std::runtime_error("Failed to load compute shader module");
-    }
-
-    VkShaderModule skyShaderModule;
-    if(!load_shader_module("src/renderer/shaders/sky.comp.spv", _device, &skyShaderModule)) { // Load the compute shader module.
-        throw std::runtime_error("Failed to load compute shader module");
-    }
-
-    VkPipelineShaderStageCreateInfo computeShaderStageInfo = {};
-    computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    computeShaderStageInfo.pNext = nullptr;
-    computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    computeShaderStageInfo.module = gradientShaderModule;
-    computeShaderStageInfo.pName = "main";
-
-    VkComputePipelineCreateInfo computePipelineInfo = {};
-    computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    computePipelineInfo.pNext = nullptr;
-    computePipelineInfo.stage = computeShaderStageInfo;
-    computePipelineInfo.layout = _backgroundComputePipelineLayout;
+    VkShaderModule gradientShaderModule = _pipelineCache.shader("src/renderer/shaders/color_gradient.comp.spv");
+    VkShaderModule skyShaderModule = _pipelineCache.shader("src/renderer/shaders/sky.comp.spv");
 
     ComputePipeline gradientPipeline;
     gradientPipeline.name = "gradient";
@@ -396,47 +663,49 @@ void VulkanRenderer::init_background_pipelines() {
     gradientPipeline.data.data1 = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f); // R
     gradientPipeline.data.data2 = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // B
 
-    VX_CHECK(vkCreateComputePipelines(_device, nullptr, 1, &computePipelineInfo, nullptr, &gradientPipeline.pipeline), "Compute pipeline creation failed.");
+    gradientPipeline.pipeline = _pipelineCache.compute(gradientShaderModule, _backgroundComputePipelineLayout);
 
     ComputePipeline skyPipeline;
     skyPipeline.name = "sky";
     skyPipeline.pipelineLayout = _backgroundComputePipelineLayout; // Use general layout for now.
     skyPipeline.data.data1 = glm::vec4(0.1f, 0.2f, 0.4f, 0.97f);
 
-    VX_CHECK(vkCreateComputePipelines(_device, nullptr, 1, &computePipelineInfo, nullptr, &skyPipeline.pipeline), "Compute pipeline creation failed.");
+    skyPipeline.pipeline = _pipelineCache.compute(skyShaderModule, _backgroundComputePipelineLayout);
 
-    vkDestroyShaderModule(_device, gradientShaderModule, nullptr);
-    vkDestroyShaderModule(_device, skyShaderModule, nullptr);
+    add_background_effect(gradientPipeline);
+    add_background_effect(skyPipeline);
 
-    _computePipelines.push_back(gradientPipeline);
-    _computePipelines.push_back(skyPipeline);
+    _backgroundCache.init(_device, _allocator, _memoryTelemetry, _descriptorManager, _descriptorManager.drawImageDescriptorLayout,
+        _drawImage.format, _drawImage.extent);
 
-    _engineDeletionManager.push_function([this]() {
-        vkDestroyPipelineLayout(_device, _backgroundComputePipelineLayout, nullptr);
-
-        for(auto& pipeline : _computePipelines) { // Destroy the compute pipelines :)
-            vkDestroyPipeline(_device, pipeline.pipeline, nullptr);
-        }
+    _pipelineDeletionManager.push_function([this]() {
+        vkDestroyPipelineLayout(_device, _backgroundComputePipelineLayout, nullptr); // The pipelines belong to _pipelineCache.
+        _backgroundCache.destroy();
     });
 }
 
-void VulkanRenderer::init_triangle_pipeline() {
-    VkShaderModule triangleFragShader;
-    if(!load_shader_module("src/renderer/shaders/colored_triangle.frag.spv", _device, &triangleFragShader)) {
-        std::cout << "Failed to load triangle fragment shader" << std::endl;
-    } else {
-        std::cout << "Loaded triangle fragment shader" << std::endl;
+// FrameState carries a fixed array of per effect data, so effects past it can't be edited or selected.
+void VulkanRenderer::add_background_effect(const ComputePipeline& effect) {
+    if(_computePipelines.size() >= FrameState::MAX_BACKGROUND_EFFECTS) {
+        std::cerr << "Background effect " << effect.name << " skipped, FrameState holds " << FrameState::MAX_BACKGROUND_EFFECTS << " effects." << std::endl;
+        return;
     }
+    _computePipelines.push_back(effect);
+}
 
-    VkShaderModule triangleVertShader;
-    if(!load_shader_module("src/renderer/shaders/colored_triangle.vert.spv", _device, &triangleVertShader)) {
-        std::cout << "Failed to load triangle vertex shader" << std::endl;
-    } else {
-        std::cout << "Loaded triangle vertex shader" << std::endl;
-    }
+void VulkanRenderer::init_triangle_pipeline() {
+    VkShaderModule triangleFragShader = _pipelineCache.shader("src/renderer/shaders/colored_triangle.frag.spv");
+    VkShaderModule triangleVertShader = _pipelineCache.shader("src/renderer/shaders/colored_triangle.vert.spv");
     
-    // Create empty layout as this shader takes no inputs.
+    // View projection, the object buffer and the cluster parameters for the fragment stage.
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(GeometryPushConstants);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = pipelineLayoutCreateInfo();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     VX_CHECK(vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_trianglePipelineLayout), "Failed to create triangle pipeline layout");
 
     PipelineBuilder pipelineBuilder;
@@ -445,27 +714,98 @@ void VulkanRenderer::init_triangle_pipeline() {
     pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, triangleVertShader, "main");
     pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT, triangleFragShader, "main");
 
-    pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    
     pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
-
-    pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
     pipelineBuilder.set_multisampling_none();
-    pipelineBuilder.disable_blending();
-    pipelineBuilder.disable_depth_test();
 
     pipelineBuilder.set_color_attachment_format(_drawImage.format);
-    pipelineBuilder.set_depth_format(VK_FORMAT_UNDEFINED);
+    pipelineBuilder.set_depth_format(_depthFormat);
+
+    pipelineBuilder.set_raster_state(TRIANGLE_STATE);
+    _trianglePipeline = _pipelineCache.graphics(pipelineBuilder);
+
+    pipelineBuilder.set_raster_state(TRIANGLE_EQUAL_STATE);
+    _triangleEqualPipeline = _pipelineCache.graphics(pipelineBuilder);
+
+    // Depth prepass: vertex stage only, no color output.
+    pipelineBuilder.clear_stages();
+    pipelineBuilder.add_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, triangleVertShader, "main");
+    pipelineBuilder.disable_color_attachment();
+    pipelineBuilder.set_raster_state(TRIANGLE_STATE);
+    _triangleDepthPipeline = _pipelineCache.graphics(pipelineBuilder);
+
+    _pipelineDeletionManager.push_function([this]() {
+        vkDestroyPipelineLayout(_device, _trianglePipelineLayout, nullptr); // The pipelines belong to _pipelineCache.
+    });
+}
+
+// Test scene: a large occluder close to the camera with a grid of small triangles behind it,
+// most of which should be rejected by the occlusion culler.
+void VulkanRenderer::init_scene() {
+    const glm::vec3 triangleVertices[3] = {
+        glm::vec3(1.0f, 1.0f, 0.0f),
+        glm::vec3(-1.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f)
+    };
+
+    auto addObject = [&](const glm::mat4& model) {
+        GPUObjectData object = {};
+        object.model = model;
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        for(const glm::vec3& vertex : triangleVertices) {
+            glm::vec3 world = glm::vec3(model * glm::vec4(vertex, 1.0f));
+            boundsMin = glm::min(boundsMin, world);
+            boundsMax = glm::max(boundsMax, world);
+        }
+        object.aabbMin = glm::vec4(boundsMin, 1.0f);
+        object.aabbMax = glm::vec4(boundsMax, 1.0f);
+        _sceneObjects.push_back(object);
+    };
+
+    addObject(glm::scale(glm::mat4(1.0f), glm::vec3(1.5f)));
+
+    constexpr int GRID_SIZE = 32;
+    for(int y = 0; y < GRID_SIZE; y++) {
+        for(int x = 0; x < GRID_SIZE; x++) {
+            glm::vec3 position(
+                (x - GRID_SIZE / 2) * 0.25f,
+                (y - GRID_SIZE / 2) * 0.25f,
+                -2.0f - static_cast<float>((x + y) % 4));
+            addObject(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.1f)));
+        }
+    }
 
-    _trianglePipeline = pipelineBuilder.build_pipeline(_device);
+    size_t size = _sceneObjects.size() * sizeof(GPUObjectData);
+    _sceneObjectBuffer = createBuffer(_allocator, _memoryTelemetry, size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "scene objects");
 
-    vkDestroyShaderModule(_device, triangleFragShader, nullptr);
-    vkDestroyShaderModule(_device, triangleVertShader, nullptr);
+    AllocatedBuffer staging = createBuffer(_allocator, _memoryTelemetry, size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, AllocationCategory::Staging, "scene staging");
+    memcpy(staging.info.pMappedData, _sceneObjects.data(), size);
+
+    immediate_submit([&](VkCommandBuffer cmd) {
+        VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = size };
+        vkCmdCopyBuffer(cmd, staging.buffer, _sceneObjectBuffer.buffer, 1, &region);
+    });
+    destroyBuffer(_allocator, _memoryTelemetry, staging);
 
     _engineDeletionManager.push_function([this]() {
-        vkDestroyPipelineLayout(_device, _trianglePipelineLayout, nullptr);
-        vkDestroyPipeline(_device, _trianglePipeline, nullptr);
+        destroyBuffer(_allocator, _memoryTelemetry, _sceneObjectBuffer);
     });
+
+    _cpuCuller.set_objects(_sceneObjects);
+
+    set_test_lights(static_cast<uint32_t>(_lightCount));
+}
+
+std::future<ReadbackResult> VulkanRenderer::capture(ReadbackTarget target, ImageFileFormat fileFormat, std::string path) {
+    return _readback.request(target, fileFormat, std::move(path));
+}
+
+void VulkanRenderer::set_test_lights(uint32_t count) {
+    // Spread over the scene's volume, see init_scene.
+    std::vector<GPULight> lights = makeRandomLights(count, glm::vec3(-4.5f, -4.5f, -6.0f), glm::vec3(4.5f, 4.5f, 1.0f), 1.5f, 1337);
+    _clusteredLighting.set_lights(lights);
 }
 
 void VulkanRenderer::init_imgui() {
@@ -493,6 +833,11 @@ void VulkanRenderer::init_imgui() {
     
         // 2: initialize imgui library
     
+        // ImGui allocates through malloc by default, which the allocation tracker doesn't see.
+        ImGui::SetAllocatorFunctions(
+            [](size_t size, void*) { return ::operator new(size, std::nothrow); },
+            [](void* memory, void*) { ::operator delete(memory); });
+
         // this initializes the core structures of imgui
         ImGui::CreateContext();
     
@@ -506,8 +851,8 @@ void VulkanRenderer::init_imgui() {
         init_info.Device = _device;
         init_info.Queue = _graphicsQueue;
         init_info.DescriptorPool = imguiPool;
-        init_info.MinImageCount = 3;
-        init_info.ImageCount = 3;
+        init_info.MinImageCount = _swapchainMinImageCount;
+        init_info.ImageCount = static_cast<uint32_t>(_swapchainImages.size());
         init_info.UseDynamicRendering = true;
     
         //dynamic rendering parameters for imgui to use
@@ -519,6 +864,10 @@ void VulkanRenderer::init_imgui() {
         init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     
         ImGui_ImplVulkan_Init(&init_info);
+
+        // Rasterize the font atlas now, while the pipelines are still compiling on the worker,
+        // instead of paying for it on the first frame.
+        ImGui::GetIO().Fonts->Build();
         
         // add the destroy the imgui created structures
         _engineDeletionManager.push_function([=, this]() {
@@ -528,7 +877,7 @@ void VulkanRenderer::init_imgui() {
 }
 
 // Immediately submit command buffer without synchornization to the swapchain.
-void VulkanRenderer::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function) {
+void VulkanRenderer::immediate_submit(FunctionRef<void(VkCommandBuffer cmd)> function) {
     VX_CHECK(vkResetFences(_device, 1, &_immFence), "failed to reset imgui fence");
     VX_CHECK(vkResetCommandBuffer(_immCommandBuffer, 0), "failed to reset imgui command buffer");
 
@@ -563,11 +912,14 @@ void VulkanRenderer::cleanup_vk_objects() {
 }
 
 void VulkanRenderer::cleanup() {
+    Tracer::Get().stop(); // Writes a capture still running, from --trace or the UI.
+
     if(_isInitialized) {
         vkDeviceWaitIdle(_device);
         
         destroy_frame_data();
         cleanup_vk_objects();
+        _frameArena.destroy();
         destroy_swapchain();
 
         vkDestroySurfaceKHR(_instance, _surface, nullptr);
@@ -590,126 +942,393 @@ void VulkanRenderer::cleanup() {
     renderer = nullptr;
 }
 
-void VulkanRenderer::draw() {
+// Render thread half of a frame, see build_frame for the main thread half.
+void VulkanRenderer::draw(FramePacket& packet) {
+    VX_TRACE_SCOPE("draw");
     // std::cout << "Drawing frame " << _frameNumber << std::endl;
-    if(_windowMinimized) { // Limit FPS when window is minimized.
-        std::this_thread::sleep_for(std::chrono::milliseconds(UNFOCUSED_FPS_LIMIT_MS));
-    }
+    FrameTimestamps timestamps;
+    timestamps.frameStart = LatencyClock::now();
+    timestamps.hasInput = packet.hasInput;
+    timestamps.input = packet.inputTime;
 
     // Check the "current frame" (at start of loop, this would be the frame from the previous draw call)
     // Wait for the fence, then reset it.
-    VX_CHECK(vkWaitForFences(_device, 1, &get_current_frame_data()._inFlightFence, VK_TRUE, DEFAULT_TIMEOUT_NS), "vkWaitForFences");
-    // After the frame is done, we can reset the fence and delete the frames objects.
+    {
+        VX_TRACE_SCOPE("fence wait");
+        VX_CHECK(vkWaitForFences(_device, 1, &get_current_frame_data()._inFlightFence, VK_TRUE, DEFAULT_TIMEOUT_NS), "vkWaitForFences");
+    }
+
+    std::unique_lock<std::mutex> stateLock(_stateMutex);
+    _frameArena.reset(); // Nothing from the last draw() is still referenced.
+
+    // After the frame is done, we can reset the fence and delete the frames objects. This has to come
+    // before a recreation, which retires the old swapchain into the same queue.
     get_current_frame_data().cleanup();
 
+    apply_frame_state(packet.state);
+
+    if(!_headless) {
+        if(packet.windowExtent.width == 0 || packet.windowExtent.height == 0) {
+            return; // Minimized to nothing, there is no swapchain extent to draw at.
+        }
+        if(packet.windowExtent.width != _windowExtent.width || packet.windowExtent.height != _windowExtent.height) {
+            _windowExtent = packet.windowExtent;
+            _swapchainDirty = true;
+        }
+        if(_swapchainDirty) {
+            VX_TRACE_SCOPE("recreate swapchain");
+            recreate_swapchain();
+        }
+    }
+    stateLock.unlock(); // Acquire may block.
+
+    uint32_t swapchainImageIndex = 0;
+    if(!_headless) {
+        VX_TRACE_SCOPE("acquire");
+        VkResult acquireResult = vkAcquireNextImageKHR(_device, _swapchain, DEFAULT_TIMEOUT_NS, get_current_frame_data()._swapchainSem, nullptr, &swapchainImageIndex);
+        if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Nothing was acquired and the semaphore stays unsignaled; the next frame recreates first.
+            _swapchainDirty = true;
+            return;
+        }
+        if(acquireResult == VK_SUBOPTIMAL_KHR) {
+            _swapchainDirty = true; // The image is still usable, this frame goes ahead.
+        } else {
+            VX_CHECK(acquireResult, "vkAcquireNextImageKHR");
+        }
+    }
+
+    // The GPU waits are behind us. From here until submission the render thread updates state the UI reads.
+    stateLock.lock();
+    auto frameStart = std::chrono::high_resolution_clock::now();
+    _renderFrameMs = std::chrono::duration<float, std::milli>(frameStart - _lastRenderFrame).count();
+    _lastRenderFrame = frameStart;
+
+    _memoryTelemetry.update();
+
     // Reset the fence for the current frame.
     VX_CHECK(vkResetFences(_device, 1, &get_current_frame_data()._inFlightFence), "vkResetFences");
 
-    uint32_t swapchainImageIndex;
-    VX_CHECK(vkAcquireNextImageKHR(_device, _swapchain, DEFAULT_TIMEOUT_NS, get_current_frame_data()._swapchainSem, nullptr, &swapchainImageIndex), "vkAcquireNextImageKHR");
+    // Passes request their transient targets before recording starts.
+    _transientPool.begin_frame(_frameNumber);
+    TransientImageHandle depthHandle = _transientPool.request(TransientImageDesc{
+        .format = _depthFormat,
+        .extent = { _drawExtent.width, _drawExtent.height, 1 },
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // Sampled by the Hi-Z build.
+        .aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .firstPass = PASS_DEPTH_PREPASS,
+        .lastPass = PASS_PARTICLES,
+        .name = "depth" });
+    if(_multiviewPreview) {
+        _multiview.request_targets(_transientPool, PASS_MULTIVIEW);
+    }
+    _transientPool.realize(get_current_frame_data()._deletionManager, _frameArena);
+    _depthImage = _transientPool.get(depthHandle);
+    if(_multiviewPreview) {
+        _multiview.acquire_targets(_transientPool);
+    }
+
+    uint32_t frameIndex = _frameNumber % LIVE_FRAMES;
+    _occlusionCuller.begin_frame(frameIndex, _drawExtent, get_current_frame_data()._deletionManager);
+    _clusteredLighting.begin_frame(frameIndex, _camera, _drawExtent);
+    _particles.begin_frame(frameIndex);
+    _readback.begin_frame(frameIndex, _frameNumber); // Copies from this slot's last frame have landed.
+    _frameRecorder.begin_frame(frameIndex);
+    _commandStats = {};
+
+    // The background effect and light culling don't depend on this frame's graphics work. With async
+    // compute they are submitted first on the compute queue and overlap the previous frame's graphics.
+    const ComputePipeline& backgroundEffect = _computePipelines[_currentComputePipeline];
+    bool evaluateBackground = _backgroundCache.prepare(backgroundEffect, _drawExtent);
+    bool asyncCompute = _asyncComputeEnabled && _asyncCompute.available();
+    uint64_t computeValue = _frameNumber + 1;
+    if(asyncCompute) {
+        VX_TRACE_SCOPE("record compute");
+        VkCommandBuffer computeBuffer = _asyncCompute.begin(frameIndex);
+        CommandRecorder computeRecorder(computeBuffer, _commandStats);
+        _computeProfiler.begin_frame(computeBuffer, frameIndex);
+
+        if(evaluateBackground) {
+            _computeProfiler.begin_scope(computeBuffer, "background");
+            _backgroundCache.evaluate(computeRecorder, backgroundEffect, _drawExtent, _asyncCompute.to_graphics());
+            _computeProfiler.end_scope(computeBuffer);
+        }
+
+        _computeProfiler.begin_scope(computeBuffer, "light cull");
+        _clusteredLighting.cull_async(computeRecorder, _asyncCompute.to_graphics());
+        _computeProfiler.end_scope(computeBuffer);
+
+        // Overwriting the background cache waits for the previous frame to finish copying out of it,
+        // graphics value _frameNumber. Culling writes this slot's lists, which nothing reads any more.
+        _asyncCompute.submit(frameIndex, computeValue, evaluateBackground ? _frameNumber : 0);
+        _computeProfiler.mark_submitted();
+    }
 
     VkCommandBuffer commandBuffer = get_current_frame_data()._commandBuffer;
     VX_CHECK(vkResetCommandBuffer(commandBuffer, 0), "vkResetCommandBuffer"); // Grab and reset the command buffer for the framedata at index.
 
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    std::optional<Tracer::Scope> recordScope;
+#ifdef VX_TRACING
+    recordScope.emplace("record graphics"); // Ends with the command buffer, not the function.
+#endif
+
     // Begin first draw pass.
     constexpr auto commandBufferBeginInfo = beginCommandBufferInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VX_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "vkBeginCommandBuffer");
+    CommandRecorder recorder(commandBuffer, _commandStats);
+    _gpuProfiler.begin_frame(commandBuffer, frameIndex);
 
     // Transition the draw image to a general layout.
-    transitionImageLayout(commandBuffer, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    draw_background(commandBuffer); // Draw background to general.
+    recorder.transition_image(_drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+    if(asyncCompute) {
+        // Takes over what the compute queue released. The submit waits for its timeline first.
+        if(evaluateBackground) {
+            _backgroundCache.acquire(recorder, _asyncCompute.to_graphics());
+        }
+        _clusteredLighting.acquire(recorder, _asyncCompute.to_graphics());
+    }
+
+    _gpuProfiler.begin_scope(commandBuffer, "background");
+    draw_background(recorder, evaluateBackground && !asyncCompute); // Draw background to general.
+    _gpuProfiler.end_scope(commandBuffer);
 
-    // Transition the draw image to a transfer source layout.
-    transitionImageLayout(commandBuffer, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    if(!asyncCompute) {
+        _gpuProfiler.begin_scope(commandBuffer, "light cull");
+        // Cull parameters live in a per slot buffer, so the recorded dispatch stays valid while the address does.
+        record_pass(recorder, "light cull", 0, hashValue(_clusteredLighting.params_address()), nullptr, VK_FORMAT_UNDEFINED,
+            [this](CommandRecorder& cmd) { _clusteredLighting.cull(cmd); });
+        _gpuProfiler.end_scope(commandBuffer);
+    }
+
+    if(_particlesEnabled) {
+        // Simulated by the render thread's frame time, so particles move at the same speed at any frame rate.
+        _gpuProfiler.begin_scope(commandBuffer, "particle sim");
+        _particles.update(recorder, _particleEmitter, _renderFrameMs / 1000.0f);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
 
-    draw_geometry(commandBuffer);
+    // Transition the draw image to a color attachment layout.
+    recorder.transition_image(_drawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    // Depth is transient, so its previous contents are discarded.
+    recorder.transition_image(_depthImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
-    // Transition the swapchain image to a transfer destination layout.
-    transitionImageLayout(commandBuffer, _swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    float aspect = static_cast<float>(_drawExtent.width) / static_cast<float>(_drawExtent.height);
+    glm::mat4 viewProj = _camera.view_projection(aspect);
+    uint32_t objectCount = static_cast<uint32_t>(_sceneObjects.size());
+
+    // Early phase: objects visible in last frame's pyramid, or everything in the frustum with CPU culling.
+    if(_cpuCulling) {
+        VX_TRACE_SCOPE("cpu cull");
+        _cpuCuller.cull(viewProj, _camera.position, _cullDistance, _cpuVisible);
+    } else {
+        _gpuProfiler.begin_scope(commandBuffer, "occlusion cull");
+        _occlusionCuller.cull(recorder, OcclusionCuller::Phase::Early, viewProj, _sceneObjectBuffer.address, objectCount, _occlusionCulling);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
+    if(_depthPrepass) {
+        _gpuProfiler.begin_scope(commandBuffer, "depth prepass");
+        draw_depth_prepass(recorder, OcclusionCuller::Phase::Early, true);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
+    _gpuProfiler.begin_scope(commandBuffer, "geometry");
+    draw_geometry(recorder, OcclusionCuller::Phase::Early, !_depthPrepass);
+    _gpuProfiler.end_scope(commandBuffer);
+
+    // Rebuild the pyramid from this frame's early depth.
+    _gpuProfiler.begin_scope(commandBuffer, "hi-z build");
+    recorder.transition_image(_depthImage.image, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+    _occlusionCuller.build_pyramid(recorder, _depthImage);
+    recorder.transition_image(_depthImage.image, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    _gpuProfiler.end_scope(commandBuffer);
+
+    // Late phase: objects that were hidden last frame but are visible now.
+    if(!_cpuCulling) {
+        _gpuProfiler.begin_scope(commandBuffer, "occlusion cull");
+        _occlusionCuller.cull(recorder, OcclusionCuller::Phase::Late, viewProj, _sceneObjectBuffer.address, objectCount, _occlusionCulling);
+        _gpuProfiler.end_scope(commandBuffer);
+        if(_depthPrepass) {
+            _gpuProfiler.begin_scope(commandBuffer, "depth prepass");
+            draw_depth_prepass(recorder, OcclusionCuller::Phase::Late, false);
+            _gpuProfiler.end_scope(commandBuffer);
+        }
+        _gpuProfiler.begin_scope(commandBuffer, "geometry");
+        draw_geometry(recorder, OcclusionCuller::Phase::Late, false);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
+
+    _occlusionCuller.end_frame(recorder);
+
+    if(_particlesEnabled) {
+        _gpuProfiler.begin_scope(commandBuffer, "particles");
+        draw_particles(recorder);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
+
+    if(_multiviewPreview) {
+        _gpuProfiler.begin_scope(commandBuffer, "multiview");
+        std::pmr::vector<glm::mat4> views = multiviewMatrices(_camera, static_cast<MultiviewLayout>(_multiviewLayout), &_frameArena);
+        _multiview.set_views(frameIndex, views);
+        _multiview.draw(recorder, _sceneObjectBuffer.address, objectCount);
+        _multiview.composite(recorder, _drawImage.image, _drawExtent);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
+
+    if(_frameRecorder.active()) {
+        _gpuProfiler.begin_scope(commandBuffer, "frame convert");
+        _frameRecorder.record(recorder, _descriptorManager.drawImageDescritptors, _drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        _gpuProfiler.end_scope(commandBuffer);
+    }
 
      // Transition draw image to transfer source.
-    transitionImageLayout(commandBuffer, _drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    recorder.transition_image(_drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    _readback.record(commandBuffer, ReadbackTarget::DrawImage, _drawImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _drawExtent, _drawImage.format);
 
-    // Copy the draw image to the swapchain image.
-    copyImageToImage(commandBuffer, _drawImage.image, _swapchainImages[swapchainImageIndex], _drawExtent, _swapchainExtent);
+    if(!_headless) {
+        VkImage swapchainImage = _swapchainImages[swapchainImageIndex];
+        uint64_t compositeKey = hashValue(swapchainImage);
+        compositeKey = hashValue(_drawExtent, compositeKey);
+        compositeKey = hashValue(_swapchainExtent, compositeKey);
 
-    // Transition the swapchain image to an attachment optimal layout for ImGui rendering.
-    transitionImageLayout(commandBuffer, _swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    
-    // Draw ImGui debug overlay directly to swapchain (bypasses post-processing).
-    draw_imgui(commandBuffer, _swapchainImageViews[swapchainImageIndex]);
+        // One cached blit per swapchain image.
+        record_pass(recorder, "composite", swapchainImageIndex, compositeKey, nullptr, VK_FORMAT_UNDEFINED, [this, swapchainImage](CommandRecorder& cmd) {
+            // Transition the swapchain image to a transfer destination layout.
+            cmd.transition_image(swapchainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-    // Transition the swapchain image to presentable layout.
-    transitionImageLayout(commandBuffer, _swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            // Copy the draw image to the swapchain image.
+            copyImageToImage(cmd.buffer(), _drawImage.image, swapchainImage, _drawExtent, _swapchainExtent);
+
+            // Transition the swapchain image to an attachment optimal layout for ImGui rendering.
+            cmd.transition_image(swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        });
+
+        // Draw ImGui debug overlay directly to swapchain (bypasses post-processing).
+        draw_imgui(commandBuffer, _swapchainImageViews[swapchainImageIndex], packet.ui.draw_data());
+        recorder.invalidate(); // ImGui binds its own pipeline, descriptors and dynamic state.
+        _readback.record(commandBuffer, ReadbackTarget::Swapchain, _swapchainImages[swapchainImageIndex],
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, _swapchainExtent, _swapchainImageFormat);
+
+        // Transition the swapchain image to presentable layout.
+        recorder.transition_image(_swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
 
     VX_CHECK(vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+    recordScope.reset();
+    _cpuRecordMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
     // End imgui draw.
     // End the command buffer.
 
     VkCommandBufferSubmitInfo commandBufferSubmitInfo = createCommandBufferSubmitInfo(commandBuffer);
-    // Grab the previous frame's swapchain semaphore to wait on.
-    VkSemaphoreSubmitInfo waitSemaphoreInfo = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, get_current_frame_data()._swapchainSem);
-    VkSemaphoreSubmitInfo signalSemaphoreInfo = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, get_current_frame_data()._renderSem);
+    VkSemaphoreSubmitInfo waitSemaphoreInfos[2];
+    VkSemaphoreSubmitInfo signalSemaphoreInfos[2];
+    uint32_t waitCount = 0;
+    uint32_t signalCount = 0;
+
+    // Headless frames have no swapchain image to wait for or present.
+    if(!_headless) {
+        // Grab the previous frame's swapchain semaphore to wait on.
+        waitSemaphoreInfos[waitCount++] = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, get_current_frame_data()._swapchainSem);
+        signalSemaphoreInfos[signalCount++] = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, get_current_frame_data()._renderSem);
+    }
+    if(asyncCompute) {
+        // The background copy and the fragment shaders are the first to use the compute results.
+        waitSemaphoreInfos[waitCount] = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            _asyncCompute.compute_timeline());
+        waitSemaphoreInfos[waitCount++].value = computeValue;
+    }
+    signalSemaphoreInfos[signalCount] = createSemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _asyncCompute.graphics_timeline());
+    signalSemaphoreInfos[signalCount++].value = _frameNumber + 1;
 
     // Submit the command buffer to the graphics queue.
-    VkSubmitInfo2 submitInfo = createSubmitInfo2(&commandBufferSubmitInfo, &signalSemaphoreInfo, &waitSemaphoreInfo);
-    VX_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submitInfo, get_current_frame_data()._inFlightFence), "vkQueueSubmit2");
-
-    // Present the image to the screen.
-    VkPresentInfoKHR presentInfo = {};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.pNext = nullptr;
-    presentInfo.pSwapchains = &_swapchain;
-    presentInfo.swapchainCount = 1;
-    
-    presentInfo.pWaitSemaphores = &get_current_frame_data()._renderSem;
-    presentInfo.waitSemaphoreCount = 1;
+    VkSubmitInfo2 submitInfo = createSubmitInfo2(&commandBufferSubmitInfo, nullptr, nullptr);
+    submitInfo.waitSemaphoreInfoCount = waitCount;
+    submitInfo.pWaitSemaphoreInfos = waitSemaphoreInfos;
+    submitInfo.signalSemaphoreInfoCount = signalCount;
+    submitInfo.pSignalSemaphoreInfos = signalSemaphoreInfos;
+    {
+        VX_TRACE_SCOPE("submit");
+        VX_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submitInfo, get_current_frame_data()._inFlightFence), "vkQueueSubmit2");
+    }
+    _gpuProfiler.mark_submitted();
+    timestamps.submit = LatencyClock::now();
+    stateLock.unlock(); // Present may block on the compositor.
+
+    if(!_headless) {
+        // Present the image to the screen.
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.pNext = nullptr;
+        presentInfo.pSwapchains = &_swapchain;
+        presentInfo.swapchainCount = 1;
+
+        presentInfo.pWaitSemaphores = &get_current_frame_data()._renderSem;
+        presentInfo.waitSemaphoreCount = 1;
+
+        // Present the image to the screen.
+        presentInfo.pImageIndices = &swapchainImageIndex;
+
+        // Tags the present so the latency tracker can wait for it to reach the display.
+        timestamps.presentId = _latencyTracker.next_present_id();
+        VkPresentIdKHR presentId = { .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR, .swapchainCount = 1, .pPresentIds = &timestamps.presentId };
+        if(timestamps.presentId != 0) {
+            presentInfo.pNext = &presentId;
+        }
 
-    // Present the image to the screen.
-    presentInfo.pImageIndices = &swapchainImageIndex;
-    VX_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo), "vkQueuePresentKHR");
+        VkResult presentResult;
+        {
+            VX_TRACE_SCOPE("present");
+            presentResult = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+        }
+        if(presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+            _swapchainDirty = true;
+        } else {
+            VX_CHECK(presentResult, "vkQueuePresentKHR");
+        }
+        if(presentResult != VK_ERROR_OUT_OF_DATE_KHR) {
+            timestamps.present = LatencyClock::now();
+            _latencyTracker.record(timestamps);
+        }
+    }
+
+    if(_frameNumber == 0) {
+        _startupProfiler.mark_first_frame();
+    }
 
     _frameNumber++;
 }
 
 // Draw the background image.
-void VulkanRenderer::draw_background(VkCommandBuffer commandBuffer) { // Clear the draw image.
-    constexpr VkClearColorValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-    float b = static_cast<float>(std::sin(static_cast<double>(std::chrono::high_resolution_clock::now().time_since_epoch().count()) / DEFAULT_TIMEOUT_NS) + 1.0f) / 2.0f;
-    VkClearColorValue clearValue = {{0.0f, 0.0f, b , 1.0f}};
-
-    VkImageSubresourceRange clearRange = createImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
-    // Clear the image with our clearValue (should sinusoudally change colors per frame)
-    vkCmdClearColorImage(commandBuffer, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
-        
-    // Bind the compute gradient pipeline.
-    // Bind the descriptor set containing the draw image.
-    // Execute the compute pipeline.
-    ComputePipeline& selected = _computePipelines[_currentComputePipeline];
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, selected.pipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _backgroundComputePipelineLayout, 0, 1, &_descriptorManager.drawImageDescritptors, 0, nullptr);
-    vkCmdPushConstants(commandBuffer, _backgroundComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &selected.data); // Push the push constant specific data.
-
-    vkCmdDispatch(commandBuffer, std::ceil(_drawExtent.width / 16.0f), std::ceil(_drawExtent.height / 16.0f), 1);
+// evaluate is the cache's prepare result, false when the effect already ran on the async compute queue.
+void VulkanRenderer::draw_background(CommandRecorder& recorder, bool evaluate) {
+    VX_TRACE_SCOPE("draw_background");
+    // The effect overwrites every texel, so the draw image needs no clear first.
+    const ComputePipeline& effect = _computePipelines[_currentComputePipeline];
+
+    uint64_t key = hashValue(_backgroundCache.key());
+    key = hashValue(evaluate, key);
+    key = hashValue(_drawImage.image, key);
+
+    record_pass(recorder, "background", 0, key, nullptr, VK_FORMAT_UNDEFINED, [this, &effect, evaluate](CommandRecorder& cmd) {
+        _backgroundCache.record(cmd, effect, _drawImage.image, _drawExtent, evaluate);
+    });
 }
 
-void VulkanRenderer::draw_imgui(VkCommandBuffer commandBuffer, VkImageView imageView) {
+void VulkanRenderer::draw_imgui(VkCommandBuffer commandBuffer, VkImageView imageView, ImDrawData* drawData) {
+    VX_TRACE_SCOPE("draw_imgui");
+    if(drawData == nullptr) {
+        return;
+    }
+
     VkRenderingAttachmentInfo colorAttachment = createRenderingAttachmentInfo(imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    VkRenderingInfo renderInfo = createRenderingInfo(_drawExtent, &colorAttachment, nullptr);
+    VkRenderingInfo renderInfo = createRenderingInfo(_swapchainExtent, &colorAttachment, nullptr);
 
     vkCmdBeginRendering(commandBuffer, &renderInfo);
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+    ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
     vkCmdEndRendering(commandBuffer);
 }
 
-void VulkanRenderer::draw_geometry(VkCommandBuffer commandBuffer) {
-    VkRenderingAttachmentInfo colorAttachment = createRenderingAttachmentInfo(_drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
-    VkRenderingInfo renderInfo = createRenderingInfo(_drawExtent, &colorAttachment, nullptr);
-    vkCmdBeginRendering(commandBuffer, &renderInfo);
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _trianglePipeline);
-
+void VulkanRenderer::set_draw_viewport(CommandRecorder& recorder) {
     VkViewport viewport = {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -718,67 +1337,515 @@ void VulkanRenderer::draw_geometry(VkCommandBuffer commandBuffer) {
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    recorder.set_viewport(viewport);
 
     VkRect2D scissor = { VkOffset2D { 0, 0 }, _drawExtent };
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    recorder.set_scissor(scissor);
+}
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+GeometryPushConstants VulkanRenderer::triangle_push_constants() const {
+    float aspect = static_cast<float>(_drawExtent.width) / static_cast<float>(_drawExtent.height);
+    return GeometryPushConstants{
+        .viewProj = _camera.view_projection(aspect),
+        .objectBuffer = _sceneObjectBuffer.address,
+        .clusterParams = _clusteredLighting.params_address() };
+}
 
-    vkCmdEndRendering(commandBuffer);
+// Depth only pass. Afterwards the color pass tests with EQUAL and doesn't write depth,
+// so every pixel is shaded at most once regardless of overdraw. Ends with the barrier that
+// pass needs in both phases.
+void VulkanRenderer::draw_depth_prepass(CommandRecorder& recorder, OcclusionCuller::Phase phase, bool clearDepth) {
+    VX_TRACE_SCOPE("draw_depth_prepass");
+    VkRenderingAttachmentInfo depthAttachment = createDepthAttachmentInfo(_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, clearDepth, REVERSE_Z_CLEAR_DEPTH);
+
+    VkRenderingInfo renderInfo = createRenderingInfo(_drawExtent, nullptr, &depthAttachment);
+
+    GeometryPushConstants pushConstants = triangle_push_constants();
+    uint64_t key = hashValue(_triangleDepthPipeline);
+    key = hashValue(pushConstants, key);
+    key = hashValue(_drawExtent, key);
+    key = hashValue(_cpuCulling, key);
+    if(_cpuCulling) {
+        key = hashBytes(_cpuVisible.data(), _cpuVisible.size() * sizeof(uint32_t), key);
+    }
+
+    record_pass(recorder, "depth prepass", static_cast<uint32_t>(phase), key, &renderInfo, VK_FORMAT_UNDEFINED, [this, phase, pushConstants](CommandRecorder& cmd) {
+        cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, _triangleDepthPipeline, _trianglePipelineLayout);
+        cmd.set_raster_state(TRIANGLE_STATE, _pipelineCache.dynamic_state());
+        set_draw_viewport(cmd);
+        cmd.push_constants(_trianglePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GeometryPushConstants), &pushConstants);
+        draw_objects(cmd, phase);
+    });
+
+    // The color pass loads and EQUAL tests the depth just written.
+    recorder.memory_barrier(
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+}
+
+void VulkanRenderer::draw_geometry(CommandRecorder& recorder, OcclusionCuller::Phase phase, bool clearDepth) {
+    VX_TRACE_SCOPE("draw_geometry");
+    VkRenderingAttachmentInfo colorAttachment = createRenderingAttachmentInfo(_drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    // Without a prepass the early phase owns depth and clears it.
+    VkRenderingAttachmentInfo depthAttachment = createDepthAttachmentInfo(_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, clearDepth, REVERSE_Z_CLEAR_DEPTH);
+
+    VkRenderingInfo renderInfo = createRenderingInfo(_drawExtent, &colorAttachment, &depthAttachment);
+
+    VkPipeline pipeline = _depthPrepass ? _triangleEqualPipeline : _trianglePipeline;
+    const RasterState& state = _depthPrepass ? TRIANGLE_EQUAL_STATE : TRIANGLE_STATE;
+    GeometryPushConstants pushConstants = triangle_push_constants();
+    uint64_t key = hashValue(pipeline);
+    key = hashValue(state, key); // The pipeline alone doesn't tell the depth modes apart when they are dynamic.
+    key = hashValue(pushConstants, key);
+    key = hashValue(_drawExtent, key);
+    key = hashValue(_cpuCulling, key);
+    if(_cpuCulling) {
+        key = hashBytes(_cpuVisible.data(), _cpuVisible.size() * sizeof(uint32_t), key);
+    }
+
+    record_pass(recorder, "geometry", static_cast<uint32_t>(phase), key, &renderInfo, _drawImage.format, [this, phase, pipeline, state, pushConstants](CommandRecorder& cmd) {
+        cmd.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline, _trianglePipelineLayout);
+        cmd.set_raster_state(state, _pipelineCache.dynamic_state());
+        set_draw_viewport(cmd);
+        cmd.push_constants(_trianglePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GeometryPushConstants), &pushConstants);
+        draw_objects(cmd, phase);
+    });
+}
+
+// The occlusion culler's indirect draw lists, or with CPU culling the visible list as one instanced
+// draw per run of consecutive indices; the vertex shader reads objects[gl_InstanceIndex].
+void VulkanRenderer::draw_objects(CommandRecorder& cmd, OcclusionCuller::Phase phase) {
+    if(!_cpuCulling) {
+        _occlusionCuller.draw_indirect(cmd, phase);
+        return;
+    }
+    size_t count = _cpuVisible.size();
+    for(size_t i = 0; i < count;) {
+        uint32_t first = _cpuVisible[i];
+        uint32_t run = 1;
+        while(i + run < count && _cpuVisible[i + run] == first + run) {
+            run++;
+        }
+        cmd.draw(3, run, 0, first);
+        i += run;
+    }
+}
+
+// Blended over the geometry's color and tested against its depth, in a pass of its own after the late phase.
+void VulkanRenderer::draw_particles(CommandRecorder& recorder) {
+    VX_TRACE_SCOPE("draw_particles");
+    recorder.memory_barrier(
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT);
+
+    VkRenderingAttachmentInfo colorAttachment = createRenderingAttachmentInfo(_drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkRenderingAttachmentInfo depthAttachment = createDepthAttachmentInfo(_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, false, REVERSE_Z_CLEAR_DEPTH);
+    VkRenderingInfo renderInfo = createRenderingInfo(_drawExtent, &colorAttachment, &depthAttachment);
+
+    float aspect = static_cast<float>(_drawExtent.width) / static_cast<float>(_drawExtent.height);
+    recorder.begin_rendering(renderInfo);
+    set_draw_viewport(recorder);
+    _particles.draw(recorder, _particleEmitter, _camera, aspect);
+    recorder.end_rendering();
+}
+
+// Records a pass straight into the frame's command buffer, or executes its cached secondary command buffer
+// when reuse is enabled. Rendering passes hand over their renderInfo, which is begun here so the secondary
+// can run inside it; colorFormat is their color attachment's format, VK_FORMAT_UNDEFINED if there is none.
+void VulkanRenderer::record_pass(CommandRecorder& recorder, const char* name, uint32_t variant, uint64_t key,
+    const VkRenderingInfo* renderInfo, VkFormat colorFormat, CommandCache::RecordFunction record) {
+    if(!_reuseCommandBuffers) {
+        if(renderInfo) {
+            recorder.begin_rendering(*renderInfo);
+        }
+        record(recorder);
+        if(renderInfo) {
+            recorder.end_rendering();
+        }
+        return;
+    }
+
+    uint32_t frameIndex = _frameNumber % LIVE_FRAMES;
+    if(!renderInfo) {
+        recorder.execute(_commandCache.get(name, variant, frameIndex, key, nullptr, recorder.stats(), record));
+        return;
+    }
+
+    VkCommandBufferInheritanceRenderingInfo inheritance = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO };
+    inheritance.colorAttachmentCount = colorFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+    inheritance.pColorAttachmentFormats = &colorFormat;
+    inheritance.depthAttachmentFormat = renderInfo->pDepthAttachment ? _depthFormat : VK_FORMAT_UNDEFINED;
+    inheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkCommandBuffer secondary = _commandCache.get(name, variant, frameIndex, key, &inheritance, recorder.stats(), record);
+
+    VkRenderingInfo secondaryRenderInfo = *renderInfo;
+    secondaryRenderInfo.flags |= VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    recorder.begin_rendering(secondaryRenderInfo);
+    recorder.execute(secondary);
+    recorder.end_rendering();
 }
 
 void VulkanRenderer::run() {
+    VX_TRACE_SCOPE("run");
     std::cout << "Entering main loop" << std::endl;
 
+    // This thread keeps input and the UI; drawing moves to a render thread fed through _framePackets,
+    // so the UI builds the next frame while the render thread waits on fences and the swapchain.
+    _renderFailed = false;
+    _renderError = nullptr;
+    std::thread renderThread([this]() { render_loop(); });
+
+    _lastFrameBuilt = std::chrono::steady_clock::now();
+    _pendingRedraws = IDLE_SETTLE_FRAMES;
+
+    FramePacket packet; // Reused, pushing it swaps in the storage of a packet the render thread is done with.
+    while(true) {
+        packet.hasInput = false;
+        bool running = !_renderFailed.load(std::memory_order_acquire) && wait_for_redraw(packet) && build_frame(packet);
+        packet.quit = !running;
+        {
+            VX_TRACE_SCOPE("push packet");
+            _framePackets.push(std::move(packet)); // Blocks while the render thread is a full ring behind.
+        }
+        if(!running) {
+            break;
+        }
+    }
+
+    renderThread.join();
+    if(_renderError) {
+        std::rethrow_exception(_renderError);
+    }
+    
+    std::cout << "Exiting main loop" << std::endl;
+}
+
+void VulkanRenderer::render_loop() {
+    Tracer::Get().set_thread_name("render");
+    FramePacket packet; // Reused, popping into it hands its storage back to the ring.
+    while(true) {
+        _framePackets.pop(packet);
+        if(packet.quit) {
+            return;
+        }
+        if(_renderError) {
+            continue; // Keep draining so the main thread never blocks on a full ring.
+        }
+
+        try {
+            draw(packet);
+        } catch(...) {
+            _renderError = std::current_exception();
+            _renderFailed.store(true, std::memory_order_release);
+        }
+    }
+}
+
+// Blocks until something needs drawing. Events count, and so does a request_redraw() from another
+// thread, which arrives as an event. While the window can't be seen nothing is drawn at all; without
+// focus frames are capped at _unfocusedFps, and with nothing changing the UI still refreshes every
+// _idleRedrawMs so its statistics don't freeze. Events waited on here go into packet like polled ones.
+bool VulkanRenderer::wait_for_redraw(FramePacket& packet) {
+    VX_TRACE_SCOPE("wait for redraw");
+    using namespace std::chrono;
+
+    while(!_renderFailed.load(std::memory_order_acquire)) {
+        auto now = steady_clock::now();
+        bool visible = !_windowMinimized && !_windowOccluded;
+
+        std::optional<steady_clock::time_point> deadline;
+        if(!_idleScheduling) {
+            deadline = now;
+        } else if(visible && (_pendingRedraws > 0 || _frameState.particles)) {
+            // Particles keep moving, so they count as a pending redraw on every frame.
+            deadline = _windowFocused ? now : _lastFrameBuilt + milliseconds(1000 / std::max(_unfocusedFps, 1u));
+        } else if(visible && _idleRedrawMs > 0) {
+            deadline = _lastFrameBuilt + milliseconds(_idleRedrawMs);
+        }
+
+        if(deadline && now >= *deadline) {
+            _lastFrameBuilt = now;
+            _pendingRedraws = _pendingRedraws > 0 ? _pendingRedraws - 1 : 0;
+            return true;
+        }
+
+        // Bounded even without a deadline, so a failed render thread is still noticed.
+        int32_t timeoutMs = static_cast<int32_t>(IDLE_WAIT_MS);
+        if(deadline) {
+            timeoutMs = std::min(timeoutMs, static_cast<int32_t>(std::chrono::ceil<milliseconds>(*deadline - now).count()));
+        }
+
+        SDL_Event e;
+        if(SDL_WaitEventTimeout(&e, timeoutMs) && !handle_event(e, packet)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Returns false on quit.
+bool VulkanRenderer::handle_event(const SDL_Event& e, FramePacket& packet) {
+    if (e.type == SDL_EVENT_QUIT) {
+        return false;
+    }
+
+    if(isInputEvent(e.type)) {
+        // SDL timestamps events in SDL_GetTicksNS nanoseconds, mapped here onto the latency clock.
+        auto eventTime = LatencyClock::now() - std::chrono::nanoseconds(SDL_GetTicksNS() - e.common.timestamp);
+        if(!packet.hasInput || eventTime < packet.inputTime) {
+            packet.inputTime = eventTime;
+        }
+        packet.hasInput = true;
+    }
+
+    switch(e.type) {
+        case SDL_EVENT_WINDOW_MINIMIZED:
+            std::cout << "Window minimized" << std::endl;
+            _windowMinimized = true;
+            break;
+        case SDL_EVENT_WINDOW_RESTORED:
+            std::cout << "Window restored" << std::endl;
+            _windowMinimized = false;
+            break;
+        case SDL_EVENT_WINDOW_OCCLUDED:
+        case SDL_EVENT_WINDOW_HIDDEN:
+            _windowOccluded = true;
+            break;
+        case SDL_EVENT_WINDOW_EXPOSED:
+        case SDL_EVENT_WINDOW_SHOWN:
+            _windowOccluded = false;
+            break;
+        case SDL_EVENT_WINDOW_FOCUS_GAINED:
+            _windowFocused = true;
+            break;
+        case SDL_EVENT_WINDOW_FOCUS_LOST:
+            _windowFocused = false;
+            break;
+        default:
+            break;
+    }
+
+    // ImGui settles hover and focus state over a couple of frames after the event that changed it.
+    _pendingRedraws = IDLE_SETTLE_FRAMES;
+
+    ImGui_ImplSDL3_ProcessEvent(&e); // Send event to imgui
+    return true;
+}
+
+void VulkanRenderer::request_redraw() {
+    SDL_Event e = {};
+    e.type = SDL_EVENT_USER; // Only wakes wait_for_redraw, which redraws after any event.
+    SDL_PushEvent(&e);
+}
+
+bool VulkanRenderer::frame() {
+    FramePacket& packet = _localPacket;
+    packet.hasInput = false;
+    if(!build_frame(packet)) {
+        return false;
+    }
+
+    draw(packet);
+    return true;
+}
+
+// Main thread half of a frame: input, UI and the packet the render thread draws from.
+bool VulkanRenderer::build_frame(FramePacket& packet) {
+    auto start = std::chrono::high_resolution_clock::now();
+    Tracer::Get().collect(); // Once per frame, keeps the thread rings from filling up during a capture.
     SDL_Event e;
-    bool quit = false;
 
-    // Just run a short event loop for testing
-    while(!quit) {
-        // Poll for events
+    // Poll for events
+    {
+        VX_TRACE_SCOPE("poll events");
         while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_EVENT_QUIT) {
-                quit = true;
-                break;
-            }
-            
-            if(e.type == SDL_EVENT_WINDOW_MINIMIZED){
-                std::cout << "Window minimized" << std::endl;
-                _windowMinimized = true;
+            if(!handle_event(e, packet)) {
+                return false;
             }
-            if(e.type == SDL_EVENT_WINDOW_RESTORED){
-                std::cout << "Window restored" << std::endl;
-                _windowMinimized = false;
-            }
-
-            ImGui_ImplSDL3_ProcessEvent(&e); // Send event to imgui
         }
+    }
 
+    // The first call uploads the font atlas through the graphics queue. That happens before the first
+    // packet exists, while the render thread is still idle, and later calls don't touch the queue.
+    {
+        VX_TRACE_SCOPE("build ui");
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplSDL3_NewFrame();
         ImGui::NewFrame();
-        if (ImGui::Begin("background")) {
-			
-			ComputePipeline& selected = _computePipelines[_currentComputePipeline];
-		
-			ImGui::Text("Selected effect: %s", selected.name.c_str());
-		
-			ImGui::SliderInt("Effect Index", &_currentComputePipeline,0, _computePipelines.size() - 1);
-		
-			ImGui::InputFloat4("data1",(float*)& selected.data.data1);
-			ImGui::InputFloat4("data2",(float*)& selected.data.data2);
-			ImGui::InputFloat4("data3",(float*)& selected.data.data3);
-			ImGui::InputFloat4("data4",(float*)& selected.data.data4);
+        build_ui();
+        ImGui::Render();
+    }
+
+    int pixelWidth = 0;
+    int pixelHeight = 0;
+    SDL_GetWindowSizeInPixels(_window, &pixelWidth, &pixelHeight);
+
+    packet.number = _packetNumber++;
+    packet.windowExtent = { static_cast<uint32_t>(pixelWidth), static_cast<uint32_t>(pixelHeight) };
+    packet.state = _frameState;
+    packet.ui.capture(ImGui::GetDrawData());
+
+    _mainFrameMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
+void VulkanRenderer::build_ui() {
+    std::lock_guard<std::mutex> lock(_stateMutex); // The stats shown are written by the render thread.
+
+    if (ImGui::Begin("background")) {
+		ImGui::Text("Main thread: %.2f ms, render thread: %.2f ms", _mainFrameMs, _renderFrameMs);
+		ImGui::Checkbox("Idle scheduling", &_idleScheduling);
+		ImGui::SameLine();
+		const uint32_t minFps = 1;
+		const uint32_t maxFps = 60;
+		ImGui::SliderScalar("Unfocused FPS", ImGuiDataType_U32, &_unfocusedFps, &minFps, &maxFps);
+		if(ImGui::BeginCombo("Present mode", presentModeName(_frameState.presentMode))) {
+			for(VkPresentModeKHR mode : SELECTABLE_PRESENT_MODES) {
+				if(ImGui::Selectable(presentModeName(mode), mode == _frameState.presentMode)) {
+					_frameState.presentMode = mode;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::Text("Swapchain: %s, %zu images, %ux%u, drawn at %ux%u, recreated %llu times", presentModeName(_swapchainPresentMode),
+			_swapchainImages.size(), _swapchainExtent.width, _swapchainExtent.height, _drawExtent.width, _drawExtent.height,
+			static_cast<unsigned long long>(_swapchainRecreations));
+
+		ImGui::SliderInt("Effect Index", &_frameState.computePipeline,0, _computePipelines.size() - 1);
+
+		ComputePushConstants& selected = _frameState.effectData[_frameState.computePipeline];
+	
+		ImGui::Text("Selected effect: %s", _computePipelines[_frameState.computePipeline].name.c_str());
+	
+		ImGui::InputFloat4("data1",(float*)& selected.data1);
+		ImGui::InputFloat4("data2",(float*)& selected.data2);
+		ImGui::InputFloat4("data3",(float*)& selected.data3);
+		ImGui::InputFloat4("data4",(float*)& selected.data4);
+
+		const BackgroundCache::Stats& backgroundStats = _backgroundCache.stats();
+		ImGui::Text("Background evaluations: %llu, cached frames: %llu",
+			static_cast<unsigned long long>(backgroundStats.evaluations), static_cast<unsigned long long>(backgroundStats.reuses));
+
+		ImGui::Checkbox("Reuse command buffers", &_frameState.reuseCommandBuffers);
+		if(_asyncCompute.available()) {
+			ImGui::Checkbox("Async compute", &_frameState.asyncCompute);
+		} else {
+			ImGui::TextDisabled("Async compute: no separate compute family");
+		}
+		const CommandCache::Stats& commandStats = _commandCache.stats();
+		ImGui::Text("CPU record: %.3f ms, secondaries recorded: %llu, reused: %llu", _cpuRecordMs,
+			static_cast<unsigned long long>(commandStats.recorded), static_cast<unsigned long long>(commandStats.reused));
+		ImGui::Text("Draws: %u, dispatches: %u, barriers: %u, executes: %u", _commandStats.draws, _commandStats.dispatches,
+			_commandStats.barriers, _commandStats.executes);
+		ImGui::Text("Pipeline binds: %u, set binds: %u, pushes: %u, dynamic: %u, redundant dropped: %u", _commandStats.pipelineBinds,
+			_commandStats.descriptorBinds, _commandStats.pushConstants, _commandStats.dynamicState, _commandStats.redundant);
+		const PipelineCache::Stats& pipelineStats = _pipelineCache.stats();
+		ImGui::Text("Pipelines built: %u (%.1f ms), deduplicated: %u, dynamic blend enable: %s", pipelineStats.built, pipelineStats.buildMs,
+			pipelineStats.hits, (_pipelineCache.dynamic_state() & DYNAMIC_STATE_BLEND_ENABLE) ? "yes" : "no");
+		const FrameArena::Stats& arenaStats = _frameArena.stats();
+		ImGui::Text("Frame arena: %zu of %zu bytes, peak %zu, overflows: %llu", arenaStats.used, _frameArena.capacity(),
+			arenaStats.highWater, static_cast<unsigned long long>(arenaStats.overflows));
+#ifdef VX_TRACING
+		if(!Tracer::Get().capturing()) {
+			if(ImGui::Button("Start trace capture")) {
+				Tracer::Get().start("vx_trace.json");
+			}
+		} else if(ImGui::Button("Stop trace capture (writes vx_trace.json)")) {
+			Tracer::Get().stop();
+		}
+#endif
+
+		ImGui::Checkbox("Depth prepass", &_frameState.depthPrepass);
+		ImGui::Checkbox("Occlusion culling", &_frameState.occlusionCulling);
+		ImGui::Checkbox("CPU culling", &_frameState.cpuCulling);
+
+		if(_cpuCulling) {
+			ImGui::SliderFloat("Cull distance", &_frameState.cullDistance, 0.0f, 100.0f, _frameState.cullDistance > 0.0f ? "%.1f" : "off");
+			const CpuCuller::Stats& cpuStats = _cpuCuller.stats();
+			ImGui::Text("Objects: %u, visible: %u, %.3f ms (%s, %u chunks on %u workers)", cpuStats.objects, cpuStats.visible, cpuStats.cpuMs,
+				_cpuCuller.avx2() ? "AVX2" : "scalar", cpuStats.chunks, _cpuCuller.workers());
+		} else {
+			const OcclusionCuller::Stats& cullStats = _occlusionCuller.stats();
+			ImGui::Text("Objects: %u, early: %u, late: %u, culled: %u", cullStats.objects, cullStats.early, cullStats.late,
+				cullStats.objects - std::min(cullStats.objects, cullStats.early + cullStats.late));
 		}
-        ImGui::End();
 
-        ImGui::Render();
-        
-        draw();
+		ImGui::SliderInt("Lights", &_frameState.lightCount, 0, static_cast<int>(ClusteredLighting::MAX_LIGHTS), "%d", ImGuiSliderFlags_Logarithmic);
+		const ClusteredLighting::Stats& lightStats = _clusteredLighting.stats();
+		ImGui::Text("Light indices: %u of %u, dropped: %u", lightStats.indices, ClusteredLighting::INDEX_CAPACITY, lightStats.dropped);
+
+		ImGui::Checkbox("Multiview preview", &_frameState.multiviewPreview);
+		ImGui::SameLine();
+		ImGui::Combo("##multiview layout", &_frameState.multiviewLayout, "Stereo\0Cubemap\0Wall\0");
+
+		ImGui::Checkbox("GPU particles", &_frameState.particles);
+		if(_frameState.particles) {
+			ImGui::SliderFloat("Particle rate", &_frameState.particleRate, 1000.0f, 4000000.0f, "%.0f / s", ImGuiSliderFlags_Logarithmic);
+			ImGui::Checkbox("Read back alive count", &_frameState.particleReadback);
+			const ParticleSystem::Stats& particleStats = _particles.stats();
+			if(_frameState.particleReadback) {
+				ImGui::Text("Particles alive: %u of %u", particleStats.alive, particleStats.capacity);
+			} else {
+				ImGui::Text("Particle capacity: %u", particleStats.capacity);
+			}
+		}
+
+		if(ImGui::Button("Screenshot")) {
+			capture(ReadbackTarget::Swapchain, ImageFileFormat::PNG, "screenshot_" + std::to_string(_packetNumber) + ".png");
+		}
+		ImGui::SameLine();
+		if(ImGui::Button("Capture HDR")) {
+			capture(ReadbackTarget::DrawImage, ImageFileFormat::EXR, "capture_" + std::to_string(_packetNumber) + ".exr");
+		}
+	}
+    ImGui::End();
+
+    _memoryTelemetry.draw_imgui(_frameState.memoryWarningRatio);
+    _transientPool.draw_imgui();
+    _gpuProfiler.draw_imgui();
+    if(_asyncCompute.available()) {
+        _computeProfiler.draw_imgui("compute timings");
+    }
+    _latencyTracker.draw_imgui();
+    _allocationTracker.draw_imgui();
+}
+
+// Takes over what the main thread decided for this frame.
+void VulkanRenderer::apply_frame_state(const FrameState& state) {
+    _camera = state.camera;
+    _currentComputePipeline = std::clamp(state.computePipeline, 0, static_cast<int>(_computePipelines.size()) - 1);
+    for(size_t i = 0; i < std::min(_computePipelines.size(), state.effectData.size()); i++) {
+        _computePipelines[i].data = state.effectData[i];
+    }
+
+    _depthPrepass = state.depthPrepass;
+    _occlusionCulling = state.occlusionCulling;
+    _cpuCulling = state.cpuCulling;
+    _cullDistance = state.cullDistance;
+    _reuseCommandBuffers = state.reuseCommandBuffers;
+    _asyncComputeEnabled = state.asyncCompute;
+    _multiviewPreview = state.multiviewPreview;
+    _multiviewLayout = state.multiviewLayout;
+    if(state.particles && !_particlesEnabled) {
+        _particles.reset(); // Every run starts empty instead of resuming where the last one stopped.
+    }
+    _particlesEnabled = state.particles;
+    _particleEmitter.rate = state.particleRate;
+    _particles.read_alive_count(state.particleReadback);
+    _memoryTelemetry.set_warning_ratio(state.memoryWarningRatio);
+
+    if(state.presentMode != _presentMode) {
+        _presentMode = state.presentMode;
+        _swapchainDirty = true;
+    }
+
+    if(state.lightCount != _lightCount) {
+        _lightCount = state.lightCount;
+        set_test_lights(static_cast<uint32_t>(_lightCount));
     }
-    
-    std::cout << "Exiting main loop" << std::endl;
 }
 
 } // namespace VxEngine
@@ -5,12 +5,52 @@
 #include "vx_image.hpp"
 #include "vx_descriptors.hpp"
 #include "vx_pipeline.hpp"
+#include "vx_pipelineCache.hpp"
+#include "vx_startupProfiler.hpp"
+#include "vx_memoryTelemetry.hpp"
+#include "vx_transientPool.hpp"
+#include "vx_camera.hpp"
+#include "vx_buffer.hpp"
+#include "vx_occlusionCuller.hpp"
+#include "vx_cpuCuller.hpp"
+#include "vx_particles.hpp"
+#include "vx_clusteredLighting.hpp"
+#include "vx_gpuProfiler.hpp"
+#include "vx_readback.hpp"
+#include "vx_frameRecorder.hpp"
+#include "vx_multiview.hpp"
+#include "vx_backgroundCache.hpp"
+#include "vx_commandCache.hpp"
+#include "vx_framePacket.hpp"
+#include "vx_spscRing.hpp"
+#include "vx_presentation.hpp"
+#include "vx_asyncCompute.hpp"
+#include "vx_trace.hpp"
+#include "vx_allocationTracker.hpp"
+#include "vx_frameArena.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <exception>
+#include <mutex>
 #include <vector>
 
 namespace VxEngine {
 
+// Pass order within a frame. Transient render targets are requested with the
+// range of passes they are live for.
+enum FramePass : uint32_t {
+	PASS_BACKGROUND = 0,
+	PASS_OCCLUSION_CULL,
+	PASS_LIGHT_CULL,
+	PASS_DEPTH_PREPASS,
+	PASS_GEOMETRY,
+	PASS_PARTICLES,
+	PASS_MULTIVIEW,
+	PASS_COMPOSITE, // Blit to the swapchain and ImGui.
+};
+
 class VulkanRenderer {
 public:
 	static VulkanRenderer& Get(); // Singleton renderer get
@@ -43,14 +83,21 @@ public:
 
     VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamilyIndex;
+
+	// Background and light culling run here ahead of the graphics work when the device has a compute
+	// family apart from graphics, see vx_asyncCompute.hpp.
+	AsyncCompute _asyncCompute;
+	bool _asyncComputeEnabled = true;
 	
 	// Engine control variables
 	bool _isInitialized = false;
-	bool _windowMinimized = false;
+	bool _windowMinimized = false; // Main thread.
+	bool _headless = false; // Set before init(). Hidden window, frames are never acquired or presented.
+	std::string _tracePath; // Set before init(). Captures a trace from init until cleanup, see vx_trace.hpp.
 	uint64_t _frameNumber = 0;
 
 	// Window variables
-	VkExtent2D _windowExtent{ 1700 , 900 };
+	VkExtent2D _windowExtent{ 1700 , 900 }; // In pixels. Render thread after init, updated from frame packets.
     SDL_Window* _window;
 	VkSurfaceKHR _surface;
 
@@ -63,37 +110,145 @@ public:
 	VkSwapchainKHR _swapchain;
 	VkFormat _swapchainImageFormat;
 	VkExtent2D _swapchainExtent;
+	VkPresentModeKHR _presentMode = VK_PRESENT_MODE_FIFO_KHR; // Requested, set before init(). Falls back to what the surface supports.
+	uint32_t _requestedImageCount = 0; // Set before init(), 0 for one more than the surface minimum.
+	VkPresentModeKHR _swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR; // What the swapchain was created with.
+	uint32_t _swapchainMinImageCount = 2;
+	bool _swapchainDirty = false; // Out of date, suboptimal or a setting changed; recreated at the start of the next frame.
+	uint64_t _swapchainRecreations = 0;
 	std::vector<VkImage> _swapchainImages;
 	std::vector<VkImageView> _swapchainImageViews;
 
 	VmaAllocator _allocator;
+	MemoryTelemetry _memoryTelemetry; // Heap budgets and per category allocation totals.
 	DeletionManager _engineDeletionManager; // Used to cleanup vulkan objects created for the renderer.
+	DeletionManager _pipelineDeletionManager; // Filled by the init_pipelines worker, appended to the engine's once it finishes.
 
-	// Draw image variables
+	// Draw image variables. The image is allocated once at _maxDrawExtent and resizes only change the
+	// part of it that is drawn; swapchains larger than it are drawn at the maximum and upscaled.
 	AllocatedImage _drawImage;
 	VkExtent2D _drawExtent;
+	VkExtent2D _maxDrawExtent; // Largest display, found in init_window.
+
+	TransientImagePool _transientPool; // Aliased, recycled per-frame render targets.
+
+	// Depth buffer, follows _drawExtent. Reverse-Z, see vx_camera.hpp.
+	VkFormat _depthFormat = VK_FORMAT_D32_SFLOAT;
+	AllocatedImage _depthImage;
+	bool _depthPrepass = false;
+
+	Camera _camera;
+
+	// Scene objects, drawn through the occlusion culler's indirect draw lists.
+	std::vector<GPUObjectData> _sceneObjects;
+	AllocatedBuffer _sceneObjectBuffer;
+	OcclusionCuller _occlusionCuller;
+	bool _occlusionCulling = true;
+
+	// Frustum and distance culling on the CPU instead of the GPU cull. The geometry passes then draw
+	// _cpuVisible as one instanced draw per run of consecutive objects and skip the late phase.
+	CpuCuller _cpuCuller;
+	bool _cpuCulling = false;
+	float _cullDistance = 0.0f; // 0 for none.
+	std::vector<uint32_t> _cpuVisible;
+
+	// GPU particles, simulated next to the background and blended over the scene after the geometry.
+	static constexpr uint32_t MAX_PARTICLES = 1u << 21;
+	ParticleSystem _particles;
+	ParticleEmitter _particleEmitter;
+	bool _particlesEnabled = false;
+
+	ClusteredLighting _clusteredLighting;
+	int _lightCount = 64; // Random test lights, regenerated from the UI.
+
+	// Extra viewpoints rendered in one multiview pass and shown along the bottom of the draw image.
+	MultiviewPass _multiview;
+	bool _multiviewPreview = false;
+	int _multiviewLayout = static_cast<int>(MultiviewLayout::Cubemap);
+
+	// Every pipeline and shader module, deduplicated by the state they are built from.
+	PipelineCache _pipelineCache;
+	uint32_t _dynamicState = CORE_DYNAMIC_STATE; // DynamicStateFlags the device supports.
 
-	// We will want to move to a pipeline manager system that allows hotswapping of pipelines
-	// in real time.
 	// VkPipeline _gradientPipeline;
 	VkPipelineLayout _backgroundComputePipelineLayout;
+	BackgroundCache _backgroundCache; // Background effect result, recomputed only when its inputs change.
 
 	std::vector<ComputePipeline> _computePipelines;
 	int _currentComputePipeline = 0;
 
 	VkPipelineLayout _trianglePipelineLayout;
-	VkPipeline _trianglePipeline;
+	VkPipeline _trianglePipeline;      // Depth test and write.
+	VkPipeline _triangleEqualPipeline; // EQUAL test without writes, after the prepass. _trianglePipeline when depth state is dynamic.
+	VkPipeline _triangleDepthPipeline; // Depth only prepass.
 
 	// ImGui Variables
 	VkFence _immFence;
     VkCommandBuffer _immCommandBuffer;
     VkCommandPool _immCommandPool;
+
+	// Static passes recorded once into secondary command buffers and replayed while their inputs hold.
+	CommandCache _commandCache;
+	bool _reuseCommandBuffers = true;
+	float _cpuRecordMs = 0.0f; // CPU time spent recording the last frame's primary command buffer.
+	CommandStats _commandStats; // Commands recorded for the last frame, redundant state filtered out.
+
+	// Main thread side of a frame. The UI edits _frameState, and every packet carries a copy of it.
+	FrameState _frameState;
+	uint64_t _packetNumber = 0;
+	float _mainFrameMs = 0.0f;   // Input and UI per frame.
+	float _renderFrameMs = 0.0f; // Between render thread frames, GPU waits included.
+
+	// Idle scheduling, main thread. run() only builds frames when something needs redrawing, so idle
+	// instances sit in SDL_WaitEventTimeout and the render thread blocks on an empty packet ring.
+	static constexpr uint32_t IDLE_SETTLE_FRAMES = 3; // Frames drawn after each event.
+	static constexpr uint32_t IDLE_WAIT_MS = 250;     // Longest single wait for events.
+	bool _idleScheduling = true; // Off draws continuously.
+	uint32_t _unfocusedFps = UNFOCUSED_FPS_LIMIT; // Frame rate cap while the window doesn't have focus.
+	uint32_t _idleRedrawMs = 1000; // Refresh interval when nothing changes, 0 for none.
+	bool _windowFocused = true;
+	bool _windowOccluded = false;
+
+	// Packets between the main and the render thread. Two let the main thread build the next frame
+	// while the current one is drawn, without running further ahead and adding latency.
+	static constexpr uint32_t FRAME_PACKET_COUNT = 2;
+	SpscRing<FramePacket, FRAME_PACKET_COUNT> _framePackets;
+	FramePacket _localPacket; // frame()'s, kept so its UI snapshot storage is reused.
+
+	// Per frame CPU scratch, render thread. Reset at the start of every draw().
+	static constexpr size_t FRAME_ARENA_BYTES = 256 * 1024;
+	FrameArena _frameArena;
+	AllocationTracker _allocationTracker; // Heap allocations per frame and scope, shown in the UI.
+
+	// Held by the render thread while it updates and records renderer state, released while it waits
+	// on the GPU, and held by the main thread while the UI reads that state.
+	std::mutex _stateMutex;
 	
-	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+	StartupProfiler _startupProfiler; // Init phase timings and time to first frame.
+	GpuProfiler _gpuProfiler; // Per pass GPU timings.
+	GpuProfiler _computeProfiler; // Pass timings on the async compute queue.
+	ReadbackService _readback; // Async screenshots and frame captures.
+	FrameRecorder _frameRecorder; // Frame sequence output.
+	LatencyTracker _latencyTracker; // Input to display timestamps of presented frames.
+
+	void immediate_submit(FunctionRef<void(VkCommandBuffer cmd)> function);
 
 	void init();
 	void run();
 	void cleanup();
+
+	// Polls events, builds the UI and draws one frame on the calling thread. Returns false once the
+	// window is closed. run() splits the same work across the main and a render thread.
+	bool frame();
+
+	// Wakes an idle run() loop for one more frame, e.g. after changing _frameState. Any thread.
+	void request_redraw();
+
+	// Replaces the scene lights with count random lights.
+	void set_test_lights(uint32_t count);
+
+	// Captures the target on the next drawn frame without stalling the render loop.
+	std::future<ReadbackResult> capture(ReadbackTarget target, ImageFileFormat fileFormat = ImageFileFormat::None, std::string path = {});
 	
 private:
 	void init_window();
@@ -104,19 +259,36 @@ private:
 	void init_descriptors();
 	void init_pipelines();
 	void init_background_pipelines();
+	void add_background_effect(const ComputePipeline& effect);
 	void init_triangle_pipeline();
+	void init_scene();
 	void init_imgui();
 
 	void cleanup_vk_objects();
 
-	void draw();
-	void draw_background(VkCommandBuffer commandBuffer);
-	void draw_imgui(VkCommandBuffer commandBuffer, VkImageView imageView);
-	void draw_geometry(VkCommandBuffer commandBuffer);
+	bool build_frame(FramePacket& packet);
+	void build_ui();
+	void render_loop();
+	bool wait_for_redraw(FramePacket& packet);
+	bool handle_event(const SDL_Event& e, FramePacket& packet);
+	void apply_frame_state(const FrameState& state);
+
+	void draw(FramePacket& packet);
+	void draw_background(CommandRecorder& recorder, bool evaluate);
+	void draw_imgui(VkCommandBuffer commandBuffer, VkImageView imageView, ImDrawData* drawData);
+	void draw_depth_prepass(CommandRecorder& recorder, OcclusionCuller::Phase phase, bool clearDepth);
+	void draw_geometry(CommandRecorder& recorder, OcclusionCuller::Phase phase, bool clearDepth);
+	void draw_objects(CommandRecorder& cmd, OcclusionCuller::Phase phase);
+	void draw_particles(CommandRecorder& recorder);
+	void set_draw_viewport(CommandRecorder& recorder);
+	void record_pass(CommandRecorder& recorder, const char* name, uint32_t variant, uint64_t key,
+		const VkRenderingInfo* renderInfo, VkFormat colorFormat, CommandCache::RecordFunction record);
+	GeometryPushConstants triangle_push_constants() const;
 
 	void print_vulkan_info();
 
-	void create_swapchain();
+	void create_swapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+	void recreate_swapchain();
 	void create_draw_image();
 	void destroy_swapchain();
 	void destroy_frame_data();
@@ -124,6 +296,12 @@ private:
 	VkInstance _instance;
 	VkDebugUtilsMessengerEXT _debugMessenger;
 	DescriptorManager _descriptorManager;
+
+	std::chrono::high_resolution_clock::time_point _lastRenderFrame;
+	std::chrono::steady_clock::time_point _lastFrameBuilt; // Main thread, for idle scheduling.
+	uint32_t _pendingRedraws = 0;
+	std::atomic<bool> _renderFailed = false;
+	std::exception_ptr _renderError; // Rethrown by run() once the render thread is joined.
 };
 
 } // namespace VxEngine
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+// Bounded ring for exactly one producer thread and one consumer thread. Each index is only
+// written by its own side, so no locks are needed: the producer publishes a slot by releasing
+// _head, the consumer hands it back by releasing _tail. A full ring blocks the producer and an
+// empty one blocks the consumer, through C++20 atomic waits rather than spinning. The try_ variants
+// return false instead of blocking, for sides that must never wait.
+// Either side may move between threads as long as the handover synchronizes, e.g. through a mutex.
+
+namespace VxEngine {
+
+template<typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    // Producer only. Blocks while all slots are in use.
+    void push(T&& value) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        while(head - tail == Capacity) {
+            _tail.wait(tail, std::memory_order_acquire);
+            tail = _tail.load(std::memory_order_acquire);
+        }
+
+        _slots[head & MASK] = std::move(value);
+        _head.store(head + 1, std::memory_order_release);
+        _head.notify_one();
+    }
+
+    // Producer only. False if all slots are in use.
+    bool try_push(T&& value) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if(head - _tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+
+        _slots[head & MASK] = std::move(value);
+        _head.store(head + 1, std::memory_order_release);
+        _head.notify_one();
+        return true;
+    }
+
+    // Consumer only. False if no value is available.
+    bool try_pop(T& value) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if(_head.load(std::memory_order_acquire) == tail) {
+            return false;
+        }
+
+        value = std::move(_slots[tail & MASK]);
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+        return true;
+    }
+
+    // Consumer only. Blocks until a value is available.
+    T pop() {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        while(head == tail) {
+            _head.wait(head, std::memory_order_acquire);
+            head = _head.load(std::memory_order_acquire);
+        }
+
+        T value = std::move(_slots[tail & MASK]);
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+        return value;
+    }
+
+    // Consumer only. Blocks until a value is available and move assigns it to value, so types
+    // whose move assignment swaps hand their old contents back to the slot.
+    void pop(T& value) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        while(head == tail) {
+            _head.wait(head, std::memory_order_acquire);
+            head = _head.load(std::memory_order_acquire);
+        }
+
+        value = std::move(_slots[tail & MASK]);
+        _tail.store(tail + 1, std::memory_order_release);
+        _tail.notify_one();
+    }
+
+    // Either side, approximate while the other side is running.
+    uint32_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+private:
+    static constexpr uint32_t MASK = Capacity - 1;
+
+    std::array<T, Capacity> _slots;
+
+    // On separate cache lines so the two threads don't invalidate each other's index.
+    alignas(64) std::atomic<uint32_t> _head{ 0 }; // Next slot the producer writes.
+    alignas(64) std::atomic<uint32_t> _tail{ 0 }; // Next slot the consumer reads.
+};
+
+} // namespace VxEngine
@@ -0,0 +1,77 @@
+#include "vx_startupProfiler.hpp"
+#include "vx_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace VxEngine {
+
+void StartupProfiler::begin() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _begin = Clock::now();
+    _mainThread = std::this_thread::get_id();
+    _phases.clear();
+    _firstFramePresented = false;
+    _timeToFirstFrameMs = 0.0;
+}
+
+double StartupProfiler::to_ms(Clock::time_point t) const {
+    return std::chrono::duration<double, std::milli>(t - _begin).count();
+}
+
+void StartupProfiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _phases.push_back(PhaseRecord{
+        .name = name,
+        .startMs = to_ms(start),
+        .durationMs = std::chrono::duration<double, std::milli>(end - start).count(),
+        .thread = std::this_thread::get_id() });
+
+    // Phases also show up in a trace capture started before init().
+    using std::chrono::nanoseconds;
+    Tracer::Get().record(name, std::chrono::duration_cast<nanoseconds>(start.time_since_epoch()).count(),
+        std::chrono::duration_cast<nanoseconds>(end.time_since_epoch()).count());
+}
+
+void StartupProfiler::mark_first_frame() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_firstFramePresented) {
+            return;
+        }
+        _firstFramePresented = true;
+        _timeToFirstFrameMs = to_ms(Clock::now());
+    }
+
+    print_report();
+}
+
+// Printed once per run, so a single buffered write is used instead of a flush per line.
+void StartupProfiler::print_report() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<PhaseRecord> phases = _phases;
+    std::sort(phases.begin(), phases.end(), [](const PhaseRecord& a, const PhaseRecord& b) {
+        return a.startMs < b.startMs;
+    });
+
+    std::string report = "------- Startup Report -------\n";
+    char line[160];
+    for(const PhaseRecord& phase : phases) {
+        const char* thread = phase.thread == _mainThread ? "main" : "worker";
+        std::snprintf(line, sizeof(line), "  %-24s %8.2f ms  (at %8.2f ms, %s)\n",
+            phase.name.c_str(), phase.durationMs, phase.startMs, thread);
+        report += line;
+    }
+
+    if(_firstFramePresented) {
+        std::snprintf(line, sizeof(line), "  %-24s %8.2f ms\n", "time to first frame", _timeToFirstFrameMs);
+        report += line;
+    }
+    report += "------------------------------\n";
+
+    std::fputs(report.c_str(), stdout);
+    std::fflush(stdout);
+}
+
+} // namespace VxEngine
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Collects wall clock timings for the renderer init phases and the time until the
+// first frame is presented. Phases may be timed from multiple threads, so the
+// report shows which thread each phase ran on as well as its start offset.
+
+namespace VxEngine {
+
+class StartupProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct PhaseRecord {
+        std::string name;
+        double startMs; // Offset from begin().
+        double durationMs;
+        std::thread::id thread;
+    };
+
+    // Times a phase for the lifetime of the scope.
+    class ScopedTimer {
+    public:
+        ScopedTimer(StartupProfiler& profiler, const char* name)
+            : _profiler(profiler), _name(name), _start(Clock::now()) {}
+        ~ScopedTimer() { _profiler.record(_name, _start, Clock::now()); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        StartupProfiler& _profiler;
+        const char* _name;
+        Clock::time_point _start;
+    };
+
+    void begin();
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+
+    // Called once the first frame has been handed to the presentation engine.
+    // Prints the startup report the first time it is called.
+    void mark_first_frame();
+
+    void print_report() const;
+
+    double time_to_first_frame_ms() const { return _timeToFirstFrameMs; }
+    bool first_frame_presented() const { return _firstFramePresented; }
+
+private:
+    double to_ms(Clock::time_point t) const;
+
+    mutable std::mutex _mutex;
+    Clock::time_point _begin{};
+    std::thread::id _mainThread;
+    std::vector<PhaseRecord> _phases;
+
+    bool _firstFramePresented = false;
+    double _timeToFirstFrameMs = 0.0;
+};
+
+} // namespace VxEngine
+
+#define VX_STARTUP_CONCAT_INNER(a, b) a##b
+#define VX_STARTUP_CONCAT(a, b) VX_STARTUP_CONCAT_INNER(a, b)
+#define VX_STARTUP_PHASE(profiler, name) \
+    ::VxEngine::StartupProfiler::ScopedTimer VX_STARTUP_CONCAT(_vx_startup_timer_, __LINE__)((profiler), (name))
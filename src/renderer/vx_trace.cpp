@@ -0,0 +1,168 @@
+#include "vx_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace VxEngine {
+
+namespace {
+
+// Trace names are our own literals, but a quote or backslash would still break the file.
+void writeJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for(const char* c = text; *c; c++) {
+        if(*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+constexpr uint32_t CPU_PID = 1;
+constexpr uint32_t GPU_PID = 2;
+
+} // namespace
+
+Tracer& Tracer::Get() {
+    static Tracer tracer;
+    return tracer;
+}
+
+bool Tracer::start(const std::string& path) {
+#ifdef VX_TRACING
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(capturing()) {
+        return false;
+    }
+
+    drain(false); // Stragglers recorded while the last capture stopped.
+    _captured.clear();
+    _path = path;
+    _dropped.store(0, std::memory_order_relaxed);
+    _capturing.store(true, std::memory_order_relaxed);
+    std::cout << "Trace capture started, writing to " << path << " when stopped" << std::endl;
+    return true;
+#else
+    std::cerr << "Tracing is compiled out of this build, " << path << " won't be written." << std::endl;
+    return false;
+#endif
+}
+
+bool Tracer::stop() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!capturing()) {
+        return false;
+    }
+
+    _capturing.store(false, std::memory_order_relaxed);
+    drain(true);
+    bool written = write(_path);
+    if(written) {
+        std::cout << "Trace written to " << _path << ": " << _captured.size() << " events, "
+            << _dropped.load(std::memory_order_relaxed) << " dropped" << std::endl;
+    } else {
+        std::cerr << "Failed to write trace: " << _path << std::endl;
+    }
+    _captured.clear();
+    _captured.shrink_to_fit();
+    return written;
+}
+
+void Tracer::collect() {
+    if(!capturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    drain(true);
+}
+
+void Tracer::set_thread_name(const char* name) {
+    ThreadRing& ring = thread_ring();
+    std::lock_guard<std::mutex> lock(_mutex);
+    ring.name = name;
+}
+
+uint32_t Tracer::gpu_track(const char* name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = std::find(_gpuTracks.begin(), _gpuTracks.end(), name);
+    if(it == _gpuTracks.end()) {
+        it = _gpuTracks.insert(_gpuTracks.end(), name);
+    }
+    return static_cast<uint32_t>(it - _gpuTracks.begin()) + 1;
+}
+
+void Tracer::push(TraceEvent&& event) {
+    if(!thread_ring().events.try_push(std::move(event))) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Tracer::ThreadRing& Tracer::thread_ring() {
+    thread_local ThreadRing* ring = nullptr;
+    if(!ring) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rings.push_back(std::make_unique<ThreadRing>());
+        ring = _rings.back().get();
+        ring->tid = static_cast<uint32_t>(_rings.size());
+        ring->name = "thread " + std::to_string(ring->tid);
+    }
+    return *ring;
+}
+
+// The lock makes this the only consumer of every ring, whichever thread calls it.
+void Tracer::drain(bool keep) {
+    for(const std::unique_ptr<ThreadRing>& ring : _rings) {
+        TraceEvent event;
+        while(ring->events.try_pop(event)) {
+            if(keep) {
+                _captured.push_back(CapturedEvent{ event, ring->tid });
+            }
+        }
+    }
+}
+
+// Chrome trace event format: complete ("X") events in microseconds, CPU threads and GPU tracks as
+// two processes so each group gets its own section of the timeline.
+bool Tracer::write(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) {
+        return false;
+    }
+
+    int64_t origin = INT64_MAX;
+    for(const CapturedEvent& captured : _captured) {
+        origin = std::min(origin, captured.event.startNs);
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"CPU\"}},\n", CPU_PID);
+    fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU_PID);
+    for(const std::unique_ptr<ThreadRing>& ring : _rings) {
+        fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":", CPU_PID, ring->tid);
+        writeJsonString(file, ring->name.c_str());
+        fputs("}}", file);
+    }
+    for(size_t track = 0; track < _gpuTracks.size(); track++) {
+        fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%zu,\"args\":{\"name\":", GPU_PID, track + 1);
+        writeJsonString(file, _gpuTracks[track].c_str());
+        fputs("}}", file);
+    }
+
+    for(const CapturedEvent& captured : _captured) {
+        const TraceEvent& event = captured.event;
+        fputs(",\n{\"ph\":\"X\",\"name\":", file);
+        writeJsonString(file, event.name);
+        fprintf(file, ",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.track == 0 ? CPU_PID : GPU_PID, event.track == 0 ? captured.tid : event.track,
+            static_cast<double>(event.startNs - origin) / 1000.0, static_cast<double>(event.durationNs) / 1000.0);
+    }
+    fputs("\n]}\n", file);
+
+    bool written = ferror(file) == 0;
+    return fclose(file) == 0 && written;
+}
+
+} // namespace VxEngine
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "vx_spscRing.hpp"
+#include "vx_allocationTracker.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline capture for hitches that frame averages hide. VX_TRACE_SCOPE("name") times the enclosing
+// scope into a ring owned by the calling thread, so recording takes two clock reads and a lock free
+// push. While a capture runs the main thread drains every ring once per frame, and stopping it writes
+// Chrome trace event JSON, which chrome://tracing and ui.perfetto.dev both open. GpuProfiler scopes
+// go onto their own tracks, one per queue.
+//
+// VX_TRACING is defined in every configuration but Release (see CMakeLists.txt). Without it
+// VX_TRACE_SCOPE expands to nothing and nothing is ever recorded.
+//
+// Events keep the name pointer only, so names must be string literals or otherwise outlive the capture.
+
+namespace VxEngine {
+
+// steady_clock is CLOCK_MONOTONIC on Linux and the performance counter on Windows, the host time
+// domains GPU timestamps can be calibrated against.
+using TraceClock = std::chrono::steady_clock;
+
+struct TraceEvent {
+    const char* name = nullptr;
+    int64_t startNs = 0; // Since the TraceClock epoch.
+    int64_t durationNs = 0;
+    uint32_t track = 0;  // 0 for the recording thread's own track, otherwise from Tracer::gpu_track.
+};
+
+class Tracer {
+public:
+    static constexpr uint32_t RING_CAPACITY = 16384; // Events a thread can record between drains.
+
+    static Tracer& Get();
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(TraceClock::now().time_since_epoch()).count();
+    }
+
+    // Starts collecting events for a capture written to path. False when one is already running
+    // or tracing is compiled out.
+    bool start(const std::string& path);
+    // Collects what is left and writes the capture. False if nothing was running or writing failed.
+    bool stop();
+    bool capturing() const { return _capturing.load(std::memory_order_relaxed); }
+
+    // Main thread, once per frame. Empties the thread rings into the capture.
+    void collect();
+
+    // Shown as the thread's track name. Applies to the calling thread.
+    void set_thread_name(const char* name);
+    // A track of its own, e.g. for a queue's GPU timestamps. Same name, same track.
+    uint32_t gpu_track(const char* name);
+
+    // Recording thread. Does nothing without a capture; events that don't fit the thread's ring
+    // are dropped and counted.
+    void record(const char* name, int64_t startNs, int64_t endNs, uint32_t track = 0) {
+        if(capturing()) {
+            push(TraceEvent{ name, startNs, endNs - startNs, track });
+        }
+    }
+
+    // Times the enclosing scope, see VX_TRACE_SCOPE.
+    class Scope {
+    public:
+        // Also the scope heap allocations are attributed to, see vx_allocationTracker.hpp.
+        explicit Scope(const char* name)
+            : _name(name), _start(Tracer::Get().capturing() ? now_ns() : -1), _allocationScope(AllocationTracker::enter_scope(name)) {}
+        ~Scope() {
+            AllocationTracker::leave_scope(_allocationScope);
+            if(_start >= 0) {
+                Tracer::Get().record(_name, _start, now_ns());
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* _name;
+        int64_t _start;
+        const char* _allocationScope; // The enclosing one, restored on exit.
+    };
+
+private:
+    struct ThreadRing {
+        uint32_t tid = 0;
+        std::string name;
+        SpscRing<TraceEvent, RING_CAPACITY> events;
+    };
+
+    struct CapturedEvent {
+        TraceEvent event;
+        uint32_t tid;
+    };
+
+    void push(TraceEvent&& event);
+    ThreadRing& thread_ring();
+    void drain(bool keep); // _mutex held.
+    bool write(const std::string& path) const; // _mutex held.
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<ThreadRing>> _rings; // Never freed, a thread_local pointer may still refer to one.
+    std::vector<std::string> _gpuTracks;             // Track i + 1.
+    std::vector<CapturedEvent> _captured;
+    std::string _path;
+    std::atomic<bool> _capturing{ false };
+    std::atomic<uint64_t> _dropped{ 0 };
+};
+
+} // namespace VxEngine
+
+#ifdef VX_TRACING
+#define VX_TRACE_CONCAT_INNER(a, b) a##b
+#define VX_TRACE_CONCAT(a, b) VX_TRACE_CONCAT_INNER(a, b)
+#define VX_TRACE_SCOPE(name) ::VxEngine::Tracer::Scope VX_TRACE_CONCAT(_vx_trace_scope_, __LINE__)(name)
+#else
+#define VX_TRACE_SCOPE(name) ((void)0)
+#endif
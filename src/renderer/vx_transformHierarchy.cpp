@@ -0,0 +1,359 @@
+#include "vx_transformHierarchy.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VX_TRANSFORM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace VxEngine {
+
+namespace {
+
+#ifdef VX_TRANSFORM_SSE
+
+// out = a * b, column major. Every column of the result is a's columns weighted by that column of b.
+inline void multiplyColumns(const __m128 a[4], const __m128 b[4], float* out) {
+    for(int column = 0; column < 4; column++) {
+        __m128 result = _mm_mul_ps(a[0], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(0, 0, 0, 0)));
+        result = _mm_add_ps(result, _mm_mul_ps(a[1], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(1, 1, 1, 1))));
+        result = _mm_add_ps(result, _mm_mul_ps(a[2], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(2, 2, 2, 2))));
+        result = _mm_add_ps(result, _mm_mul_ps(a[3], _mm_shuffle_ps(b[column], b[column], _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_storeu_ps(out + column * 4, result);
+    }
+}
+
+#endif
+
+} // namespace
+
+void TransformHierarchy::init(VmaAllocator allocator, MemoryTelemetry& telemetry, uint32_t maxNodes) {
+    _allocator = allocator;
+    _telemetry = &telemetry;
+    _maxNodes = maxNodes;
+
+    // Sized up front so adding nodes, updating and uploading never reallocate.
+    _parentIds.reserve(maxNodes);
+    _indexOf.reserve(maxNodes);
+    _pendingUpload.reserve(maxNodes);
+    for(std::vector<float>& channel : _local) {
+        channel.reserve(maxNodes);
+    }
+    _parent.reserve(maxNodes);
+    _idOf.reserve(maxNodes);
+    _dirty.reserve(maxNodes);
+    _world.reserve(maxNodes);
+    _updated.reserve(maxNodes);
+    _changed.reserve(maxNodes);
+    _regions.reserve(maxNodes);
+
+    size_t bytes = static_cast<size_t>(maxNodes) * sizeof(glm::mat4);
+    _worldBuffer = createBuffer(_allocator, *_telemetry, bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY, AllocationCategory::Buffer, "node transforms");
+    for(AllocatedBuffer& staging : _staging) {
+        staging = createBuffer(_allocator, *_telemetry, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_ONLY, AllocationCategory::Staging, "node transform staging");
+    }
+}
+
+void TransformHierarchy::destroy() {
+    destroyBuffer(_allocator, *_telemetry, _worldBuffer);
+    for(const AllocatedBuffer& staging : _staging) {
+        destroyBuffer(_allocator, *_telemetry, staging);
+    }
+    _worldBuffer = {};
+
+    _parentIds.clear();
+    _indexOf.clear();
+    _pendingUpload.clear();
+    for(std::vector<float>& channel : _local) {
+        channel.clear();
+    }
+    _parent.clear();
+    _idOf.clear();
+    _dirty.clear();
+    _world.clear();
+    _updated.clear();
+    _changed.clear();
+    _anyDirty = false;
+    _sorted = true;
+    _stats = {};
+}
+
+TransformHierarchy::NodeId TransformHierarchy::add_node(NodeId parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    if(size() >= _maxNodes || (parent != INVALID_NODE && parent >= size())) {
+        return INVALID_NODE;
+    }
+
+    // Appended, which keeps parents ahead of their children; update() restores the depth order.
+    NodeId id = size();
+    uint32_t index = static_cast<uint32_t>(_idOf.size());
+    _parentIds.push_back(parent);
+    _indexOf.push_back(index);
+    _pendingUpload.push_back(0);
+
+    for(std::vector<float>& channel : _local) {
+        channel.push_back(0.0f);
+    }
+    _parent.push_back(parent != INVALID_NODE ? _indexOf[parent] : INVALID_NODE);
+    _idOf.push_back(id);
+    _dirty.push_back(0);
+    _world.push_back(glm::mat4(1.0f));
+    _sorted = false;
+
+    set_local(id, translation, rotation, scale);
+    return id;
+}
+
+void TransformHierarchy::set_local(NodeId node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    uint32_t index = _indexOf[node];
+    _local[SX][index] = scale.x;
+    _local[SY][index] = scale.y;
+    _local[SZ][index] = scale.z;
+    set_translation(node, translation);
+    set_rotation(node, rotation);
+}
+
+void TransformHierarchy::set_translation(NodeId node, const glm::vec3& translation) {
+    uint32_t index = _indexOf[node];
+    _local[TX][index] = translation.x;
+    _local[TY][index] = translation.y;
+    _local[TZ][index] = translation.z;
+    mark_dirty(index);
+}
+
+void TransformHierarchy::set_rotation(NodeId node, const glm::quat& rotation) {
+    uint32_t index = _indexOf[node];
+    _local[RX][index] = rotation.x;
+    _local[RY][index] = rotation.y;
+    _local[RZ][index] = rotation.z;
+    _local[RW][index] = rotation.w;
+    mark_dirty(index);
+}
+
+void TransformHierarchy::mark_dirty(uint32_t index) {
+    _dirty[index] = 1;
+    _anyDirty = true;
+}
+
+glm::mat4 TransformHierarchy::world(NodeId node) const {
+    return _world[_indexOf[node]];
+}
+
+// Stable counting sort of the nodes by depth. Only runs after nodes were added, so it may allocate.
+void TransformHierarchy::sort_by_depth() {
+    uint32_t count = size();
+    std::vector<uint32_t> depth(count);
+    uint32_t levels = 0;
+    for(NodeId id = 0; id < count; id++) {
+        depth[id] = _parentIds[id] != INVALID_NODE ? depth[_parentIds[id]] + 1 : 0; // Parents have lower ids.
+        levels = std::max(levels, depth[id] + 1);
+    }
+
+    std::vector<uint32_t> levelStart(levels + 1, 0);
+    for(NodeId id = 0; id < count; id++) {
+        levelStart[depth[id] + 1]++;
+    }
+    for(uint32_t level = 0; level < levels; level++) {
+        levelStart[level + 1] += levelStart[level];
+    }
+    std::vector<NodeId> order(count);
+    for(NodeId id = 0; id < count; id++) {
+        order[levelStart[depth[id]]++] = id;
+    }
+
+    // Copies back into the same storage to keep the reserved capacity.
+    auto permute = [&](auto& values) {
+        auto source = values;
+        for(uint32_t index = 0; index < count; index++) {
+            values[index] = source[_indexOf[order[index]]];
+        }
+    };
+    for(std::vector<float>& channel : _local) {
+        permute(channel);
+    }
+    permute(_dirty);
+    permute(_world);
+
+    for(uint32_t index = 0; index < count; index++) {
+        _idOf[index] = order[index];
+        _indexOf[order[index]] = index;
+    }
+    for(uint32_t index = 0; index < count; index++) {
+        NodeId parent = _parentIds[_idOf[index]];
+        _parent[index] = parent != INVALID_NODE ? _indexOf[parent] : INVALID_NODE;
+    }
+
+    _stats.depth = levels;
+    _sorted = true;
+}
+
+void TransformHierarchy::update() {
+    if(!_sorted) {
+        sort_by_depth();
+    }
+
+    _updated.clear();
+    if(_anyDirty) {
+        // Parents come first, so their flag is final by the time their children read it.
+        const uint32_t* parent = _parent.data();
+        uint8_t* dirty = _dirty.data();
+        uint32_t count = size();
+        for(uint32_t index = 0; index < count; index++) {
+            if(parent[index] != INVALID_NODE) {
+                dirty[index] |= dirty[parent[index]];
+            }
+            if(dirty[index]) {
+                _updated.push_back(index);
+            }
+        }
+
+        compute_worlds(_updated.data(), static_cast<uint32_t>(_updated.size()));
+
+        for(uint32_t index : _updated) {
+            dirty[index] = 0;
+            NodeId id = _idOf[index];
+            if(!_pendingUpload[id]) {
+                _pendingUpload[id] = 1;
+                _changed.push_back(id);
+            }
+        }
+        _anyDirty = false;
+    }
+    _stats.updatedNodes = static_cast<uint32_t>(_updated.size());
+}
+
+// indices are ascending, so a parent in the same group of four is written before its children read it.
+void TransformHierarchy::compute_worlds(const uint32_t* indices, uint32_t count) {
+#ifdef VX_TRANSFORM_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for(uint32_t base = 0; base < count; base += 4) {
+        uint32_t lanes = std::min(4u, count - base);
+        uint32_t lane[4];
+        for(uint32_t k = 0; k < 4; k++) {
+            lane[k] = indices[base + std::min(k, lanes - 1)]; // Short groups repeat their last node.
+        }
+        auto load = [&](Channel channel) {
+            const float* values = _local[channel].data();
+            return _mm_setr_ps(values[lane[0]], values[lane[1]], values[lane[2]], values[lane[3]]);
+        };
+
+        // Rotation matrix of a unit quaternion, as glm::mat4_cast, with the scale folded into its columns.
+        __m128 x = load(RX);
+        __m128 y = load(RY);
+        __m128 z = load(RZ);
+        __m128 w = load(RW);
+        __m128 x2 = _mm_add_ps(x, x);
+        __m128 y2 = _mm_add_ps(y, y);
+        __m128 z2 = _mm_add_ps(z, z);
+        __m128 xx = _mm_mul_ps(x, x2);
+        __m128 yy = _mm_mul_ps(y, y2);
+        __m128 zz = _mm_mul_ps(z, z2);
+        __m128 xy = _mm_mul_ps(x, y2);
+        __m128 xz = _mm_mul_ps(x, z2);
+        __m128 yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2);
+        __m128 wy = _mm_mul_ps(w, y2);
+        __m128 wz = _mm_mul_ps(w, z2);
+
+        __m128 sx = load(SX);
+        __m128 sy = load(SY);
+        __m128 sz = load(SZ);
+
+        // Column c of all four matrices, one row per component, transposed into one row per matrix.
+        __m128 c0[4] = {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+            _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+            _mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+            zero };
+        __m128 c1[4] = {
+            _mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+            _mm_mul_ps(_mm_add_ps(yz, wx), sy),
+            zero };
+        __m128 c2[4] = {
+            _mm_mul_ps(_mm_add_ps(xz, wy), sz),
+            _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+            zero };
+        __m128 c3[4] = { load(TX), load(TY), load(TZ), one };
+        _MM_TRANSPOSE4_PS(c0[0], c0[1], c0[2], c0[3]);
+        _MM_TRANSPOSE4_PS(c1[0], c1[1], c1[2], c1[3]);
+        _MM_TRANSPOSE4_PS(c2[0], c2[1], c2[2], c2[3]);
+        _MM_TRANSPOSE4_PS(c3[0], c3[1], c3[2], c3[3]);
+
+        for(uint32_t k = 0; k < lanes; k++) {
+            const __m128 local[4] = { c0[k], c1[k], c2[k], c3[k] };
+            float* out = &_world[lane[k]][0][0];
+            uint32_t parent = _parent[lane[k]];
+            if(parent == INVALID_NODE) {
+                for(int column = 0; column < 4; column++) {
+                    _mm_storeu_ps(out + column * 4, local[column]);
+                }
+                continue;
+            }
+            const float* parentWorld = &_world[parent][0][0];
+            const __m128 parentColumns[4] = {
+                _mm_loadu_ps(parentWorld),
+                _mm_loadu_ps(parentWorld + 4),
+                _mm_loadu_ps(parentWorld + 8),
+                _mm_loadu_ps(parentWorld + 12) };
+            multiplyColumns(parentColumns, local, out);
+        }
+    }
+#else
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t index = indices[i];
+        glm::quat rotation(_local[RW][index], _local[RX][index], _local[RY][index], _local[RZ][index]);
+        glm::mat4 local = glm::mat4_cast(rotation);
+        local[0] *= _local[SX][index];
+        local[1] *= _local[SY][index];
+        local[2] *= _local[SZ][index];
+        local[3] = glm::vec4(_local[TX][index], _local[TY][index], _local[TZ][index], 1.0f);
+        _world[index] = _parent[index] != INVALID_NODE ? _world[_parent[index]] * local : local;
+    }
+#endif
+}
+
+void TransformHierarchy::upload(VkCommandBuffer cmd, uint32_t frameIndex) {
+    _stats.uploadedMatrices = 0;
+    _stats.uploadRegions = 0;
+    if(_changed.empty()) {
+        return;
+    }
+
+    // Ascending ids turn neighbouring matrices into a single region.
+    std::sort(_changed.begin(), _changed.end());
+
+    const AllocatedBuffer& staging = _staging[frameIndex];
+    uint8_t* mapped = static_cast<uint8_t*>(staging.info.pMappedData);
+    constexpr VkDeviceSize MATRIX_BYTES = sizeof(glm::mat4);
+    _regions.clear();
+    for(size_t i = 0; i < _changed.size(); i++) {
+        NodeId id = _changed[i];
+        std::memcpy(mapped + i * MATRIX_BYTES, &_world[_indexOf[id]], MATRIX_BYTES);
+        _pendingUpload[id] = 0;
+
+        if(i > 0 && _changed[i - 1] + 1 == id) {
+            _regions.back().size += MATRIX_BYTES;
+        } else {
+            _regions.push_back(VkBufferCopy{ .srcOffset = i * MATRIX_BYTES, .dstOffset = id * MATRIX_BYTES, .size = MATRIX_BYTES });
+        }
+    }
+    vkCmdCopyBuffer(cmd, staging.buffer, _worldBuffer.buffer, static_cast<uint32_t>(_regions.size()), _regions.data());
+
+    memoryBarrier(cmd,
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+    _stats.uploadedMatrices = static_cast<uint32_t>(_changed.size());
+    _stats.uploadRegions = static_cast<uint32_t>(_regions.size());
+    _changed.clear();
+}
+
+} // namespace VxEngine
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_buffer.hpp"
+#include "vx_memoryTelemetry.hpp"
+#include "../../3rdparty/glm/glm/glm.hpp"
+#include "../../3rdparty/glm/glm/gtc/quaternion.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Node transforms for large scenes. Local translation, rotation and scale, the parent links and the
+// world matrices are kept in flat arrays sorted by depth, so every parent precedes its children and
+// one linear pass both spreads dirty flags down the tree and recomputes the dirty subtrees in order.
+// Clean nodes are never touched beyond reading their flag.
+//
+// Dirty nodes are composed four at a time from the per channel TRS arrays with SSE, then multiplied
+// with their parent's world matrix one SSE column at a time. Builds without SSE use glm.
+//
+// World matrices also live in a device buffer indexed by node id, which upload() patches with only
+// the matrices that changed since the last upload, as coalesced copy regions from a per frame slot
+// staging buffer.
+
+namespace VxEngine {
+
+class TransformHierarchy {
+public:
+    using NodeId = uint32_t; // Stable for the node's lifetime, also its index in the device buffer.
+    static constexpr NodeId INVALID_NODE = UINT32_MAX;
+
+    struct Stats {
+        uint32_t updatedNodes = 0;      // Recomputed by the last update(), dirty subtrees included.
+        uint32_t uploadedMatrices = 0;  // Copied by the last upload().
+        uint32_t uploadRegions = 0;     // Runs of consecutive ids those copies were merged into.
+        uint32_t depth = 0;             // Levels in the hierarchy.
+    };
+
+    // Allocates the device buffer and staging for maxNodes. Nodes beyond it can't be added.
+    void init(VmaAllocator allocator, MemoryTelemetry& telemetry, uint32_t maxNodes);
+    void destroy();
+
+    // parent must already exist, or be INVALID_NODE for a root. Returns INVALID_NODE when full.
+    NodeId add_node(NodeId parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+
+    // Marks the node, and through it its subtree, for the next update().
+    void set_local(NodeId node, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    void set_translation(NodeId node, const glm::vec3& translation);
+    void set_rotation(NodeId node, const glm::quat& rotation);
+
+    // Recomputes the world matrices of dirty nodes and their descendants.
+    void update();
+
+    // Copies the world matrices changed since the last upload into the device buffer and makes them
+    // visible to shaders. frameIndex picks the staging buffer, whose previous copies must have finished.
+    void upload(VkCommandBuffer cmd, uint32_t frameIndex);
+
+    // As of the last update().
+    glm::mat4 world(NodeId node) const;
+
+    uint32_t size() const { return static_cast<uint32_t>(_parentIds.size()); }
+    VkDeviceAddress world_address() const { return _worldBuffer.address; } // mat4 per node id.
+    const Stats& stats() const { return _stats; }
+
+private:
+    // Local transform components, one array each so four nodes load into one register per component.
+    enum Channel : uint32_t { TX = 0, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, CHANNEL_COUNT };
+
+    void mark_dirty(uint32_t index);
+    void sort_by_depth();
+    void compute_worlds(const uint32_t* indices, uint32_t count);
+
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+    uint32_t _maxNodes = 0;
+
+    // By node id.
+    std::vector<NodeId> _parentIds;
+    std::vector<uint32_t> _indexOf;
+    std::vector<uint8_t> _pendingUpload;
+
+    // By index, in depth order.
+    std::array<std::vector<float>, CHANNEL_COUNT> _local;
+    std::vector<uint32_t> _parent; // Index of the parent, always lower, or INVALID_NODE.
+    std::vector<NodeId> _idOf;
+    std::vector<uint8_t> _dirty;
+    std::vector<glm::mat4> _world;
+
+    bool _anyDirty = false;
+    bool _sorted = true;             // False once nodes were added since the last sort.
+    std::vector<uint32_t> _updated;  // Indices recomputed by the last update().
+    std::vector<NodeId> _changed;    // Ids waiting for upload().
+    std::vector<VkBufferCopy> _regions;
+
+    AllocatedBuffer _worldBuffer;
+    AllocatedBuffer _staging[LIVE_FRAMES];
+    Stats _stats;
+};
+
+} // namespace VxEngine
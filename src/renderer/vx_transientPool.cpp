@@ -0,0 +1,328 @@
+#include "vx_transientPool.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "../../3rdparty/imgui/imgui.h"
+
+namespace VxEngine {
+
+bool TransientImagePool::ImageKey::operator==(const ImageKey& other) const {
+    return format == other.format
+        && extent.width == other.extent.width && extent.height == other.extent.height && extent.depth == other.extent.depth
+        && usage == other.usage && aspect == other.aspect && layers == other.layers && slot == other.slot;
+}
+
+size_t TransientImagePool::ImageKeyHash::operator()(const ImageKey& key) const {
+    uint64_t hash = hashValue(key.format);
+    hash = hashValue(key.extent, hash);
+    hash = hashValue(key.usage, hash);
+    hash = hashValue(key.aspect, hash);
+    hash = hashValue(key.layers, hash);
+    hash = hashValue(key.slot, hash);
+    return static_cast<size_t>(hash);
+}
+
+void TransientImagePool::init(VkDevice device, VmaAllocator allocator, MemoryTelemetry* telemetry) {
+    _device = device;
+    _allocator = allocator;
+    _telemetry = telemetry;
+}
+
+void TransientImagePool::destroy() {
+    for(auto& [key, cached] : _images) {
+        vkDestroyImageView(_device, cached.image.imageView, nullptr);
+        vkDestroyImage(_device, cached.image.image, nullptr);
+    }
+    _images.clear();
+
+    for(Slot& slot : _slots) {
+        if(slot.allocation != VK_NULL_HANDLE) {
+            _telemetry->untrack(slot.allocation);
+            vmaFreeMemory(_allocator, slot.allocation);
+        }
+    }
+    _slots.clear();
+
+    _resolved.clear();
+    _resolvedValid = false;
+}
+
+void TransientImagePool::begin_frame(uint64_t frameNumber) {
+    _frameNumber = frameNumber;
+    _requests.clear();
+}
+
+TransientImageHandle TransientImagePool::request(const TransientImageDesc& desc) {
+    _requests.push_back(desc);
+    return static_cast<TransientImageHandle>(_requests.size() - 1);
+}
+
+uint64_t TransientImagePool::hash_requests() const {
+    uint64_t hash = hashValue(_requests.size());
+    for(const TransientImageDesc& desc : _requests) {
+        hash = hashValue(desc.format, hash);
+        hash = hashValue(desc.extent, hash);
+        hash = hashValue(desc.usage, hash);
+        hash = hashValue(desc.aspect, hash);
+        hash = hashValue(desc.layers, hash);
+        hash = hashValue(desc.firstPass, hash);
+        hash = hashValue(desc.lastPass, hash);
+    }
+    return hash;
+}
+
+void TransientImagePool::retire_slot_images(uint32_t slot, DeletionManager& frameDeletion) {
+    for(auto it = _images.begin(); it != _images.end();) {
+        if(it->first.slot != slot) {
+            ++it;
+            continue;
+        }
+
+        AllocatedImage image = it->second.image;
+        frameDeletion.push_function([this, image]() {
+            vkDestroyImageView(_device, image.imageView, nullptr);
+            vkDestroyImage(_device, image.image, nullptr);
+        });
+        it = _images.erase(it);
+    }
+}
+
+void TransientImagePool::realize(DeletionManager& frameDeletion, std::pmr::memory_resource& scratch) {
+    // Release images that haven't been requested in a while.
+    for(auto it = _images.begin(); it != _images.end();) {
+        if(it->second.lastUsedFrame + EVICT_AFTER_FRAMES >= _frameNumber) {
+            ++it;
+            continue;
+        }
+
+        AllocatedImage image = it->second.image;
+        frameDeletion.push_function([this, image]() {
+            vkDestroyImageView(_device, image.imageView, nullptr);
+            vkDestroyImage(_device, image.image, nullptr);
+        });
+        it = _images.erase(it);
+        _resolvedValid = false;
+    }
+
+    uint64_t hash = hash_requests();
+    if(_resolvedValid && hash == _resolvedHash) {
+        // Same requests as last frame, so the same images can be handed out again.
+        for(auto& [key, cached] : _images) {
+            for(const AllocatedImage& resolved : _resolved) {
+                if(resolved.image == cached.image.image) {
+                    cached.lastUsedFrame = _frameNumber;
+                }
+            }
+        }
+        return;
+    }
+
+    const size_t requestCount = _requests.size();
+    _resolved.assign(requestCount, AllocatedImage{});
+    _unaliasedBytes = 0;
+
+    std::pmr::vector<VkMemoryRequirements> requirements(requestCount, &scratch);
+    for(size_t i = 0; i < requestCount; i++) {
+        const TransientImageDesc& desc = _requests[i];
+        VkImageCreateInfo imageInfo = createImageCreateInfo(desc.format, desc.usage, desc.extent);
+        imageInfo.arrayLayers = desc.layers;
+
+        VkDeviceImageMemoryRequirements query = { .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS };
+        query.pCreateInfo = &imageInfo;
+        VkMemoryRequirements2 result = { .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+        vkGetDeviceImageMemoryRequirements(_device, &query, &result);
+
+        requirements[i] = result.memoryRequirements;
+        _unaliasedBytes += requirements[i].size;
+    }
+
+    // Greedy interval assignment: walk the requests in order of their first pass and put each
+    // one in the best fitting slot that is free by then.
+    std::pmr::vector<uint32_t> order(requestCount, &scratch);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if(_requests[a].firstPass != _requests[b].firstPass) {
+            return _requests[a].firstPass < _requests[b].firstPass;
+        }
+        return requirements[a].size > requirements[b].size;
+    });
+
+    struct SlotNeeds {
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = ~0u;
+    };
+    std::pmr::vector<SlotNeeds> needs(_slots.size(), &scratch);
+    std::pmr::vector<uint32_t> slotOf(requestCount, &scratch);
+
+    for(Slot& slot : _slots) {
+        slot.assigned = false;
+        slot.busyUntilPass = 0;
+    }
+
+    for(uint32_t index : order) {
+        const TransientImageDesc& desc = _requests[index];
+        const VkMemoryRequirements& req = requirements[index];
+
+        int best = -1;
+        for(uint32_t s = 0; s < _slots.size(); s++) {
+            if(_slots[s].assigned && _slots[s].busyUntilPass >= desc.firstPass) {
+                continue;
+            }
+            if((needs[s].memoryTypeBits & req.memoryTypeBits) == 0) {
+                continue;
+            }
+
+            if(best < 0) {
+                best = static_cast<int>(s);
+                continue;
+            }
+
+            // Prefer the smallest slot that already fits, otherwise the largest one to grow.
+            VkDeviceSize bestSize = std::max(_slots[best].size, needs[best].size);
+            VkDeviceSize size = std::max(_slots[s].size, needs[s].size);
+            bool fits = size >= req.size;
+            bool bestFits = bestSize >= req.size;
+            if((fits && (!bestFits || size < bestSize)) || (!fits && !bestFits && size > bestSize)) {
+                best = static_cast<int>(s);
+            }
+        }
+
+        if(best < 0) {
+            _slots.push_back(Slot{});
+            needs.push_back(SlotNeeds{});
+            best = static_cast<int>(_slots.size() - 1);
+        }
+
+        Slot& slot = _slots[best];
+        slot.assigned = true;
+        slot.busyUntilPass = desc.lastPass;
+
+        SlotNeeds& need = needs[best];
+        need.size = std::max(need.size, req.size);
+        need.alignment = std::max(need.alignment, req.alignment);
+        need.memoryTypeBits &= req.memoryTypeBits;
+
+        slotOf[index] = static_cast<uint32_t>(best);
+    }
+
+    // Grow or move slots whose memory no longer satisfies what was assigned to them.
+    for(uint32_t s = 0; s < _slots.size(); s++) {
+        Slot& slot = _slots[s];
+        if(!slot.assigned) {
+            continue;
+        }
+
+        const SlotNeeds& need = needs[s];
+        bool compatible = slot.allocation != VK_NULL_HANDLE
+            && slot.size >= need.size
+            && slot.alignment >= need.alignment
+            && (slot.memoryTypeBits & need.memoryTypeBits) == slot.memoryTypeBits;
+        if(compatible) {
+            continue;
+        }
+
+        if(slot.allocation != VK_NULL_HANDLE) {
+            retire_slot_images(s, frameDeletion);
+            VmaAllocation old = slot.allocation;
+            frameDeletion.push_function([this, old]() {
+                _telemetry->untrack(old);
+                vmaFreeMemory(_allocator, old);
+            });
+        }
+
+        VkMemoryRequirements combined = { .size = need.size, .alignment = need.alignment, .memoryTypeBits = need.memoryTypeBits };
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VmaAllocationInfo info;
+        VX_CHECK(vmaAllocateMemory(_allocator, &combined, &allocInfo, &slot.allocation, &info), "vmaAllocateMemory");
+        _telemetry->track(slot.allocation, AllocationCategory::RenderTarget, "transient slot");
+
+        slot.size = need.size;
+        slot.alignment = need.alignment;
+        slot.memoryTypeBits = 1u << info.memoryType;
+    }
+
+    // Create (or recycle) an image per request, bound to its slot's memory.
+    for(size_t i = 0; i < requestCount; i++) {
+        const TransientImageDesc& desc = _requests[i];
+        ImageKey key = { desc.format, desc.extent, desc.usage, desc.aspect, desc.layers, slotOf[i] };
+
+        auto it = _images.find(key);
+        if(it == _images.end()) {
+            AllocatedImage image = {};
+            image.format = desc.format;
+            image.extent = desc.extent;
+            image.allocation = _slots[slotOf[i]].allocation;
+
+            VkImageCreateInfo imageInfo = createImageCreateInfo(desc.format, desc.usage, desc.extent);
+            imageInfo.arrayLayers = desc.layers;
+            VX_CHECK(vmaCreateAliasingImage(_allocator, image.allocation, &imageInfo, &image.image), "vmaCreateAliasingImage");
+
+            VkImageViewCreateInfo viewInfo = createImageViewCreateInfo(desc.format, image.image, desc.aspect);
+            if(desc.layers > 1) {
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+                viewInfo.subresourceRange.layerCount = desc.layers;
+            }
+            VX_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &image.imageView), "vkCreateImageView");
+
+            it = _images.emplace(key, CachedImage{ image, _frameNumber }).first;
+        }
+
+        it->second.lastUsedFrame = _frameNumber;
+        _resolved[i] = it->second.image;
+    }
+
+    // Slots that ended up with no images at all give their memory back.
+    for(uint32_t s = 0; s < _slots.size(); s++) {
+        Slot& slot = _slots[s];
+        if(slot.assigned || slot.allocation == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        bool referenced = std::any_of(_images.begin(), _images.end(), [s](const auto& entry) { return entry.first.slot == s; });
+        if(referenced) {
+            continue;
+        }
+
+        VmaAllocation old = slot.allocation;
+        frameDeletion.push_function([this, old]() {
+            _telemetry->untrack(old);
+            vmaFreeMemory(_allocator, old);
+        });
+        slot = Slot{};
+    }
+
+    _resolvedHash = hash;
+    _resolvedValid = true;
+}
+
+VkDeviceSize TransientImagePool::allocated_bytes() const {
+    VkDeviceSize total = 0;
+    for(const Slot& slot : _slots) {
+        total += slot.size;
+    }
+    return total;
+}
+
+void TransientImagePool::draw_imgui() {
+    constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+
+    if(ImGui::Begin("transient targets")) {
+        ImGui::Text("%zu requests, %zu cached images, %zu memory slots", _requests.size(), _images.size(), _slots.size());
+        ImGui::Text("Backing memory: %.1f MB (%.1f MB without aliasing, %.1f MB saved)", allocated_bytes() / BYTES_PER_MB,
+            _unaliasedBytes / BYTES_PER_MB, saved_bytes() / BYTES_PER_MB);
+
+        for(size_t i = 0; i < _requests.size(); i++) {
+            const TransientImageDesc& desc = _requests[i];
+            ImGui::BulletText("%s %ux%ux%u passes %u-%u", desc.name ? desc.name : "unnamed",
+                desc.extent.width, desc.extent.height, desc.layers, desc.firstPass, desc.lastPass);
+        }
+    }
+    ImGui::End();
+}
+
+} // namespace VxEngine
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "vx_utils.hpp"
+#include "vx_image.hpp"
+#include "vx_deletionManager.hpp"
+#include "vx_memoryTelemetry.hpp"
+
+#include <algorithm>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+// Pool of per-frame render targets (depth buffers, bloom targets, post-process intermediates).
+// Passes request images by format, extent and usage along with the range of pass indices
+// during which they are live. Images whose ranges don't overlap share the same VMA memory
+// block through vmaCreateAliasingImage, and images are recycled across frames as long as
+// the requests stay the same.
+
+// Because memory is shared, the contents of a transient image are undefined at the start of
+// its first pass, so the first barrier must come from VK_IMAGE_LAYOUT_UNDEFINED.
+
+namespace VxEngine {
+
+struct TransientImageDesc {
+    VkFormat format;
+    VkExtent3D extent;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    uint32_t layers = 1;    // Viewed as a 2D array when above 1.
+    uint32_t firstPass; // Inclusive range of pass indices the image is live for.
+    uint32_t lastPass;
+    const char* name;
+};
+
+using TransientImageHandle = uint32_t;
+
+class TransientImagePool {
+public:
+    // Cached images that go unused for this many frames are released.
+    static constexpr uint64_t EVICT_AFTER_FRAMES = 120;
+
+    void init(VkDevice device, VmaAllocator allocator, MemoryTelemetry* telemetry);
+    void destroy();
+
+    // Clears the requests of the previous frame.
+    void begin_frame(uint64_t frameNumber);
+
+    TransientImageHandle request(const TransientImageDesc& desc);
+
+    // Assigns requests to memory slots and creates or recycles the images. Objects that are
+    // replaced are retired through the frame's deletion manager since earlier frames may
+    // still be using them. Working arrays come from scratch, e.g. the frame arena.
+    void realize(DeletionManager& frameDeletion, std::pmr::memory_resource& scratch);
+
+    const AllocatedImage& get(TransientImageHandle handle) const { return _resolved[handle]; }
+    size_t request_count() const { return _requests.size(); }
+
+    // Bytes of memory backing the pool vs what dedicated allocations would have used.
+    VkDeviceSize allocated_bytes() const;
+    VkDeviceSize unaliased_bytes() const { return _unaliasedBytes; }
+    VkDeviceSize saved_bytes() const { return _unaliasedBytes - std::min(_unaliasedBytes, allocated_bytes()); }
+
+    void draw_imgui();
+
+private:
+    struct Slot {
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 0;
+        uint32_t memoryTypeBits = 0;
+        uint32_t busyUntilPass = 0; // Only valid while assigning.
+        bool assigned = false;
+    };
+
+    struct ImageKey {
+        VkFormat format;
+        VkExtent3D extent;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect;
+        uint32_t layers;
+        uint32_t slot;
+        bool operator==(const ImageKey& other) const;
+    };
+
+    struct ImageKeyHash {
+        size_t operator()(const ImageKey& key) const;
+    };
+
+    struct CachedImage {
+        AllocatedImage image;
+        uint64_t lastUsedFrame;
+    };
+
+    uint64_t hash_requests() const;
+    void retire_slot_images(uint32_t slot, DeletionManager& frameDeletion);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    MemoryTelemetry* _telemetry = nullptr;
+
+    uint64_t _frameNumber = 0;
+    std::vector<TransientImageDesc> _requests;
+    std::vector<AllocatedImage> _resolved;
+    uint64_t _resolvedHash = 0;
+    bool _resolvedValid = false;
+
+    std::vector<Slot> _slots;
+    std::unordered_map<ImageKey, CachedImage, ImageKeyHash> _images;
+    VkDeviceSize _unaliasedBytes = 0;
+};
+
+} // namespace VxEngine
@@ -79,6 +79,24 @@ static void vx_ignore_handler(VkResult result, const char* functionName) {}
         } \
     } while(0)
 
+// FNV-1a, used to key caches on plain data (render target descriptions, pipeline state, push constants).
+static constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+static inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template<typename T>
+static inline uint64_t hashValue(const T& value, uint64_t seed = HASH_SEED) {
+    return hashBytes(&value, sizeof(T), seed);
+}
+
 constexpr static VkFenceCreateInfo createFenceInfo(VkFenceCreateFlags flags) {
     VkFenceCreateInfo fenceCreateInfo = {};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -221,14 +239,31 @@ constexpr static VkRenderingAttachmentInfo createRenderingAttachmentInfo(VkImage
     return info;
 }
 
-constexpr static VkRenderingInfo createRenderingInfo(VkExtent2D renderExtent, VkRenderingAttachmentInfo* colorAttachment, VkRenderingAttachmentInfo* depthAttachment){
+// Depth attachment that is either cleared to clearDepth or loaded from a previous pass.
+constexpr static VkRenderingAttachmentInfo createDepthAttachmentInfo(VkImageView view, VkImageLayout layout, bool clear, float clearDepth){
+    VkRenderingAttachmentInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    info.pNext = nullptr;
+
+    info.imageView = view;
+    info.imageLayout = layout;
+    info.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    info.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    info.clearValue.depthStencil.depth = clearDepth;
+
+    return info;
+}
+
+// A non zero viewMask renders one layer per set bit with multiview (layerCount is then ignored).
+constexpr static VkRenderingInfo createRenderingInfo(VkExtent2D renderExtent, VkRenderingAttachmentInfo* colorAttachment, VkRenderingAttachmentInfo* depthAttachment, uint32_t viewMask = 0){
     VkRenderingInfo renderInfo {};
     renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
     renderInfo.pNext = nullptr;
 
     renderInfo.renderArea = VkRect2D { VkOffset2D { 0, 0 }, renderExtent };
     renderInfo.layerCount = 1;
-    renderInfo.colorAttachmentCount = 1;
+    renderInfo.viewMask = viewMask;
+    renderInfo.colorAttachmentCount = colorAttachment ? 1 : 0;
     renderInfo.pColorAttachments = colorAttachment;
     renderInfo.pDepthAttachment = depthAttachment;
     renderInfo.pStencilAttachment = nullptr;